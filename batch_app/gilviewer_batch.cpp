@@ -0,0 +1,469 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+
+/**
+ * GilViewerBatch renders quick-looks of image files, or of a display configuration saved by the viewer, with the
+ * stretch, gamma and LUT of the viewer (see offscreen_renderer), without display.
+ *
+ * The files are loaded one after the other by the main thread, as the loaders may read wxConfig and log, then rendered
+ * and encoded in parallel by the thread pool, with GIL only. At most one file per thread is loaded at a time, so the
+ * memory is bounded by the number of threads times the size of the largest file. The logs are written to the standard
+ * streams, one line at a time (see gilviewer_wx_error_logger::streams).
+ *
+ * The outputs are named after the inputs (see output_names), so that two inputs never write the same quick-look.
+ *
+ * The statistics cache of the viewer (see image_stats_cache) is disabled, unless a cache directory is given: no ".gvc"
+ * file is written next to the rendered files.
+ **/
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/gil/extension/io_new/png_all.hpp>
+#include <boost/gil/extension/io_new/tiff_all.hpp>
+
+#include <wx/init.h>
+
+#include "GilViewer/io/gilviewer_io_factory.hpp"
+#include "GilViewer/io/xml_display_configuration_io.hpp"
+#include "GilViewer/layers/image_layer.hpp"
+#include "GilViewer/layers/offscreen_renderer.hpp"
+#include "GilViewer/layers/vector_layer.hpp"
+#include "GilViewer/tools/error_logger.hpp"
+#include "GilViewer/tools/image_stats_cache.hpp"
+#include "GilViewer/tools/pattern_singleton.hpp"
+#include "GilViewer/tools/thread_pool.hpp"
+
+using namespace std;
+
+namespace
+{
+    /// Area to render, in pixels of the first image layer, or in the coordinates of the vector layers when there is
+    /// no image layer (empty: the whole layers)
+    struct region
+    {
+        double x0, y0, x1, y1;
+        region() : x0(0), y0(0), x1(0), y1(0) {}
+        bool empty() const { return x1<=x0 || y1<=y0; }
+    };
+
+    struct options
+    {
+        string output;
+        string format;
+        unsigned int width, height;
+        unsigned int threads;
+        string session;
+        string stats_cache;
+        vector<string> files;
+        vector<region> regions;
+        options() : output("."), format("png"), width(512), height(512), threads(0) {}
+    };
+
+    void usage(ostream& os)
+    {
+        os << "Usage: GilViewerBatch [options] [files...]\n"
+           << "Renders a quick-look of each file, and of the display configuration, as GilViewer displays them.\n"
+           << "  -o, --output DIR          output directory (default: .)\n"
+           << "  -f, --format png|tiff     output format (default: png)\n"
+           << "  -s, --size WxH            output size (default: 512x512)\n"
+           << "  -r, --region X0,Y0,X1,Y1  area to render, in pixels of the first image, may be repeated\n"
+           << "                            (default: the whole image)\n"
+           << "  -c, --configuration FILE  display configuration (.xml) saved by GilViewer, rendered as one stack\n"
+           << "  -j, --threads N           number of threads (default: number of cores)\n"
+           << "      --stats-cache DIR     directory of the statistics cache, as /Paths/Cache of GilViewer\n"
+           << "                            (default: no cache)\n"
+           << "  -h, --help                this message\n";
+    }
+
+    bool parse(int argc, char** argv, options& o)
+    {
+        for(int i=1; i<argc; ++i)
+        {
+            string arg(argv[i]);
+            if(arg=="-h" || arg=="--help")
+                return false;
+            if(arg.size()>1 && arg[0]=='-')
+            {
+                if(i+1==argc)
+                    throw invalid_argument("Missing value of option " + arg);
+                string value(argv[++i]);
+                if(arg=="-o" || arg=="--output")
+                    o.output = value;
+                else if(arg=="-f" || arg=="--format")
+                {
+                    o.format = boost::algorithm::to_lower_copy(value);
+                    if(o.format=="tif")
+                        o.format = "tiff";
+                    if(o.format!="png" && o.format!="tiff")
+                        throw invalid_argument("Unknown output format: " + value);
+                }
+                else if(arg=="-s" || arg=="--size")
+                {
+                    char x;
+                    istringstream iss(value);
+                    if(!(iss >> o.width >> x >> o.height) || x!='x' || !o.width || !o.height)
+                        throw invalid_argument("Invalid size: " + value);
+                }
+                else if(arg=="-r" || arg=="--region")
+                {
+                    region r;
+                    char c0, c1, c2;
+                    istringstream iss(value);
+                    if(!(iss >> r.x0 >> c0 >> r.y0 >> c1 >> r.x1 >> c2 >> r.y1) || c0!=',' || c1!=',' || c2!=',' || r.empty())
+                        throw invalid_argument("Invalid region: " + value);
+                    o.regions.push_back(r);
+                }
+                else if(arg=="-c" || arg=="--configuration")
+                    o.session = value;
+                else if(arg=="-j" || arg=="--threads")
+                    o.threads = boost::lexical_cast<unsigned int>(value);
+                else if(arg=="--stats-cache")
+                {
+                    if(value.empty())
+                        throw invalid_argument("Empty statistics cache directory");
+                    o.stats_cache = value;
+                }
+                else
+                    throw invalid_argument("Unknown option: " + arg);
+            }
+            else
+                o.files.push_back(arg);
+        }
+        return !o.files.empty() || !o.session.empty();
+    }
+
+    /// Viewport showing the region centered in the output
+    layer_transform fit(const region& r, unsigned int width, unsigned int height)
+    {
+        double zoom = std::max((r.x1-r.x0)/width, (r.y1-r.y0)/height);
+        layer_transform t;
+        t.zoom_factor(zoom);
+        t.translation_x(width *zoom/2 - (r.x0+r.x1)/2);
+        t.translation_y(height*zoom/2 - (r.y0+r.y1)/2);
+        return t;
+    }
+
+    /// Counts the files being rendered, to bound the memory, and the failures
+    class batch_state
+    {
+    public:
+        batch_state(unsigned int limit) : m_limit(limit), m_running(0), m_failed(0) {}
+
+        void acquire()
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            while(m_running>=m_limit)
+                m_condition.wait(lock);
+            ++m_running;
+        }
+        void release(const string& message, bool failed)
+        {
+            if(failed)
+                gilviewer_wx_error_logger::log_error(message);
+            else
+                gilviewer_wx_error_logger::log_message(message);
+            boost::mutex::scoped_lock lock(m_mutex);
+            --m_running;
+            if(failed)
+                ++m_failed;
+            m_condition.notify_all();
+        }
+        unsigned int wait()
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            while(m_running>0)
+                m_condition.wait(lock);
+            return m_failed;
+        }
+
+    private:
+        unsigned int m_limit, m_running, m_failed;
+        boost::mutex m_mutex;
+        boost::condition m_condition;
+    };
+
+    layer::ptrLayerType load(const string& filename)
+    {
+        string extension(boost::filesystem::extension(filename));
+        extension = boost::algorithm::to_lower_copy(extension.substr(1));
+        boost::shared_ptr<gilviewer_file_io> file = PatternSingleton<gilviewer_io_factory>::instance()->create_object(extension);
+        return file->load(filename);
+    }
+
+    /// Whole extent of the layers: the first image layer, or else the geometries of the vector layers
+    region extent(const vector<layer::ptrLayerType>& layers)
+    {
+        region r;
+        bool empty = true;
+        for(vector<layer::ptrLayerType>::const_iterator it=layers.begin(); it!=layers.end(); ++it)
+        {
+            if(!(*it)->visible() || !offscreen_renderer::supported(*it))
+                continue;
+            if(boost::shared_ptr<image_layer> l = boost::dynamic_pointer_cast<image_layer>(*it))
+            {
+                r.x0 = r.y0 = 0;
+                r.x1 = l->width();
+                r.y1 = l->height();
+                return r;
+            }
+        }
+        std::vector<double> xs, ys;
+        for(vector<layer::ptrLayerType>::const_iterator it=layers.begin(); it!=layers.end(); ++it)
+        {
+            boost::shared_ptr<vector_layer> l = boost::dynamic_pointer_cast<vector_layer>(*it);
+            if(!l || !l->visible() || !offscreen_renderer::supported(*it))
+                continue;
+            xs.clear(); ys.clear();
+            for(unsigned int i=0; i<l->num_polygons(); ++i)
+                l->get_polygon(i, xs, ys);
+            for(unsigned int i=0; i<l->num_polylines(); ++i)
+                l->get_polyline(i, xs, ys);
+            for(unsigned int i=0; i<l->num_lines(); ++i)
+            {
+                double x0, y0, x1, y1;
+                l->get_line(i, x0, y0, x1, y1);
+                xs.push_back(x0); ys.push_back(y0);
+                xs.push_back(x1); ys.push_back(y1);
+            }
+            for(unsigned int i=0; i<l->num_points(); ++i)
+            {
+                double x, y;
+                l->get_point(i, x, y);
+                xs.push_back(x); ys.push_back(y);
+            }
+            // Same coordinates as the viewport (see fit)
+            layer_transform t(l->transform());
+            t.zoom_factor(1.);
+            t.translation_x(0.);
+            t.translation_y(0.);
+            for(std::size_t i=0; i<xs.size(); ++i)
+            {
+                double x, y;
+                t.from_local(xs[i], ys[i], x, y);
+                if(empty)
+                {
+                    r.x0 = r.x1 = x;
+                    r.y0 = r.y1 = y;
+                    empty = false;
+                }
+                r.x0 = std::min(r.x0, x); r.x1 = std::max(r.x1, x);
+                r.y0 = std::min(r.y0, y); r.y1 = std::max(r.y1, y);
+            }
+        }
+        if(empty)
+            throw invalid_argument("the layers are empty");
+        // Pixels of the points on the border, and degenerated extents (single point, horizontal or vertical line)
+        r.x1 += 1;
+        r.y1 += 1;
+        return r;
+    }
+
+    /// Names of the visible layers which offscreen_renderer cannot render
+    string unsupported(const vector<layer::ptrLayerType>& layers)
+    {
+        string names;
+        for(vector<layer::ptrLayerType>::const_iterator it=layers.begin(); it!=layers.end(); ++it)
+            if((*it)->visible() && !offscreen_renderer::supported(*it))
+                names += (names.empty() ? "" : ", ") + (*it)->name();
+        return names;
+    }
+
+    /// Renders the layers through each region, in files named after base
+    string render(const options& o, const vector<layer::ptrLayerType>& layers, const string& base)
+    {
+        string skipped = unsupported(layers);
+        vector<layer::ptrLayerType>::const_iterator supported = layers.begin();
+        while(supported!=layers.end() && !((*supported)->visible() && offscreen_renderer::supported(*supported)))
+            ++supported;
+        if(supported==layers.end())
+            throw invalid_argument("no layer can be rendered" + (skipped.empty() ? string() : " (" + skipped + ")"));
+        vector<region> regions(o.regions);
+        if(regions.empty())
+            regions.push_back(extent(layers));
+
+        offscreen_renderer renderer(o.width, o.height);
+        boost::gil::rgba8_image_t image;
+        ostringstream written;
+        for(unsigned int i=0; i<regions.size(); ++i)
+        {
+            renderer.viewport(fit(regions[i], o.width, o.height));
+            renderer.render(layers, image);
+            ostringstream filename;
+            filename << (boost::filesystem::path(o.output) / base).string();
+            if(regions.size()>1)
+                filename << "_" << i;
+            filename << "." << o.format;
+            if(o.format=="png")
+                boost::gil::write_view(filename.str(), boost::gil::const_view(image), boost::gil::png_tag());
+            else
+                boost::gil::write_view(filename.str(), boost::gil::const_view(image), boost::gil::tiff_tag());
+            written << " " << filename.str();
+        }
+        if(!skipped.empty())
+            written << " (not rendered: " << skipped << ")";
+        return written.str();
+    }
+
+    /// Base names of the outputs: the stem of each input, or, when several inputs share it (tiles of different
+    /// directories, x.tif and x.png), the whole path with its separators and dots replaced by '_'. Identical paths get
+    /// their index: no output overwrites another one.
+    vector<string> output_names(const vector<string>& inputs)
+    {
+        map<string, unsigned int> stems;
+        for(unsigned int i=0; i<inputs.size(); ++i)
+            ++stems[boost::algorithm::to_lower_copy(boost::filesystem::basename(inputs[i]))];
+        vector<string> names;
+        set<string> used;
+        for(unsigned int i=0; i<inputs.size(); ++i)
+        {
+            string name = boost::filesystem::basename(inputs[i]);
+            if(stems[boost::algorithm::to_lower_copy(name)]>1)
+            {
+                name = inputs[i];
+                while(!name.empty() && (name[0]=='.' || name[0]=='/' || name[0]=='\\'))
+                    name.erase(0, 1);
+                for(string::iterator it=name.begin(); it!=name.end(); ++it)
+                    if(*it=='/' || *it=='\\' || *it==':' || *it=='.')
+                        *it = '_';
+            }
+            if(!used.insert(boost::algorithm::to_lower_copy(name)).second)
+            {
+                name += "_" + boost::lexical_cast<string>(i);
+                used.insert(boost::algorithm::to_lower_copy(name));
+            }
+            names.push_back(name);
+        }
+        return names;
+    }
+
+    /// Runs in the thread pool: GIL only, no wxConfig
+    void render_job(const options& o, const vector<layer::ptrLayerType>& layers, const string& name, const string& base, batch_state& state)
+    {
+        try
+        {
+            string written = render(o, layers, base);
+            state.release(name + " ->" + written, false);
+        }
+        catch(const std::exception& e)
+        {
+            state.release(name + ": " + e.what(), true);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    options o;
+    try
+    {
+        if(!parse(argc, argv, o))
+        {
+            usage(cout);
+            return EXIT_FAILURE;
+        }
+    }
+    catch(const std::exception& e)
+    {
+        cerr << e.what() << endl;
+        usage(cerr);
+        return EXIT_FAILURE;
+    }
+
+    // wxBase only (logs, colours): no display is needed
+    wxInitializer initializer;
+    if(!initializer.IsOk())
+    {
+        cerr << "Unable to initialize wxWidgets" << endl;
+        return EXIT_FAILURE;
+    }
+    gilviewer_wx_error_logger::streams(&cout, &cerr);
+    register_all_file_formats(PatternSingleton<gilviewer_io_factory>::instance());
+    boost::filesystem::create_directories(o.output);
+    image_stats_cache::instance()->enabled(!o.stats_cache.empty());
+    if(!o.stats_cache.empty())
+    {
+        boost::filesystem::create_directories(o.stats_cache);
+        image_stats_cache::instance()->directory(o.stats_cache);
+    }
+
+    thread_pool *pool = thread_pool::instance();
+    if(o.threads)
+        pool->size(o.threads);
+    batch_state state(pool->size());
+
+    vector<string> names(o.files);
+    if(!o.session.empty())
+        names.insert(names.begin(), o.session);
+    const vector<string> bases = output_names(names);
+    for(unsigned int i=0; i<names.size(); ++i)
+    {
+        state.acquire();
+        try
+        {
+            vector<layer::ptrLayerType> layers;
+            if(i==0 && !o.session.empty())
+                xml_display_configuration_io::read(o.session, layers);
+            else
+                layers.push_back(load(names[i]));
+            pool->submit(boost::bind(&render_job, boost::cref(o), layers, names[i], bases[i], boost::ref(state)));
+        }
+        catch(const std::exception& e)
+        {
+            state.release(names[i] + ": " + e.what(), true);
+        }
+    }
+    unsigned int failed = state.wait();
+    pool->shutdown();
+    image_stats_cache::instance()->flush();
+    if(failed)
+        cerr << failed << " file(s) failed" << endl;
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,429 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+
+/**
+ * gilviewer_bench measures the pixel pipeline of the image layers, and prints the results as JSON on the standard output:
+ *  - screen_image_functor, for each type of all_image_types, each orientation, zoom factors below, at and above 1, with
+ *    and without transparency
+ *  - any_view_min_max, histogram_functor and channel_converter_functor, for each type of all_image_types
+ *  - the loaders of the io factory, on synthetic files
+ *
+ * Each measure is repeated (after one warm-up run): the minimum, median and mean durations are reported.
+ **/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/shared_array.hpp>
+#include <boost/mpl/for_each.hpp>
+#include <boost/mpl/placeholders.hpp>
+#include <boost/type_traits/add_pointer.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/gil/extension/io_new/png_all.hpp>
+#include <boost/gil/extension/io_new/tiff_all.hpp>
+
+#include <wx/init.h>
+
+#include "GilViewer/io/gilviewer_io_factory.hpp"
+#include "GilViewer/layers/image_types.hpp"
+#include "GilViewer/layers/layer_transform.hpp"
+#include "GilViewer/tools/color_lookup_table.hpp"
+#include "GilViewer/layers/image_layer_screen_image_functor.hpp"
+#include "GilViewer/layers/image_layer_min_max_functor.hpp"
+#include "GilViewer/layers/image_layer_histogram_functor.hpp"
+#include "GilViewer/layers/image_layer_channel_converter_functor.hpp"
+#include "GilViewer/tools/image_stats_cache.hpp"
+#include "GilViewer/tools/pattern_singleton.hpp"
+
+using namespace std;
+using namespace boost::gil;
+
+namespace
+{
+    struct settings
+    {
+        unsigned int image_size, screen_width, screen_height, repeat;
+        string filter;
+        settings() : image_size(1024), screen_width(800), screen_height(600), repeat(5) {}
+    };
+
+    void usage(ostream& os)
+    {
+        os << "Usage: gilviewer_bench [options]\n"
+           << "  --image N         side of the synthetic images (default: 1024)\n"
+           << "  --screen WxH      size of the rendered screen (default: 800x600)\n"
+           << "  --repeat N        measures per benchmark (default: 5)\n"
+           << "  --filter NAME     only runs the benchmarks whose name contains NAME\n"
+           << "  -h, --help        this message\n";
+    }
+
+    /// Names of the types of all_image_types
+    template <typename Image> struct image_type_name;
+#define GILVIEWER_BENCH_IMAGE_NAME(T) \
+    template <> struct image_type_name<boost::gil::T##_image_t> { static const char* get() { return #T; } };
+    GILVIEWER_BENCH_IMAGE_NAME(gray8)
+    GILVIEWER_BENCH_IMAGE_NAME(gray16)
+    GILVIEWER_BENCH_IMAGE_NAME(gray16s)
+    GILVIEWER_BENCH_IMAGE_NAME(gray32)
+    GILVIEWER_BENCH_IMAGE_NAME(gray32F)
+    GILVIEWER_BENCH_IMAGE_NAME(gray64F)
+    GILVIEWER_BENCH_IMAGE_NAME(rgb8)
+    GILVIEWER_BENCH_IMAGE_NAME(rgb16)
+    GILVIEWER_BENCH_IMAGE_NAME(rgb32)
+    GILVIEWER_BENCH_IMAGE_NAME(rgba8)
+    GILVIEWER_BENCH_IMAGE_NAME(rgba16)
+    GILVIEWER_BENCH_IMAGE_NAME(dev1n8)
+    GILVIEWER_BENCH_IMAGE_NAME(dev1n16)
+    GILVIEWER_BENCH_IMAGE_NAME(dev1n32F)
+    GILVIEWER_BENCH_IMAGE_NAME(dev3n8)
+    GILVIEWER_BENCH_IMAGE_NAME(dev3n16)
+#undef GILVIEWER_BENCH_IMAGE_NAME
+
+    const char* orientation_name(layer_transform::layerOrientation o)
+    {
+        static const char* names[] = { "LO_0", "LO_90", "LO_180", "LO_270" };
+        return names[o];
+    }
+
+    /// JSON string literal
+    string quoted(const string& s)
+    {
+        string q("\"");
+        for(string::const_iterator it=s.begin(); it!=s.end(); ++it)
+        {
+            if(*it=='"' || *it=='\\')
+                q += '\\';
+            if(static_cast<unsigned char>(*it) < 0x20)
+                q += ' ';
+            else
+                q += *it;
+        }
+        return q + "\"";
+    }
+
+    /// Prints one JSON object per benchmark
+    class json_writer
+    {
+    public:
+        json_writer(ostream& os, const settings& s) : m_os(os), m_settings(s), m_first(true)
+        {
+            m_os << "{\n\"settings\": {\"image\": " << s.image_size << ", \"screen\": [" << s.screen_width << ", " << s.screen_height
+                 << "], \"repeat\": " << s.repeat << "},\n\"benchmarks\": [";
+        }
+        ~json_writer() { m_os << "\n]\n}" << endl; }
+
+        bool selected(const string& name) const { return m_settings.filter.empty() || name.find(m_settings.filter)!=string::npos; }
+
+        /// parameters: pairs of keys and JSON values
+        void write(const string& name, const vector< pair<string,string> >& parameters, double pixels, vector<double> durations, const string& error = string())
+        {
+            m_os << (m_first ? "\n" : ",\n") << "  {\"name\": \"" << name << "\"";
+            m_first = false;
+            for(unsigned int i=0; i<parameters.size(); ++i)
+                m_os << ", \"" << parameters[i].first << "\": " << parameters[i].second;
+            if(!error.empty())
+            {
+                m_os << ", \"error\": " << quoted(error) << "}";
+                return;
+            }
+            sort(durations.begin(), durations.end());
+            double sum = 0.;
+            for(unsigned int i=0; i<durations.size(); ++i)
+                sum += durations[i];
+            double median = durations[durations.size()/2];
+            m_os << ", \"pixels\": " << pixels << ", \"min_ms\": " << durations.front() << ", \"median_ms\": " << median
+                 << ", \"mean_ms\": " << sum/durations.size() << ", \"mpixels_per_s\": " << (median>0. ? pixels/median/1000. : 0.) << "}";
+        }
+
+    private:
+        ostream& m_os;
+        const settings& m_settings;
+        bool m_first;
+    };
+
+    template <typename T> string value(const T& t) { return boost::lexical_cast<string>(t); }
+
+    /// Durations in milliseconds of repeat runs, after a warm-up run
+    vector<double> measure(const boost::function<void ()>& f, unsigned int repeat)
+    {
+        using namespace boost::posix_time;
+        f();
+        vector<double> durations;
+        for(unsigned int i=0; i<repeat; ++i)
+        {
+            ptime start = microsec_clock::universal_time();
+            f();
+            durations.push_back((microsec_clock::universal_time()-start).total_microseconds()/1000.);
+        }
+        return durations;
+    }
+
+    /// Deterministic pattern over the whole range of each channel
+    template <typename View>
+    void fill_synthetic(const View& v)
+    {
+        typedef typename channel_type<View>::type channel_t;
+        for(std::ptrdiff_t y=0; y<v.height(); ++y)
+        {
+            typename View::x_iterator it = v.row_begin(y);
+            for(std::ptrdiff_t x=0; x<v.width(); ++x)
+                for(int c=0; c<num_channels<View>::value; ++c)
+                    dynamic_at_c(it[x], c) = channel_convert<channel_t>(bits8((x*7 + y*13 + c*31) & 255));
+        }
+    }
+
+    /// Accumulates the results, so that the measured calls are not optimized away
+    volatile double sink = 0.;
+
+    template <typename F, typename View>
+    struct apply_functor
+    {
+        apply_functor(const F& f, const View& v) : m_f(f), m_v(v) {}
+        void operator()() const { m_f(m_v); }
+        F m_f;
+        View m_v;
+    };
+
+    template <typename View>
+    struct min_max_run
+    {
+        min_max_run(const View& v) : m_v(v) {}
+        void operator()() const { sink = sink + any_view_min_max()(m_v).second; }
+        View m_v;
+    };
+
+    template <typename View>
+    struct histogram_run
+    {
+        histogram_run(const View& v, double mini, double maxi) : m_v(v), m_min(mini), m_max(maxi) {}
+        void operator()() const { sink = sink + (*histogram_functor(m_min, m_max)(m_v))[0][0]; }
+        View m_v;
+        double m_min, m_max;
+    };
+
+    template <typename View>
+    struct convert_run
+    {
+        convert_run(const channel_converter_functor& cc, const View& src, const dev3n8_view_t& dst) : m_cc(cc), m_src(src), m_dst(dst) {}
+        void operator()() const
+        {
+            for(std::ptrdiff_t y=0; y<m_src.height(); ++y)
+            {
+                typename View::x_iterator src_it = m_src.row_begin(y);
+                dev3n8_view_t::x_iterator dst_it = m_dst.row_begin(y);
+                for(std::ptrdiff_t x=0; x<m_src.width(); ++x)
+                    m_cc(src_it[x], dst_it[x]);
+            }
+        }
+        channel_converter_functor m_cc;
+        View m_src;
+        dev3n8_view_t m_dst;
+    };
+
+    /// Benchmarks of the functors, called for each type of all_image_types
+    struct pixel_benchmarks
+    {
+        pixel_benchmarks(const settings& s, json_writer& out, const boost::shared_array<float>& gamma, int n_gamma, const color_lookup_table& lut) :
+                m_settings(s), m_out(out), m_gamma(gamma), m_n_gamma(n_gamma), m_lut(lut) {}
+
+        template <typename Image>
+        void operator()(Image*) const
+        {
+            typedef typename Image::view_t view_t;
+            const string type(image_type_name<Image>::get());
+            const unsigned int n = m_settings.image_size;
+            Image image(n, n);
+            view_t v = view(image);
+            fill_synthetic(v);
+            pair<double, double> mm = any_view_min_max()(v);
+            unsigned int last = num_channels<view_t>::value-1;
+            channel_converter_functor cc(mm.first, mm.second, m_gamma, m_n_gamma, m_lut, 0, std::min(1u, last), std::min(2u, last));
+
+            vector< pair<string,string> > parameters;
+            parameters.push_back(make_pair(string("image_type"), quoted(type)));
+
+            if(m_out.selected("any_view_min_max"))
+                m_out.write("any_view_min_max", parameters, double(n)*n, measure(min_max_run<view_t>(v), m_settings.repeat));
+            if(m_out.selected("histogram_functor"))
+                m_out.write("histogram_functor", parameters, double(n)*n, measure(histogram_run<view_t>(v, mm.first, mm.second), m_settings.repeat));
+            if(m_out.selected("channel_converter_functor"))
+            {
+                dev3n8_image_t converted(n, n);
+                m_out.write("channel_converter_functor", parameters, double(n)*n, measure(convert_run<view_t>(cc, v, view(converted)), m_settings.repeat));
+            }
+
+            if(!m_out.selected("screen_image_functor"))
+                return;
+            dev3n8_image_t screen(m_settings.screen_width, m_settings.screen_height);
+            gray8_image_t alpha(m_settings.screen_width, m_settings.screen_height);
+            dev3n8_view_t screen_view = view(screen);
+            gray8_view_t alpha_view = view(alpha);
+            const double zooms[] = { 0.5, 1., 2. };
+            for(int o=layer_transform::LO_0; o<=layer_transform::LO_270; ++o)
+                for(unsigned int z=0; z<sizeof(zooms)/sizeof(zooms[0]); ++z)
+                    for(int transparent=0; transparent<2; ++transparent)
+                    {
+                        layer_transform t;
+                        t.zoom_factor(zooms[z]);
+                        t.orientation(static_cast<layer_transform::layerOrientation>(o), n, n);
+                        screen_image_functor f(screen_view, cc, t, alpha_view, mm.first, mm.first + (mm.second-mm.first)/4, 255, transparent!=0);
+                        vector< pair<string,string> > p(parameters);
+                        p.push_back(make_pair(string("orientation"), quoted(orientation_name(t.orientation()))));
+                        p.push_back(make_pair(string("zoom"), value(zooms[z])));
+                        p.push_back(make_pair(string("transparent"), string(transparent ? "true" : "false")));
+                        m_out.write("screen_image_functor", p, double(m_settings.screen_width)*m_settings.screen_height,
+                                    measure(apply_functor<screen_image_functor, view_t>(f, v), m_settings.repeat));
+                    }
+        }
+
+        const settings& m_settings;
+        json_writer& m_out;
+        const boost::shared_array<float>& m_gamma;
+        int m_n_gamma;
+        const color_lookup_table& m_lut;
+    };
+
+    void load_file(const string& extension, const string& filename)
+    {
+        boost::shared_ptr<gilviewer_file_io> file = PatternSingleton<gilviewer_io_factory>::instance()->create_object(extension);
+        if(!file->load(filename))
+            throw runtime_error("no layer");
+    }
+
+    /// Writes a synthetic file, then measures its loading through the io factory
+    template <typename Image, typename Tag>
+    void loader_benchmark(const settings& s, json_writer& out, const boost::filesystem::path& dir, const string& extension)
+    {
+        const string type(image_type_name<Image>::get());
+        vector< pair<string,string> > parameters;
+        parameters.push_back(make_pair(string("format"), quoted(extension)));
+        parameters.push_back(make_pair(string("image_type"), quoted(type)));
+        string filename = (dir / ("gilviewer_bench_" + type + "." + extension)).string();
+        try
+        {
+            Image image(s.image_size, s.image_size);
+            fill_synthetic(view(image));
+            write_view(filename, const_view(image), Tag());
+            out.write("io_load", parameters, double(s.image_size)*s.image_size, measure(boost::bind(&load_file, extension, filename), s.repeat));
+        }
+        catch(const std::exception& e)
+        {
+            out.write("io_load", parameters, 0., vector<double>(), e.what());
+        }
+        boost::system::error_code ec;
+        boost::filesystem::remove(filename, ec);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    settings s;
+    try
+    {
+        for(int i=1; i<argc; ++i)
+        {
+            string arg(argv[i]);
+            if(arg=="-h" || arg=="--help" || i+1==argc)
+            {
+                usage(arg=="-h" || arg=="--help" ? cout : cerr);
+                return arg=="-h" || arg=="--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
+            string v(argv[++i]);
+            if(arg=="--image")
+                s.image_size = boost::lexical_cast<unsigned int>(v);
+            else if(arg=="--screen")
+            {
+                char x;
+                istringstream iss(v);
+                if(!(iss >> s.screen_width >> x >> s.screen_height) || x!='x')
+                    throw invalid_argument("Invalid screen size: " + v);
+            }
+            else if(arg=="--repeat")
+                s.repeat = std::max(1u, boost::lexical_cast<unsigned int>(v));
+            else if(arg=="--filter")
+                s.filter = v;
+            else
+                throw invalid_argument("Unknown option: " + arg);
+        }
+    }
+    catch(const std::exception& e)
+    {
+        cerr << e.what() << endl;
+        usage(cerr);
+        return EXIT_FAILURE;
+    }
+
+    wxInitializer initializer;
+    register_all_file_formats(PatternSingleton<gilviewer_io_factory>::instance());
+    // The loaders must compute the statistics each time
+    image_stats_cache::instance()->enabled(false);
+
+    // Gamma 1 and gray LUT, as a new image layer
+    const int n_gamma = 1000;
+    boost::shared_array<float> gamma(new float[n_gamma+1]);
+    for(int i=0; i<=n_gamma; ++i)
+        gamma[i] = static_cast<float>(i)/n_gamma;
+    color_lookup_table lut;
+
+    json_writer out(cout, s);
+    boost::mpl::for_each<all_image_types, boost::add_pointer<boost::mpl::_1> >(pixel_benchmarks(s, out, gamma, n_gamma, lut));
+
+    if(out.selected("io_load"))
+    {
+        boost::filesystem::path dir(boost::filesystem::temp_directory_path());
+        loader_benchmark<gray8_image_t , png_tag >(s, out, dir, "png");
+        loader_benchmark<gray16_image_t, png_tag >(s, out, dir, "png");
+        loader_benchmark<rgb8_image_t  , png_tag >(s, out, dir, "png");
+        loader_benchmark<rgba8_image_t , png_tag >(s, out, dir, "png");
+        loader_benchmark<gray8_image_t , tiff_tag>(s, out, dir, "tif");
+        loader_benchmark<gray16_image_t, tiff_tag>(s, out, dir, "tif");
+        loader_benchmark<gray32F_image_t, tiff_tag>(s, out, dir, "tif");
+        loader_benchmark<rgb8_image_t  , tiff_tag>(s, out, dir, "tif");
+    }
+    return EXIT_SUCCESS;
+}
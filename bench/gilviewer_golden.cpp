@@ -0,0 +1,601 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+
+/**
+ * gilviewer_golden renders a fixed set of synthetic scenes through the rendering path of the layers, and checks that
+ * an optimization of the pixel pipeline neither changes the pictures nor slows them down:
+ *  - each frame is compared bit-exactly with its golden output (<golden>/<scene>.png)
+ *  - the median time of each frame is compared with the baseline (<local>/timings.txt), within a tolerance
+ *
+ * With --update, the goldens and the baseline are written instead. The image scenes and dense_vectors_offscreen are
+ * rendered by offscreen_renderer, without wx: their goldens are part of the sources (bench/golden), and the test
+ * registered with CMake compares them (--no-vectors --no-timings). The dense_vectors scene draws through a wxMemoryDC,
+ * as the panel does: it needs a display (e.g. Xvfb), or is skipped with --no-vectors. Its golden depends on the
+ * wxWidgets port and the baseline on the machine: both are machine-local (<local>), recorded before the change.
+ * Without --update, a scene without golden, or without baseline when the timings are compared, fails. A frame which
+ * differs is written in the local directory (<local>/<scene>.actual.png).
+ **/
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/gil/extension/io_new/png_all.hpp>
+
+#include <wx/app.h>
+#include <wx/bitmap.h>
+#include <wx/dcmemory.h>
+#include <wx/image.h>
+#include <wx/init.h>
+
+#include "GilViewer/io/gilviewer_io_factory.hpp"
+#include "GilViewer/layers/image_types.hpp"
+#include "GilViewer/layers/image_layer.hpp"
+#include "GilViewer/layers/simple_vector_layer.hpp"
+#include "GilViewer/layers/offscreen_renderer.hpp"
+#include "GilViewer/tools/color_lookup_table.hpp"
+#include "GilViewer/tools/image_stats_cache.hpp"
+#include "GilViewer/tools/pattern_singleton.hpp"
+
+using namespace std;
+using namespace boost::gil;
+
+namespace
+{
+    const unsigned int frame_width = 640, frame_height = 480;
+
+    struct options
+    {
+        string golden, local;
+        bool update, vectors, timings;
+        double tolerance;
+        unsigned int repeat;
+        string filter;
+        options() : golden("bench/golden"), local("golden.local"), update(false), vectors(true), timings(true), tolerance(0.15), repeat(5) {}
+    };
+
+    void usage(ostream& os)
+    {
+        os << "Usage: gilviewer_golden [options]\n"
+           << "Renders the synthetic scenes and compares the frames and their timings with the goldens.\n"
+           << "  --golden DIR      directory of the goldens of the offscreen scenes (default: bench/golden)\n"
+           << "  --local DIR       directory of the machine-local golden of the wxDC scene, of the baseline and of the\n"
+           << "                    frames which differ (default: golden.local)\n"
+           << "  --update          writes the goldens and the baseline instead of comparing\n"
+           << "  --tolerance T     accepted slowdown, relative to the baseline (default: 0.15)\n"
+           << "  --repeat N        timed runs of each frame, after a warm-up run (default: 5)\n"
+           << "  --no-timings      only compares the frames\n"
+           << "  --no-vectors      skips the vector scene drawn through a wxDC (no display)\n"
+           << "  --filter S        only the scenes whose name contains S\n"
+           << "  -h, --help        this message\n";
+    }
+
+    bool parse(int argc, char** argv, options& o)
+    {
+        for(int i=1; i<argc; ++i)
+        {
+            string arg(argv[i]);
+            if(arg=="-h" || arg=="--help")
+                return false;
+            else if(arg=="--update")
+                o.update = true;
+            else if(arg=="--no-timings")
+                o.timings = false;
+            else if(arg=="--no-vectors")
+                o.vectors = false;
+            else
+            {
+                if(i+1==argc)
+                    throw invalid_argument("Missing value of option " + arg);
+                string value(argv[++i]);
+                if(arg=="--golden")
+                    o.golden = value;
+                else if(arg=="--local")
+                    o.local = value;
+                else if(arg=="--tolerance")
+                    o.tolerance = boost::lexical_cast<double>(value);
+                else if(arg=="--repeat")
+                    o.repeat = std::max(1u, boost::lexical_cast<unsigned int>(value));
+                else if(arg=="--filter")
+                    o.filter = value;
+                else
+                    throw invalid_argument("Unknown option: " + arg);
+            }
+        }
+        return true;
+    }
+
+    /// Deterministic pattern (integer arithmetic only, so that the goldens do not depend on the math library):
+    /// gradients, a checkerboard and thin lines, in [0,1023]
+    unsigned int pattern(std::ptrdiff_t x, std::ptrdiff_t y, int c)
+    {
+        unsigned int v = static_cast<unsigned int>((x*3 + y*5 + c*211) % 1024);
+        if(((x>>6) + (y>>6)) & 1)
+            v = 1023 - v;
+        if(x%97==0 || y%89==0)
+            v = (c&1) ? 0 : 1023;
+        return v;
+    }
+
+    template <typename Channel> Channel synthetic_channel(unsigned int v) { return channel_convert<Channel>(bits16(v*64)); }
+    template <> bits32F synthetic_channel<bits32F>(unsigned int v) { return v/511.5f - 1.f; }
+
+    template <typename Image>
+    image_layer::image_ptr synthetic_image(unsigned int width, unsigned int height)
+    {
+        typedef typename Image::view_t view_t;
+        typedef typename channel_type<view_t>::type channel_t;
+        Image image(width, height);
+        view_t v = view(image);
+        for(std::ptrdiff_t y=0; y<v.height(); ++y)
+        {
+            typename view_t::x_iterator it = v.row_begin(y);
+            for(std::ptrdiff_t x=0; x<v.width(); ++x)
+                for(int c=0; c<num_channels<view_t>::value; ++c)
+                    dynamic_at_c(it[x], c) = synthetic_channel<channel_t>(pattern(x, y, c));
+        }
+        image_layer::image_ptr result(new image_layer::image_t);
+        result->value.move_in(image);
+        return result;
+    }
+
+    template <typename Image>
+    boost::shared_ptr<image_layer> synthetic_layer(unsigned int width, unsigned int height, const string& name)
+    {
+        return boost::dynamic_pointer_cast<image_layer>(image_layer::create_image_layer(synthetic_image<Image>(width, height), name));
+    }
+
+    /// Viewport showing the rectangle [0,width]x[0,height] centered in the frame
+    layer_transform fit(double width, double height)
+    {
+        double zoom = std::max(width/frame_width, height/frame_height);
+        layer_transform t;
+        t.zoom_factor(zoom);
+        t.translation_x(frame_width *zoom/2 - width /2);
+        t.translation_y(frame_height*zoom/2 - height/2);
+        return t;
+    }
+
+    layer_transform viewport(double zoom, double tx, double ty)
+    {
+        layer_transform t;
+        t.zoom_factor(zoom);
+        t.translation_x(tx);
+        t.translation_y(ty);
+        return t;
+    }
+
+    struct scene
+    {
+        vector<layer::ptrLayerType> layers;
+        layer_transform viewport;
+        /// The layers are drawn through a wxDC, as by the panel, instead of offscreen_renderer
+        bool vectors;
+        scene() : vectors(false) {}
+    };
+
+    scene gray16_large()
+    {
+        scene s;
+        s.layers.push_back(synthetic_layer<gray16_image_t>(6000, 6000, "gray16_large"));
+        s.viewport = fit(6000, 6000);
+        return s;
+    }
+
+    scene rgb8()
+    {
+        scene s;
+        s.layers.push_back(synthetic_layer<rgb8_image_t>(2048, 2048, "rgb8"));
+        s.viewport = viewport(1., -700., -800.);
+        return s;
+    }
+
+    scene gray32f()
+    {
+        scene s;
+        s.layers.push_back(synthetic_layer<gray32F_image_t>(1024, 1024, "gray32f"));
+        s.viewport = viewport(0.25, -400., -300.);
+        return s;
+    }
+
+    scene rotated()
+    {
+        scene s;
+        boost::shared_ptr<image_layer> l = synthetic_layer<rgb8_image_t>(1500, 1000, "rotated");
+        l->transform().orientation(layer_transform::LO_90, l->width(), l->height());
+        s.layers.push_back(l);
+        s.viewport = fit(1000, 1500);
+        return s;
+    }
+
+    scene transparent()
+    {
+        scene s;
+        s.layers.push_back(synthetic_layer<rgb8_image_t>(1024, 1024, "background"));
+        boost::shared_ptr<image_layer> l = synthetic_layer<gray8_image_t>(1024, 1024, "transparent");
+        l->transparent(true);
+        l->transparency_min(64.);
+        l->transparency_max(128.);
+        l->alpha(160);
+        s.layers.push_back(l);
+        s.viewport = fit(1024, 1024);
+        return s;
+    }
+
+    scene clut()
+    {
+        scene s;
+        boost::shared_ptr<image_layer> l = synthetic_layer<gray8_image_t>(2048, 2048, "clut");
+        l->colorlookuptable()->create_heat();
+        l->gamma(1.5);
+        s.layers.push_back(l);
+        s.viewport = fit(2048, 2048);
+        return s;
+    }
+
+    boost::shared_ptr<simple_vector_layer> dense_vector_layer()
+    {
+        const std::size_t n_points = 300000, n_polylines = 20000, n_polygons = 5000, n_vertices = 8;
+        boost::shared_ptr<simple_vector_layer> l(new simple_vector_layer("dense_vectors"));
+
+        vector<double> x, y;
+        for(std::size_t i=0; i<n_points; ++i)
+        {
+            x.push_back(static_cast<double>((i*7919) % 4093));
+            y.push_back(static_cast<double>((i*104729) % 4091));
+        }
+        l->add_points(&x.front(), &y.front(), n_points);
+
+        // Polylines and polygons: n_vertices vertices around a center
+        vector<std::size_t> offsets;
+        x.clear(); y.clear();
+        for(std::size_t i=0; i<n_polylines+n_polygons; ++i)
+        {
+            if(i==n_polylines)
+            {
+                offsets.push_back(x.size());
+                l->add_polylines(&x.front(), &y.front(), &offsets.front(), n_polylines);
+                offsets.clear(); x.clear(); y.clear();
+            }
+            offsets.push_back(x.size());
+            double cx = static_cast<double>((i*2654435761u) % 4000), cy = static_cast<double>((i*40503u) % 4000);
+            for(std::size_t j=0; j<n_vertices; ++j)
+            {
+                x.push_back(cx + static_cast<double>((i+j*13) % 48));
+                y.push_back(cy + static_cast<double>((i*3+j*29) % 48));
+            }
+        }
+        offsets.push_back(x.size());
+        l->add_polygons(&x.front(), &y.front(), &offsets.front(), n_polygons);
+
+        l->point_rendering(layer::POINTS_DENSITY, false);
+        l->line_color(wxColour(0, 128, 255), false);
+        l->polygon_border_color(wxColour(255, 64, 0), false);
+        return l;
+    }
+
+    scene dense_vectors()
+    {
+        boost::shared_ptr<simple_vector_layer> l = dense_vector_layer();
+        l->transform() = fit(4096., 4096.);
+        // The levels of detail must not change between the frames
+        l->wait_lod();
+
+        scene s;
+        s.layers.push_back(l);
+        s.vectors = true;
+        return s;
+    }
+
+    /// Same geometries, rasterised without display (each point is drawn: no density map)
+    scene dense_vectors_offscreen()
+    {
+        scene s;
+        s.layers.push_back(dense_vector_layer());
+        s.viewport = fit(4096., 4096.);
+        return s;
+    }
+
+    void render(const scene& s, rgba8_image_t& frame)
+    {
+        if(!s.vectors)
+        {
+            offscreen_renderer renderer(frame_width, frame_height);
+            renderer.viewport(s.viewport);
+            if(renderer.render(s.layers, frame))
+                throw runtime_error("offscreen_renderer skipped a layer");
+            return;
+        }
+
+        wxBitmap bitmap(frame_width, frame_height);
+        {
+            wxMemoryDC dc;
+            dc.SelectObject(bitmap);
+            dc.SetBackground(*wxWHITE_BRUSH);
+            dc.Clear();
+            for(vector<layer::ptrLayerType>::const_iterator it=s.layers.begin(); it!=s.layers.end(); ++it)
+            {
+                // Renders the geometries, not the cached raster of the previous frame
+                (*it)->update(frame_width, frame_height);
+                (*it)->draw(dc, 0, 0, true);
+            }
+            dc.SelectObject(wxNullBitmap);
+        }
+        wxImage image(bitmap.ConvertToImage());
+        frame.recreate(frame_width, frame_height);
+        copy_pixels(color_converted_view<rgba8_pixel_t>(interleaved_view(frame_width, frame_height, reinterpret_cast<const rgb8_pixel_t*>(image.GetData()), frame_width*3)), view(frame));
+    }
+
+    /// Median duration of a frame, in milliseconds, after a warm-up frame
+    double measure(const scene& s, unsigned int repeat, rgba8_image_t& frame)
+    {
+        using namespace boost::posix_time;
+        render(s, frame);
+        vector<double> durations;
+        for(unsigned int i=0; i<repeat; ++i)
+        {
+            ptime start = microsec_clock::universal_time();
+            render(s, frame);
+            durations.push_back((microsec_clock::universal_time()-start).total_microseconds()/1000.);
+        }
+        sort(durations.begin(), durations.end());
+        return durations[durations.size()/2];
+    }
+
+    /// Number of pixels which differ, and the largest difference of a channel
+    pair<std::size_t, int> compare(const rgba8_view_t& a, const rgba8_view_t& b)
+    {
+        pair<std::size_t, int> result(0, 0);
+        for(std::ptrdiff_t y=0; y<a.height(); ++y)
+        {
+            rgba8_view_t::x_iterator it_a = a.row_begin(y), it_b = b.row_begin(y);
+            for(std::ptrdiff_t x=0; x<a.width(); ++x)
+            {
+                if(it_a[x]==it_b[x])
+                    continue;
+                ++result.first;
+                for(int c=0; c<4; ++c)
+                    result.second = std::max(result.second, std::abs(static_cast<int>(it_a[x][c]) - static_cast<int>(it_b[x][c])));
+            }
+        }
+        return result;
+    }
+
+    map<string, double> read_timings(const boost::filesystem::path& filename)
+    {
+        map<string, double> timings;
+        ifstream ifs(filename.string().c_str());
+        string name;
+        double ms;
+        while(ifs >> name >> ms)
+            timings[name] = ms;
+        return timings;
+    }
+
+    void write_timings(const boost::filesystem::path& filename, const map<string, double>& timings)
+    {
+        ofstream ofs(filename.string().c_str());
+        for(map<string, double>::const_iterator it=timings.begin(); it!=timings.end(); ++it)
+            ofs << it->first << " " << it->second << "\n";
+        if(!ofs)
+            throw runtime_error("Unable to write " + filename.string());
+    }
+
+    typedef scene (*scene_factory)();
+
+    struct scene_entry
+    {
+        scene_entry(const string& n, scene_factory f, bool l=false) : name(n), factory(f), local(l) {}
+        string name;
+        scene_factory factory;
+        /// The golden depends on the wxWidgets port: it is kept in the local directory
+        bool local;
+    };
+
+    /// Application without window: the vector scene needs the GUI library to be initialized
+    class golden_app : public wxApp
+    {
+    public:
+        virtual bool OnInit() { return true; }
+    };
+}
+
+IMPLEMENT_APP_NO_MAIN(golden_app)
+
+int main(int argc, char** argv)
+{
+    options o;
+    try
+    {
+        if(!parse(argc, argv, o))
+        {
+            usage(cout);
+            return EXIT_FAILURE;
+        }
+    }
+    catch(const std::exception& e)
+    {
+        cerr << e.what() << endl;
+        usage(cerr);
+        return EXIT_FAILURE;
+    }
+
+    boost::scoped_ptr<wxInitializer> initializer;
+    if(o.vectors)
+    {
+        if(!wxEntryStart(argc, argv) || !wxTheApp->CallOnInit())
+        {
+            cerr << "Unable to initialize wxWidgets (no display?): use --no-vectors" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    else
+        initializer.reset(new wxInitializer);
+    register_all_file_formats(PatternSingleton<gilviewer_io_factory>::instance());
+    // The synthetic layers have no file: their statistics must not be shared through the cache
+    image_stats_cache::instance()->enabled(false);
+
+    vector<scene_entry> scenes;
+    scenes.push_back(scene_entry("gray16_large", &gray16_large));
+    scenes.push_back(scene_entry("rgb8", &rgb8));
+    scenes.push_back(scene_entry("gray32f", &gray32f));
+    scenes.push_back(scene_entry("rotated", &rotated));
+    scenes.push_back(scene_entry("transparent", &transparent));
+    scenes.push_back(scene_entry("clut", &clut));
+    scenes.push_back(scene_entry("dense_vectors_offscreen", &dense_vectors_offscreen));
+    if(o.vectors)
+        scenes.push_back(scene_entry("dense_vectors", &dense_vectors, true));
+
+    boost::filesystem::path golden(o.golden), local(o.local);
+    const boost::filesystem::path timings_file = local / "timings.txt";
+    if(!o.update && !boost::filesystem::is_directory(golden))
+    {
+        cerr << "No golden directory " << golden.string() << ": record the goldens with --update before the change" << endl;
+        return EXIT_FAILURE;
+    }
+    map<string, double> baseline = read_timings(timings_file), timings(baseline);
+
+    unsigned int failed = 0;
+    for(vector<scene_entry>::const_iterator it=scenes.begin(); it!=scenes.end(); ++it)
+    {
+        const string& name = it->name;
+        if(!o.filter.empty() && name.find(o.filter)==string::npos)
+            continue;
+        const boost::filesystem::path golden_file = (it->local ? local : golden) / (name + ".png");
+        try
+        {
+            rgba8_image_t frame;
+            double ms;
+            {
+                scene s = it->factory();
+                ms = measure(s, o.repeat, frame);
+            }
+            cout << setw(14) << left << name << " " << fixed << setprecision(2) << setw(9) << right << ms << " ms";
+
+            if(o.update)
+            {
+                boost::filesystem::create_directories(golden_file.parent_path());
+                write_view(golden_file.string(), const_view(frame), png_tag());
+                timings[name] = ms;
+                cout << "  golden written" << endl;
+                continue;
+            }
+
+            bool ok = true;
+            if(!boost::filesystem::exists(golden_file))
+            {
+                cout << "  no golden (run with --update)";
+                ok = false;
+            }
+            else
+            {
+                rgba8_image_t expected;
+                read_image(golden_file.string(), expected, png_tag());
+                if(expected.dimensions()!=frame.dimensions())
+                {
+                    cout << "  FRAME: size differs from the golden";
+                    ok = false;
+                }
+                else
+                {
+                    pair<std::size_t, int> diff = compare(view(expected), view(frame));
+                    if(diff.first)
+                    {
+                        cout << "  FRAME: " << diff.first << " pixel(s) differ (max " << diff.second << ")";
+                        ok = false;
+                    }
+                    else
+                        cout << "  frame identical";
+                }
+                if(!ok)
+                {
+                    boost::filesystem::create_directories(local);
+                    write_view((local / (name + ".actual.png")).string(), const_view(frame), png_tag());
+                }
+            }
+
+            map<string, double>::const_iterator b = baseline.find(name);
+            if(o.timings && (b==baseline.end() || b->second<=0.))
+            {
+                cout << ", no baseline (run with --update)";
+                ok = false;
+            }
+            else if(o.timings)
+            {
+                double change = ms/b->second - 1.;
+                cout << ", " << showpos << setprecision(1) << 100.*change << noshowpos << "% vs baseline";
+                if(change>o.tolerance)
+                {
+                    cout << " (TIME: above the tolerance of " << 100.*o.tolerance << "%)";
+                    ok = false;
+                }
+            }
+            cout << endl;
+            if(!ok)
+                ++failed;
+        }
+        catch(const std::exception& e)
+        {
+            cout << endl;
+            cerr << name << ": " << e.what() << endl;
+            ++failed;
+        }
+    }
+
+    if(o.update && o.timings)
+    {
+        boost::filesystem::create_directories(local);
+        write_timings(timings_file, timings);
+    }
+    if(failed)
+        cerr << failed << " scene(s) failed" << endl;
+    if(o.vectors)
+        wxEntryCleanup();
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
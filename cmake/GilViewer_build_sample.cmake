@@ -20,6 +20,27 @@ add_executable( GilViewerApp ${SYSTEM_NAME} ${VIEWER_APP_SOURCES} )
 target_link_libraries( GilViewerApp ${GILVIEWER_LINK_EXTERNAL_LIBRARIES} GilViewer )
 message(STATUS " GILVIEWER_LINK_EXTERNAL_LIBRARIES ${GILVIEWER_LINK_EXTERNAL_LIBRARIES} ")
 
+####
+#### Batch renderer of quick-looks, without display
+####
+add_executable( GilViewerBatch ./batch_app/gilviewer_batch.cpp )
+target_link_libraries( GilViewerBatch ${GILVIEWER_LINK_EXTERNAL_LIBRARIES} GilViewer )
+
+####
+#### Benchmark of the pixel pipeline (JSON on the standard output), and golden-frame regression harness
+####
+option( BUILD_GILVIEWER_BENCH "Build the benchmark and the golden-frame harness of the pixel pipeline" OFF )
+if( BUILD_GILVIEWER_BENCH )
+	add_executable( gilviewer_bench ./bench/gilviewer_bench.cpp )
+	target_link_libraries( gilviewer_bench ${GILVIEWER_LINK_EXTERNAL_LIBRARIES} GilViewer )
+	add_executable( gilviewer_golden ./bench/gilviewer_golden.cpp )
+	target_link_libraries( gilviewer_golden ${GILVIEWER_LINK_EXTERNAL_LIBRARIES} GilViewer )
+	# The goldens of the offscreen scenes are part of the sources (bench/golden); the golden of the wxDC scene and the
+	# timings depend on the machine and are not compared here
+	enable_testing()
+	add_test( gilviewer_golden gilviewer_golden --no-vectors --no-timings --golden ${CMAKE_CURRENT_SOURCE_DIR}/bench/golden --local ${CMAKE_CURRENT_BINARY_DIR}/golden.local )
+endif()
+
 message( STATUS "*** Scanning samples ***" )
 file( GLOB list "samples/*" )
 list( SORT list )
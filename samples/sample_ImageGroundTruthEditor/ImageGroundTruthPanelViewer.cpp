@@ -492,14 +492,30 @@ void ImageGroundTruthPanelViewer::CheckIfSaved()
 void ImageGroundTruthPanelViewer::LoadBoxes(vector_layer_ptr_t & p_layer, const std::vector < GroundTruthBox > & v_boxes)
 {
     std::vector < GroundTruthBox >::const_iterator box_it;
+    std::vector < double > v_x, v_y;
+    std::vector < std::size_t > v_offsets(1, 0);
 
     try
     {
         p_layer->clear();
+        // All the boxes are added at once
+        v_x.reserve(4 * v_boxes.size());
+        v_y.reserve(4 * v_boxes.size());
         for(box_it = v_boxes.begin(); box_it < v_boxes.end(); ++ box_it)
         {
-            AddBox(p_layer, * box_it);
+            v_x.push_back(box_it->GetXMin());
+            v_x.push_back(box_it->GetXMax());
+            v_x.push_back(box_it->GetXMax());
+            v_x.push_back(box_it->GetXMin());
+            v_y.push_back(box_it->GetYMin());
+            v_y.push_back(box_it->GetYMin());
+            v_y.push_back(box_it->GetYMax());
+            v_y.push_back(box_it->GetYMax());
+            v_offsets.push_back(v_x.size());
         }
+        if(! v_boxes.empty())
+            p_layer->add_polygons(& v_x.front(), & v_y.front(), & v_offsets.front(), v_boxes.size());
+        Refresh();
     }
     catch( ... )
     {
@@ -554,23 +570,15 @@ void ImageGroundTruthPanelViewer::AddBox(vector_layer_ptr_t & p_layer, const Gro
 void ImageGroundTruthPanelViewer::RemoveLastBox(vector_layer_ptr_t & p_layer)
 {
     std::vector < double > v_x, v_y;
-    std::vector < std::vector < double > > v_polygon_x, v_polygon_y;
-    std::vector < std::vector < double > >::iterator polygon_x_it, polygon_y_it;
+    std::vector < std::size_t > v_offsets(1, 0);
 
     for(int i = 0; i < ((int) p_layer->num_polygons()) - 1; ++ i)
     {
-        v_x.clear();
-        v_y.clear();
         p_layer->get_polygon(i, v_x, v_y);
-        v_polygon_x.push_back(v_x);
-        v_polygon_y.push_back(v_y);
+        v_offsets.push_back(v_x.size());
     }
     p_layer->clear();
-    polygon_x_it = v_polygon_x.begin();
-    polygon_y_it = v_polygon_y.begin();
-    for(; polygon_x_it < v_polygon_x.end(); ++ polygon_x_it, ++ polygon_y_it)
-    {
-        p_layer->add_polygon(* polygon_x_it, * polygon_y_it);
-    }
+    if(! v_x.empty())
+        p_layer->add_polygons(& v_x.front(), & v_y.front(), & v_offsets.front(), v_offsets.size() - 1);
     Refresh();
 }
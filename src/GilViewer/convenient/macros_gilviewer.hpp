@@ -65,7 +65,10 @@ Authors:
         EVT_TOOL(ID_GEOMETRY_RECTANGLE, classname::on_geometry_rectangle) \
         EVT_TOOL(ID_GEOMETRY_LINE, classname::on_geometry_line) \
         EVT_TOOL(ID_GEOMETRY_POLYGONE, classname::on_geometry_polygone) \
-        EVT_TOOL(ID_CROP, classname::on_crop)
+        EVT_TOOL(ID_CROP, classname::on_crop) \
+        EVT_TOOL(ID_PROFILING_TRACE, classname::on_profiling_trace) \
+        EVT_TOOL(ID_PROFILING_OVERLAY, classname::on_profiling_overlay) \
+        EVT_TOOL(ID_PROFILING_DUMP, classname::on_profiling_dump)
 
 
 
@@ -88,7 +91,10 @@ Authors:
         void on_geometry_rectangle(wxCommandEvent& event); \
         void on_geometry_line(wxCommandEvent& event); \
         void on_geometry_polygone(wxCommandEvent& event); \
-        void on_crop(wxCommandEvent& event);
+        void on_crop(wxCommandEvent& event); \
+        void on_profiling_trace(wxCommandEvent& event); \
+        void on_profiling_overlay(wxCommandEvent& event); \
+        void on_profiling_dump(wxCommandEvent& event);
 
 /**
  * Comme son nom l'indique, cette macro permet d'implementer les evenements "classiques" de la table d'evenements.
@@ -165,6 +171,18 @@ Authors:
         void classname::on_crop(wxCommandEvent& event) \
 	{ \
                 variablePanelViewer->crop(); \
+	} \
+        void classname::on_profiling_trace(wxCommandEvent& event) \
+	{ \
+                variablePanelViewer->toggle_tracing(); \
+	} \
+        void classname::on_profiling_overlay(wxCommandEvent& event) \
+	{ \
+                variablePanelViewer->toggle_profiling_overlay(); \
+	} \
+        void classname::on_profiling_dump(wxCommandEvent& event) \
+	{ \
+                variablePanelViewer->dump_profiling(); \
 	}
 
 #define INTERNAL_LOG_INFOS() \
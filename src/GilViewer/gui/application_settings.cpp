@@ -55,21 +55,40 @@ Authors:
 #include <wx/checkbox.h>
 #include <wx/slider.h>
 #include <wx/choice.h>
+#include <wx/stattext.h>
 #include <wx/pen.h>
 #include <wx/brush.h>
+#include <wx/stdpaths.h>
 
 #include "../gui/application_settings.hpp"
 #include "../gui/vector_layer_settings_control.hpp"
+#include "../gui/define_id.hpp"
 
 #include "../convenient/wxhelper.hpp"
+#include "../tools/image_stats_cache.hpp"
+#include "../tools/thread_pool.hpp"
+#include "../tools/memory_manager.hpp"
 #include "../config/config_plugins.hpp"
 
 BEGIN_EVENT_TABLE(application_settings, wxDialog)
         EVT_CLOSE(application_settings::on_close_window)
         EVT_BUTTON(wxID_APPLY,application_settings::on_apply_button)
         EVT_BUTTON(wxID_RESET,application_settings::on_reset_plugins)
+        EVT_CHECKBOX(ID_PROFILING_OVERLAY,application_settings::on_profiling_overlay)
         END_EVENT_TABLE()
 
+namespace
+{
+    /// Default of /Paths/Cache: a per-user directory, so that nothing is written next to shared or read-only images
+    wxString default_cache_directory()
+    {
+        return wxStandardPaths::Get().GetUserDataDir() + wxFILE_SEP_PATH + wxT("cache");
+    }
+}
+
+long application_settings::m_frameInterval = 40;
+bool application_settings::m_profilingOverlay = false;
+
         application_settings::application_settings(wxWindow *parent, wxWindowID id, const wxString& title, long style, const wxPoint& pos, const wxSize& size) :
 	wxDialog(parent, id, title, pos, size, style)
 {
@@ -120,6 +139,24 @@ BEGIN_EVENT_TABLE(application_settings, wxDialog)
     pConfig->Read(wxT("/Options/Dezoom"), &deZoom_, 2.);
     pConfig->Read(wxT("/Options/LoadWoleImage"), &m_loadWholeImage, true);
     pConfig->Read(wxT("/Options/BilinearZoom"), &m_bilinearZoom, false);
+
+    // Statistics cache
+    pConfig->Read(wxT("/Options/StatsCache"), &m_statsCache, true);
+    pConfig->Read(wxT("/Paths/Cache"), &str, default_cache_directory());
+    image_stats_cache::instance()->enabled(m_statsCache);
+    image_stats_cache::instance()->directory(std::string(str.mb_str()));
+
+    // Worker threads (0: one per hardware thread)
+    pConfig->Read(wxT("/Options/Threads"), &m_threads, 0);
+    if (m_threads > 0)
+        thread_pool::instance()->size(m_threads);
+
+    // Memory budget of the layers, in MB (0: no limit)
+    pConfig->Read(wxT("/Options/MemoryBudget"), &m_memoryBudget, 0);
+    memory_manager::instance()->budget(static_cast<std::size_t>(m_memoryBudget)*1024*1024);
+
+    // Previews of zooms and pans (see panel_viewer::schedule_render)
+    pConfig->Read(wxT("/Options/FrameInterval"), &m_frameInterval, 40);
 }
 
 
@@ -157,6 +194,13 @@ wxPanel* application_settings::create_paths_settings_panel()
     boxSizerPlugins->Add(dirPickerPlugins, 1, wxALIGN_CENTER_VERTICAL | wxALIGN_CENTER_HORIZONTAL, 5);
     boxSizerPlugins->Add(new wxButton(panel, wxID_RESET, _("Reset")), 0, wxALIGN_CENTER_VERTICAL | wxALIGN_RIGHT, 5);
     mainSizer->Add(boxSizerPlugins, 0, wxEXPAND | wxHORIZONTAL, 5);
+
+    // Statistics cache directory (empty: cache files are written next to the images)
+    pConfig->Read(wxT("/Paths/Cache"), &str, default_cache_directory());
+    wxStaticBoxSizer *boxSizerCache = new wxStaticBoxSizer(wxHORIZONTAL, panel, _("Statistics cache directory (empty: next to the images)"));
+    dirPickerCache = new wxDirPickerCtrl(panel, wxID_ANY, str, _("Select statistics cache directory"), wxDefaultPosition, wxDefaultSize, wxDIRP_USE_TEXTCTRL);
+    boxSizerCache->Add(dirPickerCache, 1, wxALIGN_CENTER_VERTICAL | wxALIGN_CENTER_HORIZONTAL, 5);
+    mainSizer->Add(boxSizerCache, 0, wxEXPAND | wxHORIZONTAL, 5);
     mainSizer->Add(new wxButton(panel, wxID_APPLY, wxT("Apply")), 0, wxALIGN_CENTER_HORIZONTAL, 5);
 
     mainSizer->SetSizeHints(panel);
@@ -166,6 +210,25 @@ wxPanel* application_settings::create_paths_settings_panel()
     return panel;
 }
 
+void application_settings::profiling_overlay(bool show)
+{
+    m_profilingOverlay = show;
+    wxConfigBase::Get()->Write(wxT("/Options/ProfilingOverlay"), show);
+}
+
+void application_settings::on_profiling_overlay(wxCommandEvent&)
+{
+    profiling_overlay(m_checkBoxProfilingOverlay->GetValue());
+    GetParent()->Refresh();
+}
+
+bool application_settings::Show(bool show)
+{
+    if (show)
+        m_checkBoxProfilingOverlay->SetValue(m_profilingOverlay);
+    return wxDialog::Show(show);
+}
+
 void application_settings::on_reset_plugins(wxCommandEvent&)
 {
     dirPickerPlugins->SetPath(wxString(plugins_dir.c_str(), *wxConvCurrent));
@@ -213,6 +276,32 @@ wxPanel* application_settings::create_options_settings_panel()
 
     boxSizerPerformance->Add(m_checkBoxLoadWholeImage, 1, wxALIGN_CENTER_VERTICAL | wxALIGN_CENTER_HORIZONTAL, 5);
 
+    m_checkBoxStatsCache = new wxCheckBox(panel, wxID_ANY, _("Cache image statistics on disk"));
+    pConfig->Read(wxT("/Options/StatsCache"), &m_statsCache, true);
+    m_checkBoxStatsCache->SetValue(m_statsCache);
+
+    boxSizerPerformance->Add(m_checkBoxStatsCache, 1, wxALIGN_CENTER_VERTICAL | wxALIGN_CENTER_HORIZONTAL, 5);
+
+    // Applied as soon as it is checked, as the F11 shortcut
+    m_checkBoxProfilingOverlay = new wxCheckBox(panel, ID_PROFILING_OVERLAY, _("Show timings (F11)"));
+    pConfig->Read(wxT("/Options/ProfilingOverlay"), &m_profilingOverlay, false);
+    m_checkBoxProfilingOverlay->SetValue(m_profilingOverlay);
+    boxSizerPerformance->Add(m_checkBoxProfilingOverlay, 1, wxALIGN_CENTER_VERTICAL | wxALIGN_CENTER_HORIZONTAL, 5);
+
+    pConfig->Read(wxT("/Options/Threads"), &m_threads, 0);
+    str.Clear();
+    str << m_threads;
+    m_textThreads = new wxTextCtrl(panel, wxID_ANY, str);
+    boxSizerPerformance->Add(new wxStaticText(panel, wxID_ANY, _("Threads (0: automatic)")), 0, wxALIGN_CENTER_VERTICAL | wxALIGN_CENTER_HORIZONTAL, 5);
+    boxSizerPerformance->Add(m_textThreads, 0, wxALIGN_CENTER_VERTICAL | wxALIGN_CENTER_HORIZONTAL, 5);
+
+    pConfig->Read(wxT("/Options/MemoryBudget"), &m_memoryBudget, 0);
+    str.Clear();
+    str << m_memoryBudget;
+    m_textMemoryBudget = new wxTextCtrl(panel, wxID_ANY, str);
+    boxSizerPerformance->Add(new wxStaticText(panel, wxID_ANY, _("Memory (MB, 0: no limit)")), 0, wxALIGN_CENTER_VERTICAL | wxALIGN_CENTER_HORIZONTAL, 5);
+    boxSizerPerformance->Add(m_textMemoryBudget, 0, wxALIGN_CENTER_VERTICAL | wxALIGN_CENTER_HORIZONTAL, 5);
+
     ///////Bilinear zoom
     wxStaticBoxSizer *boxSizerBilinearZoom = new wxStaticBoxSizer(wxHORIZONTAL, panel, _("Use NN or bilinear zoom"));
     m_checkBoxBilinearZoom = new wxCheckBox(panel, wxID_ANY, _("bilinear"));
@@ -398,6 +487,8 @@ void application_settings::write_config()
     pConfig->Write(wxT("/Paths/LUT"), dirPickerLUT->GetPath());
     pConfig->Write(wxT("/Paths/WorkingDirectory"), dirPickerWD->GetPath());
     pConfig->Write(wxT("/Paths/Plugins"), dirPickerPlugins->GetPath());
+    pConfig->Write(wxT("/Paths/Cache"), dirPickerCache->GetPath());
+    image_stats_cache::instance()->directory(std::string(dirPickerCache->GetPath().mb_str()));
 
     // Options settings
     m_textZoom->GetValue().ToDouble(&zoom_);
@@ -410,6 +501,23 @@ void application_settings::write_config()
     pConfig->Write(wxT("/Options/LoadWoleImage"), m_loadWholeImage);
     m_bilinearZoom = m_checkBoxBilinearZoom->GetValue();
     pConfig->Write(wxT("/Options/BilinearZoom"), m_bilinearZoom);
+    m_statsCache = m_checkBoxStatsCache->GetValue();
+    pConfig->Write(wxT("/Options/StatsCache"), m_statsCache);
+    image_stats_cache::instance()->enabled(m_statsCache);
+    long threads;
+    if (m_textThreads->GetValue().ToLong(&threads) && threads >= 0 && threads != m_threads)
+    {
+        m_threads = threads;
+        pConfig->Write(wxT("/Options/Threads"), m_threads);
+        thread_pool::instance()->size(m_threads);
+    }
+    long memoryBudget;
+    if (m_textMemoryBudget->GetValue().ToLong(&memoryBudget) && memoryBudget >= 0)
+    {
+        m_memoryBudget = memoryBudget;
+        pConfig->Write(wxT("/Options/MemoryBudget"), m_memoryBudget);
+        memory_manager::instance()->budget(static_cast<std::size_t>(m_memoryBudget)*1024*1024);
+    }
 
     // Vector layers
     pConfig->Write(wxT("/Options/VectorLayerPoint/Color/Red"), m_colourPickerPoints->GetColour().Red());
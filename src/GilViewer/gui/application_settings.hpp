@@ -63,9 +63,20 @@ public:
     void on_close_window(wxCloseEvent& event);
     void on_apply_button(wxCommandEvent &event);
     void on_reset_plugins(wxCommandEvent &event);
+    void on_profiling_overlay(wxCommandEvent &event);
 
     void write_config();
 
+    /// Minimum interval between two previews of a zoom or a pan, in ms (/Options/FrameInterval, read once by the constructor)
+    static long frame_interval() { return m_frameInterval; }
+    /// Whether the timings are drawn over the view (/Options/ProfilingOverlay). Read on each paint: it is only read
+    /// from the configuration by the constructor, and saved when it is changed.
+    static bool profiling_overlay() { return m_profilingOverlay; }
+    static void profiling_overlay(bool show);
+
+    /// Shows the dialog with the current options
+    virtual bool Show(bool show = true);
+
     DECLARE_EVENT_TABLE()
 
 
@@ -79,11 +90,21 @@ private:
     wxDirPickerCtrl *dirPickerLUT;
     wxDirPickerCtrl *dirPickerWD;
     wxDirPickerCtrl *dirPickerPlugins;
+    wxDirPickerCtrl *dirPickerCache;
 
     wxCheckBox *m_checkBoxLoadWholeImage;
     wxCheckBox *m_checkBoxBilinearZoom;
+    wxCheckBox *m_checkBoxStatsCache;
+    wxCheckBox *m_checkBoxProfilingOverlay;
     bool m_loadWholeImage;
     bool m_bilinearZoom;
+    bool m_statsCache;
+    static bool m_profilingOverlay;
+    wxTextCtrl* m_textThreads;
+    long m_threads;
+    wxTextCtrl* m_textMemoryBudget;
+    long m_memoryBudget;
+    static long m_frameInterval;
 
     wxTextCtrl* m_textZoom;
     wxTextCtrl* m_textDezoom;
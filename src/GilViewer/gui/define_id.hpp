@@ -100,6 +100,14 @@ enum
 	// Bouton de crop
         ID_CROP,
 
+        // Timer of the final render of a zoom or a pan (see panel_viewer::schedule_render)
+        ID_RENDER_TIMER,
+
+        // Profiling commands (see profiler.hpp and tracer.hpp)
+        ID_PROFILING_TRACE,
+        ID_PROFILING_OVERLAY,
+        ID_PROFILING_DUMP,
+
         MULTI_GEOMETRIES_TYPE,
 
         // Plugins IDs
@@ -40,6 +40,7 @@ Authors:
 #include <sstream>
 
 #include <boost/filesystem.hpp>
+#include <boost/bind.hpp>
 #ifdef WIN32
 	#pragma warning(disable : 4251)
 	#pragma warning(disable : 4275)
@@ -607,11 +608,25 @@ BEGIN_EVENT_TABLE(histogram_plotter,wxPanel)
 END_EVENT_TABLE()
 
 histogram_plotter::histogram_plotter(image_layer_settings_control* parent,  const unsigned int redChannel, const unsigned int greenChannel, const unsigned int blueChannel, wxWindowID id, const wxPoint& pos, const wxSize& size, long style) :
-        wxPanel(parent, id, pos, size, style), m_parent(parent), m_isInit(false)
+        wxPanel(parent, id, pos, size, style), m_parent(parent), m_isInit(false), m_requested(false)
 {
     channels(redChannel, greenChannel, blueChannel);
 }
 
+boost::shared_ptr<image_layer> histogram_plotter::plotted_layer() const
+{
+    return boost::dynamic_pointer_cast<image_layer>(m_parent->layercontrol()->layers()[m_parent->index()]);
+}
+
+void histogram_plotter::on_histogram_ready()
+{
+    boost::shared_ptr<image_layer> l = plotted_layer();
+    if(l)
+        m_histogram = l->cached_histogram(m_min, m_max);
+    m_isInit = true;
+    Refresh();
+}
+
 void histogram_plotter::on_mouse_move(wxMouseEvent &event)
 {
     if (m_isInit)
@@ -687,7 +702,10 @@ void histogram_plotter::on_paint(wxPaintEvent &event)
 
         //on teste si l'histogramme a bien été calculé sur le canal 0, sinon on quitte
         if(!m_histogram)
+        {
+            dc.DrawText( _("Histogram unavailable") , 15 , 15 );
             return;
+        }
 
         const histogram_type& histo = *m_histogram;
 
@@ -774,12 +792,13 @@ void histogram_plotter::on_paint(wxPaintEvent &event)
 
         dc.DrawText( _("In progress ...") , 15 , 15 );
 
-        thread_histogram *thread = new thread_histogram(m_parent);
-
-        if ( thread->Create() != wxTHREAD_NO_ERROR )
-            wxLogError(_("Can't create thread to compute image histogram!"));
-
-        thread->Run();
+        // One request per plotter: the paints and resizes until the histogram is ready do not start other passes
+        boost::shared_ptr<image_layer> l = plotted_layer();
+        if (l && !m_requested)
+        {
+            m_requested = true;
+            l->request_histogram(boost::bind(&histogram_plotter::on_histogram_ready, this), m_request);
+        }
     }
 }
 
@@ -788,28 +807,3 @@ void histogram_plotter::on_size(wxSizeEvent &event)
     if (m_isInit)
         Refresh();
 }
-
-thread_histogram::thread_histogram(image_layer_settings_control *parent) :
-        wxThread()
-{
-    m_count = 0;
-    m_parent = parent;
-}
-
-void thread_histogram::OnExit()
-{
-    m_parent->histogramplotter()->init(true);
-    m_parent->histogramplotter()->Refresh();
-}
-
-void *thread_histogram::Entry()
-{
-    double& mini = m_parent->histogramplotter()->Min();
-    double& maxi = m_parent->histogramplotter()->Max();
-
-    layer::ptrLayerType p_layer = m_parent->layercontrol()->layers()[m_parent->index()];
-    boost::shared_ptr<const histogram_plotter::histogram_type> histo = p_layer->histogram(mini, maxi);
-    m_parent->histogramplotter()->set_histogram(histo);
-
-    return NULL;
-}
@@ -43,8 +43,10 @@ Authors:
 #include <wx/panel.h>
 
 #include "../gui/layer_settings_control.hpp"
+#include "../tools/thread_pool.hpp"
 
 class histogram_plotter;
+class image_layer;
 class layer_control;
 class wxSlider;
 class wxTextCtrl;
@@ -125,46 +127,34 @@ public:
     typedef std::vector<std::vector<double> > histogram_type;
 
     histogram_plotter(image_layer_settings_control* parent, const unsigned int redChannel, const unsigned int greenChannel, const unsigned int blueChannel, wxWindowID id = wxID_ANY, const wxPoint& pos = wxDefaultPosition, const wxSize& size = wxDefaultSize, long style = wxTAB_TRAVERSAL);
+    /// The histogram is not needed anymore: the layer does not call back
+    virtual ~histogram_plotter() { m_request.cancel(); }
 
-    void set_histogram(boost::shared_ptr<const histogram_type>& histo) { m_histogram = histo; }
-
-    double &Min(){ return m_min; }
-    double &Max(){ return m_max; }
+    double Min() const { return m_min; }
+    double Max() const { return m_max; }
 
     void on_paint(wxPaintEvent &event);
     void on_size(wxSizeEvent &event);
     void on_mouse_move(wxMouseEvent &event);
+    /// Called by the GUI thread when the layer has computed the histogram
+    void on_histogram_ready();
 
     bool init() { return m_isInit; }
-    void init(const bool init) {m_isInit=init;}
     void channels(const unsigned int red, const unsigned int green, const unsigned int blue) { m_redChannel=red; m_greenChannel=green; m_blueChannel=blue; }
 
     DECLARE_EVENT_TABLE();
 
 private:
+    boost::shared_ptr<image_layer> plotted_layer() const;
+
     image_layer_settings_control* m_parent;
     boost::shared_ptr<const histogram_type> m_histogram;
     double m_min, m_max;
     bool m_isInit;
     unsigned int m_redChannel, m_greenChannel, m_blueChannel;
-
-};
-
-class thread_histogram : public wxThread
-{
-public:
-    thread_histogram(image_layer_settings_control *parent);
-
-    // thread execution starts here
-    virtual void *Entry();
-
-    // called when the thread exits - whether it terminates normally or is
-    // stopped with Delete() (but not when it is Kill()ed!)
-    virtual void OnExit();
-
-public:
-    size_t   m_count;
-    image_layer_settings_control *m_parent;
+    /// The histogram is computed by the layer (see image_layer::request_histogram), requested once per plotter
+    bool m_requested;
+    thread_pool::cancellation_token m_request;
 };
 
 #endif // __IMAGE_LAYER_SETTINGS_CONTROL_HPP__
@@ -83,6 +83,7 @@ Authors:
 #include "../tools/orientation_2d.hpp"
 #include "../tools/color_lookup_table.hpp"
 #include "GilViewer/tools/pattern_singleton.hpp"
+#include "../tools/tracer.hpp"
 
 #include "../convenient/utils.hpp"
 #include "../convenient/macros_gilviewer.hpp"
@@ -453,6 +454,7 @@ void layer_control::add_layers_from_files(const wxArrayString &names)
 layer::ptrLayerType layer_control::add_layer_from_file( const wxString &name )
 {
     string filename((const char*) (name.mb_str()) );
+    GILVIEWER_TRACE_SCOPE_DETAIL("add_layer_from_file", filename)
     string extension(filesystem::extension(filename));
     extension = extension.substr(1,extension.size()-1);
     to_lower(extension);
@@ -825,21 +827,7 @@ void layer_control::create_new_image_layer_with_parameters(const ImageLayerParam
         add_layer(ptr);
 
         // Et on sette l'ensemble des parametres qu'on a pu lire ...
-        this->m_layers.back()->visible(parameters.visible);
-        this->m_layers.back()->transformable(parameters.transformable);
-        this->m_layers.back()->alpha(parameters.alpha);
-        this->m_layers.back()->gamma(parameters.gamma);
-        this->m_layers.back()->intensity_min(parameters.intensity_min);
-        this->m_layers.back()->intensity_max(parameters.intensity_max);
-        this->m_layers.back()->transparent(parameters.transparent);
-        this->m_layers.back()->transparency_min(parameters.transparency_min);
-        this->m_layers.back()->transparency_max(parameters.transparency_max);
-        this->m_layers.back()->transform().zoom_factor(parameters.zoom_factor);
-        this->m_layers.back()->transform().translation_x(parameters.translation_x);
-        this->m_layers.back()->transform().translation_y(parameters.translation_y);
-        this->m_layers.back()->alpha_channel(parameters.useAlphaChannel,parameters.alphaChannel);
-        // TODO: binary or text?
-        this->m_layers.back()->colorlookuptable()->load_from_binary_file(parameters.lut_file);
+        xml_display_configuration_io::apply(parameters, *this->m_layers.back());
 
         // MAJ de l'interface
         this->m_layers.back()->notifyLayerControl_();
@@ -863,35 +851,7 @@ void layer_control::create_new_vector_layer_with_parameters(const VectorLayerPar
         add_layer(file->load(filename) );
 
         // Et on sette l'ensemble des parametres qu'on a pu lire ...
-        this->m_layers.back()->visible(parameters.visible);
-        this->m_layers.back()->transformable(parameters.transformable);
-        /*
-        this->m_layers.back()->SetPointsStyle(parameters.pointsColor, parameters.pointsWidth);
-        this->m_layers.back()->SetLinesStyle(parameters.linesColor, parameters.linesWidth, parameters.linesStyle);
-        this->m_layers.back()->PolygonsRingsColour(parameters.polygonsRingsColor);
-        this->m_layers.back()->PolygonsRingsWidth(parameters.polygonsRingsWidth);
-        this->m_layers.back()->PolygonsInsideColour(parameters.polygonsInsideColor);
-        this->m_layers.back()->PolygonsRingsStyle(parameters.polygonsRingsStyle);
-        this->m_layers.back()->PolygonsInsideStyle(parameters.polygonsInsideStyle);
-        */
-        //this->m_layers.back()->style(parameters.polygonsInsideColor,parameters.polygonsRingsColor,parameters.polygonsInsideStyle,parameters.polygonsRingsStyle,parameters.polygonsRingsWidth);
-
-        this->m_layers.back()->point_color(parameters.pointsColor);
-        this->m_layers.back()->point_width(parameters.pointsWidth);
-
-        this->m_layers.back()->line_color(parameters.linesColor);
-        this->m_layers.back()->line_width(parameters.linesWidth);
-        this->m_layers.back()->line_style(parameters.linesStyle);
-
-        this->m_layers.back()->polygon_border_color(parameters.polygonsRingsColor);
-        this->m_layers.back()->polygon_inner_color(parameters.polygonsInsideColor);
-        this->m_layers.back()->polygon_border_width(parameters.polygonsRingsWidth);
-        this->m_layers.back()->polygon_border_style(parameters.polygonsRingsStyle);
-        this->m_layers.back()->polygon_inner_style(parameters.polygonsInsideStyle);
-
-        this->m_layers.back()->transform().zoom_factor(parameters.zoom_factor);
-        this->m_layers.back()->transform().translation_x(parameters.translation_x);
-        this->m_layers.back()->transform().translation_y(parameters.translation_y);
+        xml_display_configuration_io::apply(parameters, *this->m_layers.back());
 
         // MAJ de l'interface
         this->m_layers.back()->notifyLayerControl_();
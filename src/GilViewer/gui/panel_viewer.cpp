@@ -41,6 +41,8 @@
 #endif
 
 #include <iostream>
+#include <sstream>
+#include <algorithm>
 
 #include <boost/filesystem.hpp>
 #include <boost/bind.hpp>
@@ -50,6 +52,8 @@
 #endif
 #include <wx/xrc/xmlres.h>
 #include <wx/dcbuffer.h>
+#include <wx/dcmemory.h>
+#include <wx/math.h>
 #include <wx/confbase.h>
 #include <wx/dataobj.h>
 #include <wx/clipbrd.h>
@@ -67,8 +71,13 @@
 #include "../gui/layer_control.hpp"
 #include "../gui/define_id.hpp"
 #include "../gui/panel_manager.hpp"
+#include "../gui/application_settings.hpp"
 
 #include "../tools/orientation_2d.hpp"
+#include "../tools/thread_pool.hpp"
+#include "../tools/memory_manager.hpp"
+#include "../tools/profiler.hpp"
+#include "../tools/tracer.hpp"
 #include "../plugins/plugin_manager.hpp"
 #include "../convenient/wxrealpoint.hpp"
 
@@ -92,6 +101,8 @@ EVT_LEFT_DCLICK(panel_viewer::on_left_double_click)
 EVT_RIGHT_DCLICK(panel_viewer::on_right_double_click)
 EVT_MOUSEWHEEL(panel_viewer::on_mouse_wheel)
 EVT_KEY_DOWN(panel_viewer::on_keydown)
+EVT_TIMER(ID_RENDER_TIMER, panel_viewer::on_render_timer)
+EVT_IDLE(panel_viewer::on_idle)
 ADD_GILVIEWER_EVENTS_TO_TABLE(panel_viewer)
 END_EVENT_TABLE()
 
@@ -118,12 +129,12 @@ void panel_viewer::mode_geometry_moving() { m_mode = MODE_GEOMETRY_MOVING; }
 void panel_viewer::mode_edition        () { m_mode = MODE_EDITION; }
 void panel_viewer::mode_selection      () { m_mode = MODE_SELECTION; }
 
-void panel_viewer::geometry_null     () { m_ghostLayer->reset<vector_layer_ghost::Nothing>  (); Refresh(); }
-void panel_viewer::geometry_point    () { m_ghostLayer->reset<vector_layer_ghost::Point>    (); Refresh(); }
-void panel_viewer::geometry_circle   () { m_ghostLayer->reset<vector_layer_ghost::Circle>   (); Refresh(); }
-void panel_viewer::geometry_rectangle() { m_ghostLayer->reset<vector_layer_ghost::Rectangle>(); Refresh(); }
-void panel_viewer::geometry_line     () { m_ghostLayer->reset<vector_layer_ghost::Polyline> (); Refresh(); }
-void panel_viewer::geometry_polygon  () { m_ghostLayer->reset<vector_layer_ghost::Polygon>  (); Refresh(); }
+void panel_viewer::geometry_null     () { m_ghostLayer->reset<vector_layer_ghost::Nothing>  (); refresh_ghost(); }
+void panel_viewer::geometry_point    () { m_ghostLayer->reset<vector_layer_ghost::Point>    (); refresh_ghost(); }
+void panel_viewer::geometry_circle   () { m_ghostLayer->reset<vector_layer_ghost::Circle>   (); refresh_ghost(); }
+void panel_viewer::geometry_rectangle() { m_ghostLayer->reset<vector_layer_ghost::Rectangle>(); refresh_ghost(); }
+void panel_viewer::geometry_line     () { m_ghostLayer->reset<vector_layer_ghost::Polyline> (); refresh_ghost(); }
+void panel_viewer::geometry_polygon  () { m_ghostLayer->reset<vector_layer_ghost::Polygon>  (); refresh_ghost(); }
 
 layer_control* panel_viewer::layercontrol() const {
     return m_layerControl;
@@ -141,7 +152,8 @@ panel_viewer::panel_viewer(wxFrame* parent, wxAuiManager *dockmanager) :
     //reference au ghostLayer du LayerControl
     m_ghostLayer(layercontrol()->m_ghostLayer),
     //Setting des modes d'interface :
-    m_mode(MODE_NAVIGATION), m_snap(SNAP_ALL)
+    m_mode(MODE_NAVIGATION), m_snap(SNAP_ALL), m_frame_valid(false),
+    m_frame_scale(1.), m_frame_offset(0, 0), m_frame_needs_update(false), m_render_timer(this, ID_RENDER_TIMER), m_last_preview(0)
 {
 
 #if wxUSE_DRAG_AND_DROP
@@ -151,6 +163,9 @@ panel_viewer::panel_viewer(wxFrame* parent, wxAuiManager *dockmanager) :
     //  SetFocus();
     SetBackgroundStyle(wxBG_STYLE_CUSTOM);
 
+    // The workers wake the GUI thread up to run the continuations of their tasks (see on_idle)
+    thread_pool::instance()->wake_up(&wxWakeUpIdle);
+
     this->init_toolbar();
 
     /// Menubar
@@ -160,9 +175,15 @@ panel_viewer::panel_viewer(wxFrame* parent, wxAuiManager *dockmanager) :
     m_menuAbout = new wxMenu;
     m_menuAbout->Append(wxID_ABOUT, wxT("?"));
 
+    wxMenu *menuProfiling = new wxMenu;
+    menuProfiling->Append(ID_PROFILING_TRACE, _("Start/stop tracing\tF10"));
+    menuProfiling->Append(ID_PROFILING_OVERLAY, _("Show/hide timings\tF11"));
+    menuProfiling->Append(ID_PROFILING_DUMP, _("Log timings\tF12"));
+
     m_menuBar = new wxMenuBar;
     m_menuBar->Insert(0, m_menuFile, _("File"));
-    m_menuBar->Insert(1, m_menuAbout, _("About ..."));
+    m_menuBar->Insert(1, menuProfiling, _("Profiling"));
+    m_menuBar->Insert(2, m_menuAbout, _("About ..."));
     m_menuBar->SetParent(parent);
 
 
@@ -217,11 +238,14 @@ panel_viewer::panel_viewer(wxFrame* parent, wxAuiManager *dockmanager) :
     //  m_menuMain->AppendRadioItem(ID_GEOMETRY_POLYGONE, _("Polygon"));
 
     ///Shortcuts
-    wxAcceleratorEntry entries[3];
+    wxAcceleratorEntry entries[6];
     entries[0].Set(wxACCEL_CTRL, (int) 'C', ID_BASIC_SNAPSHOT);
     entries[1].Set(wxACCEL_ALT, (int) 'N', ID_MODE_NAVIGATION);
     entries[2].Set(wxACCEL_ALT, (int) 'C', ID_MODE_CAPTURE);
-    wxAcceleratorTable acceleratorTable(3, entries);
+    entries[3].Set(wxACCEL_NORMAL, WXK_F11, ID_PROFILING_OVERLAY);
+    entries[4].Set(wxACCEL_NORMAL, WXK_F12, ID_PROFILING_DUMP);
+    entries[5].Set(wxACCEL_NORMAL, WXK_F10, ID_PROFILING_TRACE);
+    wxAcceleratorTable acceleratorTable(6, entries);
     this->SetAcceleratorTable(acceleratorTable);
 
     register_all_file_formats(PatternSingleton<gilviewer_io_factory>::instance());
@@ -326,39 +350,148 @@ bool panel_viewer::init_toolbar() {
     return true;
 }
 
+void panel_viewer::Refresh(bool eraseBackground, const wxRect *rect) {
+    m_frame_valid = false;
+    wxPanel::Refresh(eraseBackground, rect);
+}
+
+void panel_viewer::refresh_ghost() {
+    wxPanel::Refresh(false);
+}
+
 void panel_viewer::on_paint(wxPaintEvent& evt) {
     wxBufferedPaintDC dc(this);
     if (!dc.IsOk())
         return;
+    profiler *prof = profiler::instance();
+    double paint_start = prof->now();
 
-    dc.SetBackgroundMode    ( wxSOLID);
-    dc.SetBackground    (m_bgbrush);
-    dc.Clear();
     wxSize tailleImage(this->GetSize());
+    if (tailleImage.GetX() <= 0 || tailleImage.GetY() <= 0)
+        return;
     int dx = static_cast<int> (m_translationDrag.x);
     int dy = static_cast<int> (m_translationDrag.y);
 
-    for (layer_control::iterator it = m_layerControl->begin(); it != m_layerControl->end(); ++it) {
-        if ((*it)->visible()) {
-            if ((*it)->needs_update()) {
-                try {
-                    (*it)->update(tailleImage.GetX(), tailleImage.GetY());
-                } catch (const std::exception &e) {
-                    GILVIEWER_LOG_EXCEPTION(e.what())
-                            wxMessageBox( _("Exception: see log!"), _("Exception!"), wxICON_ERROR);
-                    return;
+    // The layers are rendered in m_frame, which is only blitted while the ghost layer alone changes
+    bool same_size = m_frame.IsOk() && m_frame.GetWidth() == tailleImage.GetX() && m_frame.GetHeight() == tailleImage.GetY();
+    if (!m_frame_valid || !same_size) {
+        m_render_timer.Stop();
+        if (m_frame_needs_update) {
+            update_if_transformable();
+            m_frame_needs_update = false;
+        }
+        if (!same_size)
+            m_frame = wxBitmap(tailleImage.GetX(), tailleImage.GetY());
+        wxMemoryDC mdc(m_frame);
+        mdc.SetBackgroundMode    ( wxSOLID);
+        mdc.SetBackground    (m_bgbrush);
+        mdc.Clear();
+
+        for (layer_control::iterator it = m_layerControl->begin(); it != m_layerControl->end(); ++it) {
+            if ((*it)->visible()) {
+                if ((*it)->needs_update()) {
+                    try {
+                        profiler::scoped_timer timer(profiler::UPDATE, (*it)->name());
+                        (*it)->update(tailleImage.GetX(), tailleImage.GetY());
+                    } catch (const std::exception &e) {
+                        GILVIEWER_LOG_EXCEPTION(e.what())
+                                wxMessageBox( _("Exception: see log!"), _("Exception!"), wxICON_ERROR);
+                        return;
+                    }
+                    (*it)->needs_update(false);
                 }
-                (*it)->needs_update(false);
-            }
 
-            if ((*it)->transformable()) {
-                (*it)->draw(dc,dx,dy, true);
-            } else {
-                (*it)->draw(dc, 0, 0, true);
+                profiler::scoped_timer timer(profiler::DRAW, (*it)->name());
+                if ((*it)->transformable()) {
+                    (*it)->draw(mdc,dx,dy, true);
+                } else {
+                    (*it)->draw(mdc, 0, 0, true);
+                }
             }
         }
+        m_frame_valid = true;
+        // The layers drawn above are kept, the other ones may be released
+        memory_manager::instance()->enforce();
+        m_frame_scale = 1.;
+        m_frame_offset = wxRealPoint(0, 0);
+    }
+    if (m_frame_scale == 1. && m_frame_offset.x == 0. && m_frame_offset.y == 0.) {
+        dc.DrawBitmap(m_frame, 0, 0, false);
+    } else {
+        // Zoom or pan in progress (see schedule_render)
+        dc.SetBackground(m_bgbrush);
+        dc.Clear();
+        dc.SetUserScale(m_frame_scale, m_frame_scale);
+        dc.DrawBitmap(m_frame, wxRound(m_frame_offset.x / m_frame_scale), wxRound(m_frame_offset.y / m_frame_scale), false);
+        dc.SetUserScale(1., 1.);
     }
     m_ghostLayer->draw(dc,dx,dy,false);
+
+    prof->record(profiler::PAINT, "frame", paint_start, prof->now()-paint_start);
+    prof->end_frame();
+    if (application_settings::profiling_overlay())
+        draw_profiling_overlay(dc);
+}
+
+void panel_viewer::toggle_tracing() {
+    tracer *t = tracer::instance();
+    if (!tracer::enabled()) {
+        t->clear();
+        t->enable(true);
+        GILVIEWER_LOG_MESSAGE("Tracing started");
+        return;
+    }
+    t->enable(false);
+    wxString directory;
+    wxConfigBase::Get()->Read(wxT("/Paths/WorkingDirectory"), &directory, ::wxGetCwd());
+    wxFileDialog fd(this, _("Save trace"), directory, wxT("gilviewer_trace.json"), wxT("*.json"), wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+    if (fd.ShowModal() != wxID_OK) {
+        GILVIEWER_LOG_MESSAGE("Tracing stopped, trace discarded");
+        return;
+    }
+    const std::string filename((const char*) (fd.GetPath().mb_str()));
+    if (t->write(filename))
+        GILVIEWER_LOG_MESSAGE("Trace written to " << filename);
+}
+
+void panel_viewer::toggle_profiling_overlay() {
+    application_settings::profiling_overlay(!application_settings::profiling_overlay());
+    refresh_ghost();
+}
+
+void panel_viewer::dump_profiling() {
+    std::ostringstream oss;
+    profiler::instance()->dump(oss);
+    GILVIEWER_LOG_MESSAGE("Profiling:\n" << oss.str());
+}
+
+void panel_viewer::draw_profiling_overlay(wxDC &dc) const {
+    profiler *prof = profiler::instance();
+    std::vector<wxString> lines;
+    wxString line;
+    line.Printf(wxT("%.0f fps, paint %.1f ms"), prof->fps(), prof->latest(profiler::PAINT, "frame"));
+    lines.push_back(line);
+    for (layer_control::const_iterator it = m_layerControl->begin(); it != m_layerControl->end(); ++it) {
+        if (!(*it)->visible())
+            continue;
+        line.Printf(wxT(": update %.1f ms, draw %.1f ms"), std::max(0., prof->latest(profiler::UPDATE, (*it)->name())), std::max(0., prof->latest(profiler::DRAW, (*it)->name())));
+        lines.push_back(wxString((*it)->name().c_str(), *wxConvCurrent) + line);
+    }
+
+    wxCoord w = 0, h = 0, line_height = 0;
+    for (unsigned int i = 0; i < lines.size(); ++i) {
+        wxCoord lw, lh;
+        dc.GetTextExtent(lines[i], &lw, &lh);
+        w = std::max(w, lw);
+        line_height = std::max(line_height, lh);
+    }
+    h = line_height * lines.size();
+    dc.SetPen(*wxTRANSPARENT_PEN);
+    dc.SetBrush(*wxBLACK_BRUSH);
+    dc.DrawRectangle(0, 0, w + 8, h + 8);
+    dc.SetTextForeground(*wxWHITE);
+    for (unsigned int i = 0; i < lines.size(); ++i)
+        dc.DrawText(lines[i], 4, 4 + i * line_height);
 }
 
 void panel_viewer::on_left_down(wxMouseEvent &event) {
@@ -582,8 +715,41 @@ void panel_viewer::scene_move(const wxRealPoint& translation) {
     for (layer_control::iterator it = m_layerControl->begin(); it != m_layerControl->end(); ++it)
         if ((*it)->transformable()) (*it)->transform().translate(translation);
     m_ghostLayer->transform().translate(translation);
+    m_frame_offset += translation;
+    schedule_render();
+}
+
+void panel_viewer::schedule_render() {
+    if (!m_frame_valid) {
+        Refresh();
+        return;
+    }
+    long interval = application_settings::frame_interval();
+    wxLongLong now = wxGetLocalTimeMillis();
+    if (now - m_last_preview >= interval) {
+        m_last_preview = now;
+        refresh_ghost();
+    }
+    // Restarted by each call: the full render follows the last one
+    m_render_timer.Start(interval, wxTIMER_ONE_SHOT);
+}
+
+void panel_viewer::on_render_timer(wxTimerEvent& event) {
     Refresh();
 }
+
+void panel_viewer::on_idle(wxIdleEvent& event) {
+    // Layers modified by a continuation (e.g. the tiles read by ogr_streaming_vector_layer) are drawn again
+    unsigned int revisions = 0;
+    for (layer_control::const_iterator it = m_layerControl->begin(); it != m_layerControl->end(); ++it)
+        revisions += (*it)->revision();
+    thread_pool::instance()->run_continuations();
+    for (layer_control::const_iterator it = m_layerControl->begin(); it != m_layerControl->end(); ++it)
+        revisions -= (*it)->revision();
+    if (revisions != 0)
+        Refresh();
+    event.Skip();
+}
 /*
 bool panel_viewer::coord_image(const int mouseX, const int mouseY, int &i, int &j) const {
     bool coordOK = false;
@@ -665,11 +831,15 @@ void panel_viewer::zoom(double zoom_factor, wxMouseEvent &event) {
     for (layer_control::iterator it = m_layerControl->begin(); it != m_layerControl->end(); ++it) {
         if ((*it)->transformable()) {
             (*it)->transform().zoom(zoom_factor,event.GetPosition().x,event.GetPosition().y);
-            (*it)->needs_update(true);
         }
     }
     m_ghostLayer->transform().zoom(zoom_factor,event.GetPosition().x,event.GetPosition().y);
-    Refresh();
+    // The point under the mouse stays fixed: p -> x + (p-x)/zoom_factor. The layers are updated by the full render.
+    double x = event.GetPosition().x, y = event.GetPosition().y;
+    m_frame_scale /= zoom_factor;
+    m_frame_offset = wxRealPoint(x + (m_frame_offset.x - x) / zoom_factor, y + (m_frame_offset.y - y) / zoom_factor);
+    m_frame_needs_update = true;
+    schedule_render();
 }
 
 /*
@@ -732,7 +902,12 @@ void panel_viewer::snap_shot(wxCommandEvent& event) {
 }
 
 void panel_viewer::execute_mode() {
-    Refresh();
+    // While it is drawn (rubber band) or moved, only the ghost changes. Once complete, it may be consumed by
+    // the execute_mode_* methods, which modify the layers.
+    if (m_ghostLayer->complete())
+        Refresh();
+    else
+        refresh_ghost();
 
     switch (m_mode) {
     case MODE_NAVIGATION:
@@ -765,12 +940,8 @@ wxRealPoint panel_viewer::snap(const wxRealPoint& p) const
     if(m_snap)
     {
         double d2[SNAP_MAX_ID];
-        if(m_snap&SNAP_GRID ) d2[SNAP_GRID ]=10*10; // squared snap tolerance in [grid steps squared]
-        if(m_snap&SNAP_POINT) d2[SNAP_POINT]=10*10; // squared snap tolerance in [screen pixels squared]
-        if(m_snap&SNAP_LINE ) d2[SNAP_LINE ]=10*10; // squared snap tolerance in [screen pixels squared]
-        for (layer_control::iterator it = m_layerControl->begin(); it != m_layerControl->end(); ++it) {
-            (*it)->snap(m_snap,d2,p,q);
-        }
+        m_snapping.snap(*m_layerControl,m_snap,d2,p,q);
+        // The ghost layer changes while capturing: it is never cached
         m_ghostLayer->snap(m_snap,d2,p,q);
     }
     return q;
@@ -782,7 +953,8 @@ void panel_viewer::geometry_add_point(const wxRealPoint& p, bool final)
         vectorlayerghost()->reset();
     if(m_ghostLayer->add_point(p,final))
         geometry_end();
-    Refresh();
+    else
+        refresh_ghost();
 }
 void panel_viewer::geometry_move_relative  (const wxRealPoint& p)
 {
@@ -808,6 +980,8 @@ void panel_viewer::geometry_update_relative(const wxRealPoint& p)
 void panel_viewer::geometry_end()
 {
     execute_mode();
+    // The processing of the geometry may have modified the layers
+    m_snapping.invalidate();
 }
 
 panel_viewer* create_panel_viewer(wxFrame* parent, wxAuiManager *dockmanager) {
@@ -45,9 +45,12 @@ Authors:
 #include <wx/dnd.h>
 #include <wx/panel.h>
 #include <wx/brush.h>
+#include <wx/bitmap.h>
+#include <wx/timer.h>
 #include <wx/aui/framemanager.h>
 
 #include "../layers/layer.hpp"
+#include "snapping_service.hpp"
 
 #include "../convenient/macros_gilviewer.hpp"
 
@@ -107,6 +110,13 @@ public:
 
     void crop();
 
+    /// Starts tracing (F10, see tracer.hpp), or stops it and asks where the trace is written
+    void toggle_tracing();
+    /// Shows or hides the timings over the view (F11, see application_settings::profiling_overlay)
+    void toggle_profiling_overlay();
+    /// Writes the recorded timings to the log (F12)
+    void dump_profiling();
+
     // TODO : tout passer en minuscule (ou en majuscule)
     enum eMode //mode de gestion des événements
     {
@@ -121,6 +131,12 @@ public:
     inline eSNAP snap() { return m_snap; }
     inline boost::shared_ptr<vector_layer_ghost> vectorlayerghost() { return m_ghostLayer; }
 
+    /// Repaints the layers and the ghost layer
+    virtual void Refresh(bool eraseBackground = true, const wxRect *rect = NULL);
+    /// Repaints only the ghost layer, over the frame of the layers rendered by the last paint.
+    /// Only valid when the layers have not changed since (rubber band, reset of the ghost).
+    void refresh_ghost();
+
     DECLARE_EVENT_TABLE()
 
 protected:
@@ -178,6 +194,8 @@ protected:
     void scene_move(const wxRealPoint& translation);
 
     void on_paint(wxPaintEvent& evt);
+    /// Frame rate and timings of the visible layers (see profiler)
+    void draw_profiling_overlay(wxDC &dc) const;
     void update_statusbar(const wxRealPoint& p);
     void on_size( wxSizeEvent &e );
     // Mouse events
@@ -203,11 +221,31 @@ protected:
 
     wxRealPoint snap(const wxRealPoint& p) const;
 
+    /// Repaints after a change of the transforms (zoom, pan) without rendering the layers: the last frame is scaled
+    /// and shifted instead, at most once per frame interval (see application_settings::frame_interval). The layers are rendered
+    /// in full quality one frame interval after the last call, or by the next Refresh.
+    void schedule_render();
+    void on_render_timer(wxTimerEvent& event);
+    /// Runs the continuations of the tasks of thread_pool, and repaints if they modified a layer
+    void on_idle(wxIdleEvent& event);
+
     template<typename Event>
     inline wxRealPoint snap(const Event& e) const { return snap(wxRealPoint(e.m_x,e.m_y)); }
 
 private:
     plugin_manager* m_plugin_manager;
+    /// Caches the snapping to the layers while the cursor stays in the same cell
+    mutable snapping_service m_snapping;
+    /// Layers rendered by the last paint (without the ghost layer) and whether they are still up to date
+    wxBitmap m_frame;
+    bool m_frame_valid;
+    /// Transform from the pixels of m_frame to the pixels of the view: p -> m_frame_scale * p + m_frame_offset
+    double m_frame_scale;
+    wxRealPoint m_frame_offset;
+    /// The transformable layers must be updated before the next full render
+    bool m_frame_needs_update;
+    wxTimer m_render_timer;
+    wxLongLong m_last_preview;
 };
 
 #if wxUSE_DRAG_AND_DROP
@@ -0,0 +1,200 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+#include "snapping_service.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "layer_control.hpp"
+#include "../layers/layer.hpp"
+
+namespace
+{
+    const int tile_size = 64; // in screen pixels
+    const std::size_t max_tiles = 4096;
+
+    struct segment_min_x
+    {
+        bool operator()(const layer::segment_type& a, const layer::segment_type& b) const
+        {
+            return std::min(a.first.x,a.second.x) < std::min(b.first.x,b.second.x);
+        }
+    };
+
+    // Intersection of [a0,a1] and [b0,b1], ignoring the shared endpoints of connected segments
+    bool intersect(const layer::segment_type& a, const layer::segment_type& b, wxRealPoint& i)
+    {
+        wxRealPoint u(a.second-a.first), v(b.second-b.first), w(b.first-a.first);
+        double det = u.x*v.y-u.y*v.x;
+        if(det==0) return false; // parallel or degenerated segments
+        double s = (w.x*v.y-w.y*v.x)/det;
+        double t = (w.x*u.y-w.y*u.x)/det;
+        if(s<0 || s>1 || t<0 || t>1) return false;
+        if((s==0 || s==1) && (t==0 || t==1)) return false;
+        i = a.first+s*u;
+        return true;
+    }
+}
+
+bool snapping_service::layer_state::operator==(const layer_state& s) const
+{
+    return l==s.l && id==s.id && revision==s.revision && zoom==s.zoom && translation_x==s.translation_x && translation_y==s.translation_y && visible==s.visible;
+}
+
+snapping_service::snapping_service(double tolerance, int cell_size) :
+        m_tolerance(tolerance), m_cell_size(std::max(1,cell_size)),
+        m_valid(false), m_cell_x(0), m_cell_y(0), m_mode(SNAP_NONE), m_snapped(false)
+{
+    std::fill(m_d2, m_d2+SNAP_MAX_ID, 0.);
+}
+
+void snapping_service::states(const layer_control& layers, std::vector<layer_state>& s) const
+{
+    s.clear();
+    for (layer_control::const_iterator it = layers.begin(); it != layers.end(); ++it)
+    {
+        layer_state state;
+        state.l = it->get();
+        state.id = (*it)->getId();
+        state.revision = (*it)->revision();
+        state.zoom = (*it)->transform().zoom_factor();
+        state.translation_x = (*it)->transform().translation_x();
+        state.translation_y = (*it)->transform().translation_y();
+        state.visible = (*it)->visible();
+        s.push_back(state);
+    }
+}
+
+bool snapping_service::snap(const layer_control& layers, eSNAP mode, double d2[], const wxRealPoint& p, wxRealPoint& psnap)
+{
+    int cell_x = static_cast<int>(std::floor(p.x/m_cell_size));
+    int cell_y = static_cast<int>(std::floor(p.y/m_cell_size));
+    std::vector<layer_state> current;
+    states(layers, current);
+    if(!(current==m_layers))
+        m_intersections.clear();
+
+    if(!m_valid || cell_x!=m_cell_x || cell_y!=m_cell_y || mode!=m_mode || !(current==m_layers))
+    {
+        std::fill(m_d2, m_d2+SNAP_MAX_ID, 0.);
+        double tolerance2 = m_tolerance*m_tolerance;
+        if(mode&SNAP_GRID ) m_d2[SNAP_GRID ]=tolerance2; // squared snap tolerance in [grid steps squared]
+        if(mode&SNAP_POINT) m_d2[SNAP_POINT]=tolerance2; // squared snap tolerance in [screen pixels squared]
+        if(mode&SNAP_LINE ) m_d2[SNAP_LINE ]=tolerance2; // squared snap tolerance in [screen pixels squared]
+        if(mode&SNAP_INTERSECTION) m_d2[SNAP_INTERSECTION]=tolerance2; // squared snap tolerance in [screen pixels squared]
+        m_snapped = false;
+        m_psnap = p;
+        if(mode)
+        {
+            for (layer_control::const_iterator it = layers.begin(); it != layers.end(); ++it)
+                if((*it)->snap(mode,m_d2,p,m_psnap)) m_snapped = true;
+            if((mode&SNAP_INTERSECTION) && snap_intersection(layers,p)) m_snapped = true;
+        }
+        m_valid = true;
+        m_cell_x = cell_x;
+        m_cell_y = cell_y;
+        m_mode = mode;
+        m_layers.swap(current);
+    }
+
+    std::copy(m_d2, m_d2+SNAP_MAX_ID, d2);
+    if(m_snapped)
+        psnap = m_psnap;
+    return m_snapped;
+}
+
+bool snapping_service::snap_intersection(const layer_control& layers, const wxRealPoint& p)
+{
+    int x0 = static_cast<int>(std::floor((p.x-m_tolerance)/tile_size));
+    int y0 = static_cast<int>(std::floor((p.y-m_tolerance)/tile_size));
+    int x1 = static_cast<int>(std::floor((p.x+m_tolerance)/tile_size));
+    int y1 = static_cast<int>(std::floor((p.y+m_tolerance)/tile_size));
+    bool snapped = false;
+    for(int ty=y0;ty<=y1;++ty)
+    {
+        for(int tx=x0;tx<=x1;++tx)
+        {
+            const std::vector<wxRealPoint>& points = intersections(layers, tile_key(tx,ty));
+            for(std::size_t i=0;i<points.size();++i)
+            {
+                double d = squared_distance(p,points[i]);
+                if(d >= m_d2[SNAP_INTERSECTION]) continue;
+                for(unsigned int k=0; k<SNAP_INTERSECTION; ++k) m_d2[k]=0;
+                m_d2[SNAP_INTERSECTION] = d;
+                m_psnap = points[i];
+                snapped = true;
+            }
+        }
+    }
+    return snapped;
+}
+
+const std::vector<wxRealPoint>& snapping_service::intersections(const layer_control& layers, const tile_key& key)
+{
+    std::map<tile_key, std::vector<wxRealPoint> >::iterator found = m_intersections.find(key);
+    if(found!=m_intersections.end())
+        return found->second;
+    if(m_intersections.size()>=max_tiles)
+        m_intersections.clear();
+
+    bbox_rtree::box tile(key.first*tile_size, key.second*tile_size, (key.first+1)*tile_size, (key.second+1)*tile_size);
+    std::vector<layer::segment_type> segments;
+    for (layer_control::const_iterator it = layers.begin(); it != layers.end(); ++it)
+        if((*it)->visible())
+            (*it)->screen_segments(tile, segments);
+
+    // sweep along x: only the segments whose x-ranges overlap are tested
+    std::vector<wxRealPoint>& points = m_intersections[key];
+    std::sort(segments.begin(), segments.end(), segment_min_x());
+    for(std::size_t i=0;i<segments.size();++i)
+    {
+        const layer::segment_type& a = segments[i];
+        double max_x = std::max(a.first.x,a.second.x);
+        double min_y = std::min(a.first.y,a.second.y), max_y = std::max(a.first.y,a.second.y);
+        for(std::size_t j=i+1;j<segments.size();++j)
+        {
+            const layer::segment_type& b = segments[j];
+            if(std::min(b.first.x,b.second.x) > max_x) break;
+            if(std::max(b.first.y,b.second.y) < min_y || std::min(b.first.y,b.second.y) > max_y) continue;
+            wxRealPoint q;
+            if(intersect(a,b,q) && q.x>=tile.min_x && q.x<tile.max_x && q.y>=tile.min_y && q.y<tile.max_y)
+                points.push_back(q);
+        }
+    }
+    return points;
+}
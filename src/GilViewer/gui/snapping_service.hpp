@@ -0,0 +1,106 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+#ifndef SNAPPING_SERVICE_HPP
+#define SNAPPING_SERVICE_HPP
+
+#include <map>
+#include <vector>
+
+#include "../layers/layer_transform.hpp"
+
+class layer;
+class layer_control;
+
+/**
+ * @brief Snapping of the cursor to the geometries of the layers.
+ *
+ * Each layer restricts its search to the tolerance window using its own spatial index (see layer::snap).
+ * The result is cached: while the cursor stays in the same cell and neither the layers, their geometries (see
+ * layer::revision) nor their transforms change, the layers are not queried again.
+ *
+ * SNAP_INTERSECTION is handled here rather than in the layers, so that intersections between geometries of
+ * different layers are found. The intersections are computed per screen tile by a sweep over the segments
+ * returned by layer::screen_segments, and kept until the layers, their geometries or their transforms change.
+ **/
+class snapping_service
+{
+public:
+    /// @param tolerance Snapping tolerance, in screen pixels (in grid steps for SNAP_GRID)
+    /// @param cell_size Size of the cursor cells in which the result is reused, in screen pixels
+    snapping_service(double tolerance=10., int cell_size=2);
+
+    /// Snaps p to the layers. d2 receives the squared distances of the retained geometry for each mode (see layer::snap).
+    /// Returns true if p has been snapped to psnap, otherwise psnap is left unchanged.
+    bool snap(const layer_control& layers, eSNAP mode, double d2[], const wxRealPoint& p, wxRealPoint& psnap);
+    /// Forces the next call to query the layers (e.g. after geometries have been added)
+    void invalidate() { m_valid = false; m_intersections.clear(); }
+
+    double tolerance() const { return m_tolerance; }
+    void tolerance(double t) { m_tolerance = t; invalidate(); }
+
+private:
+    struct layer_state
+    {
+        const layer* l;
+        unsigned int id, revision;
+        double zoom, translation_x, translation_y;
+        bool visible;
+        bool operator==(const layer_state& s) const;
+    };
+    void states(const layer_control& layers, std::vector<layer_state>& s) const;
+
+    typedef std::pair<int,int> tile_key;
+    /// Intersections, in screen coordinates, of the segments of all the layers within the tile
+    const std::vector<wxRealPoint>& intersections(const layer_control& layers, const tile_key& key);
+    bool snap_intersection(const layer_control& layers, const wxRealPoint& p);
+
+    double m_tolerance;
+    int m_cell_size;
+
+    bool m_valid;
+    int m_cell_x, m_cell_y;
+    eSNAP m_mode;
+    std::vector<layer_state> m_layers;
+    double m_d2[SNAP_MAX_ID];
+    bool m_snapped;
+    wxRealPoint m_psnap;
+
+    std::map<tile_key, std::vector<wxRealPoint> > m_intersections;
+};
+
+#endif // SNAPPING_SERVICE_HPP
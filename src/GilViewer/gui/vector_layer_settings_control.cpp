@@ -63,6 +63,10 @@ Authors:
 wxString vector_layer_settings_control::choices_points[] =
 { _("Point"), _("Transparent"), _("Cross"), _("Plus"), _("Triangle"), _("Circle") };
 
+// Same order as layer::point_rendering_type
+wxString vector_layer_settings_control::choices_point_rendering[] =
+{ _("All points"), _("One point per cell"), _("Density") };
+
 wxString vector_layer_settings_control::choices_inside_polygons[] =
 { _("Solid"), _("Transparent"), _("Backward diagonal hatch"), _("Forward diagonal hatch"), _("Cross diagonal hatch"), _("Horizontal hatch"), _("Vertical hatch"), _("Cross hatch") };
 
@@ -94,6 +98,7 @@ layer_settings_control(parent, id, title, pos, size, style), m_parent(parent)
     m_sliderWidthLines = NULL;
     m_sliderWidthRings = NULL;
     m_choicePoints = NULL;
+    m_choicePointRendering = NULL;
     m_choicePolygons = NULL;
     m_choiceLines = NULL;
     m_choiceLabels = NULL;
@@ -131,6 +136,9 @@ layer_settings_control(parent, id, title, pos, size, style), m_parent(parent)
         m_choicePoints->SetSelection(0);
         m_choicePoints->Enable(false);
         boxSizerPoints->Add(m_choicePoints, 1, wxALIGN_CENTER_VERTICAL | wxALIGN_CENTER_HORIZONTAL | wxALL, 5);
+        m_choicePointRendering = new wxChoice(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, WXSIZEOF(vector_layer_settings_control::choices_point_rendering), vector_layer_settings_control::choices_point_rendering);
+        m_choicePointRendering->SetSelection(0);
+        boxSizerPoints->Add(m_choicePointRendering, 1, wxALIGN_CENTER_VERTICAL | wxALIGN_CENTER_HORIZONTAL | wxALL, 5);
         m_main_sizer->Add(boxSizerPoints, 1, wxEXPAND | wxALIGN_CENTER_VERTICAL | wxALIGN_CENTER_HORIZONTAL | wxALL, 5);
     }
 
@@ -259,6 +267,7 @@ void vector_layer_settings_control::update()
 {
     m_colourPickerPoints->SetColour(m_parent->layers()[m_index]->point_color());
     m_sliderWidthPoints->SetValue(m_parent->layers()[m_index]->point_width());
+    m_choicePointRendering->SetSelection(m_parent->layers()[m_index]->point_rendering());
 
     m_colourPickerLines->SetColour(m_parent->layers()[m_index]->line_color());
     m_sliderWidthLines->SetValue(m_parent->layers()[m_index]->line_width());
@@ -294,6 +303,7 @@ void vector_layer_settings_control::on_apply_button(wxCommandEvent &event)
 
     m_parent->layers()[m_index]->point_color(m_colourPickerPoints->GetColour(), false);
     m_parent->layers()[m_index]->point_width(m_sliderWidthPoints->GetValue(),   false);
+    m_parent->layers()[m_index]->point_rendering(m_choicePointRendering->GetSelection(), false);
 
     m_parent->layers()[m_index]->line_color(m_colourPickerLines->GetColour(),          false);
     m_parent->layers()[m_index]->line_width(m_sliderWidthLines->GetValue(),            false);
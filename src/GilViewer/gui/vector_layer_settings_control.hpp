@@ -69,6 +69,7 @@ public:
 
     static wxString choices_points[6];
     static int style_points[6];
+    static wxString choices_point_rendering[3];
     static wxString choices_inside_polygons[8];
     static int style_inside_polygons[8];
     static wxString choices_lines[6];
@@ -90,6 +91,7 @@ public:
     wxSlider* m_sliderWidthLines;
     wxSlider* m_sliderWidthRings;
     wxChoice* m_choicePoints;
+    wxChoice* m_choicePointRendering;
     wxChoice* m_choicePolygons;
     wxChoice* m_choiceLines;
     wxChoice* m_choiceLabels;
@@ -36,34 +36,14 @@ Authors:
 
 ***********************************************************************/
 
-#ifndef GET_GEOMETRY_VISITOR_HPP
-#define GET_GEOMETRY_VISITOR_HPP
+#include "gilviewer_file_io.hpp"
 
-#include <boost/variant/static_visitor.hpp>
+#include "../layers/image_layer.hpp"
 
-#include <iostream>
-
-#include <gdal/ogrsf_frmts.h>
-
-#include "ogr_vector_layer.hpp"
-
-template<typename Geometry>
-class get_geometry_visitor : public boost::static_visitor<>
+boost::shared_ptr<gilviewer_image_type> gilviewer_file_io::load_pixels(const std::string &filename)
 {
-public:
-    get_geometry_visitor() {}
-
-    template <typename T>
-    void operator()(T* operand)
-    {
-    }
-
-    void operator()(Geometry* operand)
-    {
-        m_geometries.push_back(operand);
-    }
-
-    std::vector<Geometry*> m_geometries;
-};
-
-#endif // GET_GEOMETRY_VISITOR_HPP
+    boost::shared_ptr<image_layer> l = boost::dynamic_pointer_cast<image_layer>(load(filename));
+    if(!l)
+        return boost::shared_ptr<gilviewer_image_type>();
+    return l->image();
+}
@@ -47,6 +47,7 @@ Authors:
 
 class layer;
 class gilviewer_io_factory;
+struct gilviewer_image_type;
 
 class gilviewer_file_io : public plugin_base
 {
@@ -55,6 +56,10 @@ public:
 
     virtual boost::shared_ptr<layer> load(const std::string &filename, const std::ptrdiff_t top_left_x=0, const std::ptrdiff_t top_left_y=0, const std::ptrdiff_t dim_x=0, const std::ptrdiff_t dim_y=0) { return boost::shared_ptr<layer>(); }
 
+    /// Reads the whole image again, without building a layer (see image_layer::release_memory). Returns a null pointer
+    /// if the file cannot be read. The default implementation loads a layer and keeps its pixels.
+    virtual boost::shared_ptr<gilviewer_image_type> load_pixels(const std::string &filename);
+
     virtual void save(boost::shared_ptr<layer> layer, const std::string &filename)=0;
 
     virtual std::string get_infos(const std::string &filename) { return ""; }
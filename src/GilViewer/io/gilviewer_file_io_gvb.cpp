@@ -0,0 +1,342 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+#include "gilviewer_file_io_gvb.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+#include <boost/filesystem.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "gilviewer_io_factory.hpp"
+
+#include "../layers/simple_vector_layer.hpp"
+#include "../convenient/utils.hpp"
+#include "../tools/profiler.hpp"
+
+using namespace boost;
+using namespace std;
+
+namespace
+{
+    const char gvb_magic[8] = {'G','I','L','V','G','V','B','\0'};
+
+    typedef simple_vector_layer::point_type point_type;
+    typedef simple_vector_layer::circle_type circle_type;
+    typedef simple_vector_layer::ellipse_type ellipse_type;
+
+    // The layer structures are written (and mapped) as is
+    BOOST_STATIC_ASSERT(sizeof(point_type)  ==2*sizeof(double));
+    BOOST_STATIC_ASSERT(sizeof(circle_type) ==3*sizeof(double));
+    BOOST_STATIC_ASSERT(sizeof(ellipse_type)==4*sizeof(double));
+
+    inline uint64_t align8(uint64_t offset) { return (offset+7) & ~uint64_t(7); }
+
+    /// Live mappings, indexed by absolute path
+    boost::mutex mapped_files_mutex;
+    map<string, unsigned int> mapped_files;
+
+    string absolute_path(const string &filename)
+    {
+        return filesystem::system_complete(filename).string();
+    }
+
+    class gvb_writer
+    {
+    public:
+        gvb_writer(const string &filename) : m_ofs(filename.c_str(), ios::binary), m_offset(sizeof(gvb::header))
+        {
+            if(!m_ofs)
+                throw ios_base::failure("Unable to open file " + filename);
+            std::memset(&m_header, 0, sizeof(gvb::header));
+            std::memcpy(m_header.magic, gvb_magic, sizeof(gvb_magic));
+            m_header.version     = gvb::version;
+            m_header.byte_order  = gvb::byte_order_mark;
+            m_header.header_size = sizeof(gvb::header);
+            m_header.nb_sections = gvb::NB_SECTIONS;
+            // header is rewritten at the end, once all sections are known
+            m_ofs.write(reinterpret_cast<const char*>(&m_header), sizeof(gvb::header));
+        }
+
+        void begin(gvb::section_id id)
+        {
+            pad();
+            m_header.sections[id].offset = m_offset;
+            m_header.sections[id].count  = 0;
+            m_current = id;
+        }
+        template<typename T> void write(const T* data, uint64_t count)
+        {
+            if(count==0) return;
+            m_ofs.write(reinterpret_cast<const char*>(data), count*sizeof(T));
+            m_offset += count*sizeof(T);
+            m_header.sections[m_current].count += count;
+        }
+        template<typename T> void write(const T& t) { write(&t, 1); }
+
+        void close()
+        {
+            m_ofs.seekp(0);
+            m_ofs.write(reinterpret_cast<const char*>(&m_header), sizeof(gvb::header));
+            m_ofs.close();
+            if(m_ofs.fail())
+                throw ios_base::failure("Error while writing gvb file");
+        }
+
+    private:
+        void pad()
+        {
+            static const char zeros[8] = {0,0,0,0,0,0,0,0};
+            uint64_t aligned = align8(m_offset);
+            m_ofs.write(zeros, aligned-m_offset);
+            m_offset = aligned;
+        }
+
+        ofstream m_ofs;
+        gvb::header m_header;
+        uint64_t m_offset;
+        gvb::section_id m_current;
+    };
+}
+
+gvb_mapped_file::gvb_mapped_file(const string &filename)
+{
+    try
+    {
+        boost::interprocess::file_mapping file(filename.c_str(), boost::interprocess::read_only);
+        boost::interprocess::mapped_region region(file, boost::interprocess::read_only);
+        m_file.swap(file);
+        m_region.swap(region);
+    }
+    catch(const boost::interprocess::interprocess_exception &e)
+    {
+        throw invalid_argument("Unable to map file " + filename + ": " + e.what());
+    }
+
+    const uint64_t size = m_region.get_size();
+    if(size < 4*sizeof(uint32_t)+sizeof(gvb_magic))
+        throw invalid_argument("Not a gvb file: " + filename);
+    const gvb::header *h = static_cast<const gvb::header*>(m_region.get_address());
+    if(std::memcmp(h->magic, gvb_magic, sizeof(gvb_magic))!=0)
+        throw invalid_argument("Not a gvb file: " + filename);
+    if(h->byte_order != gvb::byte_order_mark)
+        throw invalid_argument("gvb file written with a different byte order: " + filename);
+    if(h->version > gvb::version)
+        throw invalid_argument("gvb file written by a newer version of GilViewer: " + filename);
+
+    // Sections unknown to the writer of the file (older version) are empty
+    std::memset(m_sections, 0, sizeof(m_sections));
+    const unsigned int nb_sections = std::min<uint32_t>(h->nb_sections, gvb::NB_SECTIONS);
+    if(h->header_size > size || sizeof(gvb::header)-sizeof(h->sections)+nb_sections*sizeof(gvb::section) > h->header_size)
+        throw invalid_argument("Corrupted gvb file: " + filename);
+    for(unsigned int i=0; i<nb_sections; ++i)
+        m_sections[i] = h->sections[i];
+
+    static const uint64_t element_size[gvb::NB_SECTIONS] = {
+        sizeof(circle_type), sizeof(ellipse_type), sizeof(gvb::rotated_ellipse), sizeof(point_type),
+        sizeof(uint64_t), sizeof(point_type), sizeof(uint64_t), sizeof(point_type),
+        sizeof(uint64_t), sizeof(point_type), sizeof(point_type), sizeof(uint64_t), sizeof(char) };
+    for(unsigned int i=0; i<gvb::NB_SECTIONS; ++i)
+    {
+        if(m_sections[i].count==0) continue;
+        // Compared by division: count*element_size may overflow
+        if(m_sections[i].offset%8!=0 || m_sections[i].offset > size || m_sections[i].count > (size-m_sections[i].offset)/element_size[i])
+            throw invalid_argument("Corrupted gvb file: " + filename);
+    }
+    // Each offset table must start at 0, never decrease, and end with the size of its coordinates section
+    const gvb::section_id runs[4][2] = { {gvb::ARC_OFFSETS, gvb::ARC_COORDS}, {gvb::SPLINE_OFFSETS, gvb::SPLINE_COORDS},
+                                         {gvb::POLYGON_OFFSETS, gvb::POLYGON_COORDS}, {gvb::TEXT_OFFSETS, gvb::TEXT_CHARS} };
+    for(unsigned int i=0; i<4; ++i)
+    {
+        uint64_t n = count(runs[i][0]);
+        if(n==0) continue;
+        const uint64_t *offsets = data<uint64_t>(runs[i][0]);
+        bool valid = offsets[0]==0 && offsets[n-1]==count(runs[i][1]);
+        for(uint64_t j=1; j<n && valid; ++j)
+            valid = offsets[j-1] <= offsets[j];
+        if(!valid)
+            throw invalid_argument("Corrupted gvb file: " + filename);
+    }
+
+    m_path = absolute_path(filename);
+    boost::mutex::scoped_lock lock(mapped_files_mutex);
+    ++mapped_files[m_path];
+}
+
+gvb_mapped_file::~gvb_mapped_file()
+{
+    boost::mutex::scoped_lock lock(mapped_files_mutex);
+    map<string, unsigned int>::iterator it = mapped_files.find(m_path);
+    if(it!=mapped_files.end() && --it->second==0)
+        mapped_files.erase(it);
+}
+
+unsigned int gvb_mapped_file::mapping_count(const string &filename)
+{
+    boost::mutex::scoped_lock lock(mapped_files_mutex);
+    map<string, unsigned int>::const_iterator it = mapped_files.find(absolute_path(filename));
+    return it==mapped_files.end() ? 0 : it->second;
+}
+
+boost::shared_ptr<layer> gilviewer_file_io_gvb::load(const string &filename, const ptrdiff_t top_left_x, const ptrdiff_t top_left_y, const ptrdiff_t dim_x, const ptrdiff_t dim_y)
+{
+    profiler::scoped_timer timer(profiler::LOAD, filename);
+    boost::shared_ptr<const gvb_mapped_file> mapped(new gvb_mapped_file(filename));
+
+    filesystem::path path(filesystem::system_complete(filename));
+    boost::shared_ptr<simple_vector_layer> layer(new simple_vector_layer(BOOST_FILESYSTEM_STRING(path.stem())));
+    layer->filename(path.string());
+    layer->m_mapped = mapped;
+    layer->m_index_dirty = true;
+    layer->reset_lod();
+
+    // Rotated ellipses and texts are not drawn from the mapping: their control points and strings are rebuilt
+    const gvb::rotated_ellipse *ellipses = mapped->data<gvb::rotated_ellipse>(gvb::ROTATED_ELLIPSES);
+    for(uint64_t i=0; i<mapped->count(gvb::ROTATED_ELLIPSES); ++i)
+        layer->add_ellipse(ellipses[i].x, ellipses[i].y, ellipses[i].a, ellipses[i].b, ellipses[i].theta);
+    const point_type *positions = mapped->data<point_type>(gvb::TEXT_POSITIONS);
+    const uint64_t *offsets = mapped->data<uint64_t>(gvb::TEXT_OFFSETS);
+    const char *chars = mapped->data<char>(gvb::TEXT_CHARS);
+    for(uint64_t i=0; i<mapped->count(gvb::TEXT_POSITIONS) && i+1<mapped->count(gvb::TEXT_OFFSETS); ++i)
+        layer->add_text(positions[i].x, positions[i].y, string(chars+offsets[i], chars+offsets[i+1]));
+
+    return layer;
+}
+
+void gilviewer_file_io_gvb::save(boost::shared_ptr<layer> layer, const string &filename)
+{
+    boost::shared_ptr<simple_vector_layer> l = dynamic_pointer_cast<simple_vector_layer>(layer);
+    if(!l)
+        throw invalid_argument("Bad layer type!\n");
+
+    // The layer may be mapped on the destination file: it is released before the temporary file replaces it.
+    // A mapping held by another layer cannot be released: the file is then not overwritten.
+    const gvb_mapped_file *m = l->m_mapped.get();
+    const bool own_mapping = m && l->m_mapped.unique() && m->path()==absolute_path(filename);
+    if(gvb_mapped_file::mapping_count(filename) > (own_mapping ? 1u : 0u))
+        throw invalid_argument("Unable to overwrite " + filename + ": the file is opened in another layer");
+
+    const string tmp_filename = filename + ".tmp";
+    try
+    {
+        gvb_writer w(tmp_filename);
+
+        w.begin(gvb::CIRCLES);
+        if(m) w.write(m->data<circle_type>(gvb::CIRCLES), m->count(gvb::CIRCLES));
+        if(!l->m_circles.empty()) w.write(&l->m_circles.front(), l->m_circles.size());
+
+        w.begin(gvb::ELLIPSES);
+        if(m) w.write(m->data<ellipse_type>(gvb::ELLIPSES), m->count(gvb::ELLIPSES));
+        if(!l->m_ellipses.empty()) w.write(&l->m_ellipses.front(), l->m_ellipses.size());
+
+        w.begin(gvb::ROTATED_ELLIPSES);
+        for(unsigned int i=0; i<l->m_rotatedellipses.size(); ++i)
+        {
+            const simple_vector_layer::rotated_ellipse_type &e = l->m_rotatedellipses[i];
+            gvb::rotated_ellipse r = { e.x, e.y, e.a, e.b, e.theta };
+            w.write(r);
+        }
+
+        w.begin(gvb::POINTS);
+        if(m) w.write(m->data<point_type>(gvb::POINTS), m->count(gvb::POINTS));
+        if(!l->m_points.empty()) w.write(&l->m_points.front(), l->m_points.size());
+
+        // Arcs, splines and polygons: offset table (mapped runs, then in memory runs) followed by the coordinates
+        const gvb::section_id offsets_ids[3] = { gvb::ARC_OFFSETS, gvb::SPLINE_OFFSETS, gvb::POLYGON_OFFSETS };
+        for(unsigned int k=0; k<3; ++k)
+        {
+            const gvb::section_id offsets_id = offsets_ids[k], coords_id = gvb::section_id(offsets_id+1);
+            const simple_vector_layer::runs_type& runs = k==0 ? l->m_arc_runs : k==1 ? l->m_spline_runs : l->m_polygon_runs;
+
+            uint64_t offset = 0;
+            w.begin(offsets_id);
+            if(m && m->count(offsets_id)>0)
+            {
+                w.write(m->data<uint64_t>(offsets_id), m->count(offsets_id));
+                offset = m->count(coords_id);
+            }
+            else if(runs.size()>0)
+                w.write(offset);
+            for(std::size_t i=1; i<runs.offsets.size(); ++i)
+                w.write(offset+runs.offsets[i]);
+            w.begin(coords_id);
+            if(m) w.write(m->data<point_type>(coords_id), m->count(coords_id));
+            if(!runs.coordinates.empty()) w.write(&runs.coordinates.front(), runs.coordinates.size());
+        }
+
+        w.begin(gvb::TEXT_POSITIONS);
+        for(unsigned int i=0; i<l->m_texts.size(); ++i)
+            w.write(l->m_texts[i].first);
+        w.begin(gvb::TEXT_OFFSETS);
+        uint64_t offset = 0;
+        if(!l->m_texts.empty()) w.write(offset);
+        for(unsigned int i=0; i<l->m_texts.size(); ++i)
+        {
+            offset += l->m_texts[i].second.size();
+            w.write(offset);
+        }
+        w.begin(gvb::TEXT_CHARS);
+        for(unsigned int i=0; i<l->m_texts.size(); ++i)
+            w.write(l->m_texts[i].second.data(), l->m_texts[i].second.size());
+        w.close();
+
+        if(own_mapping)
+            l->unmap();
+        filesystem::rename(tmp_filename, filename);
+    }
+    catch(...)
+    {
+        boost::system::error_code ec;
+        filesystem::remove(tmp_filename, ec);
+        throw;
+    }
+}
+
+boost::shared_ptr<gilviewer_file_io_gvb> create_gilviewer_file_io_gvb()
+{
+    return boost::shared_ptr<gilviewer_file_io_gvb>(new gilviewer_file_io_gvb());
+}
+
+bool gilviewer_file_io_gvb::Register(gilviewer_io_factory *factory)
+{
+    factory->insert("gvb", "Vector", "Native", create_gilviewer_file_io_gvb);
+    return true;
+}
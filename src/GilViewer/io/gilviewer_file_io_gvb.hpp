@@ -0,0 +1,137 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+#ifndef GILVIEWER_FILE_IO_GVB_HPP
+#define GILVIEWER_FILE_IO_GVB_HPP
+
+#include <boost/cstdint.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "gilviewer_file_io.hpp"
+
+/**
+ * @brief Native GilViewer vector format (".gvb").
+ *
+ * The file starts with a versioned header followed by flat sections: fixed size records for circles,
+ * ellipses and points, and offset tables plus flat coordinate arrays for arcs, splines and polygons.
+ * All sections are 8 bytes aligned, so that a simple_vector_layer can draw directly from the memory
+ * mapped file, without any deserialization. Offsets and counts are expressed in elements, not in bytes.
+ **/
+namespace gvb
+{
+    const boost::uint32_t version = 1;
+    const boost::uint32_t byte_order_mark = 0x01020304;
+
+    enum section_id
+    {
+        CIRCLES = 0,      // {x,y,radius}
+        ELLIPSES,         // {x,y,a,b}
+        ROTATED_ELLIPSES, // {x,y,a,b,theta}
+        POINTS,           // {x,y}
+        ARC_OFFSETS,      // uint64, nb arcs + 1
+        ARC_COORDS,       // {x,y}
+        SPLINE_OFFSETS,
+        SPLINE_COORDS,
+        POLYGON_OFFSETS,
+        POLYGON_COORDS,
+        TEXT_POSITIONS,   // {x,y}
+        TEXT_OFFSETS,     // uint64, nb texts + 1
+        TEXT_CHARS,       // char
+        NB_SECTIONS
+    };
+
+    struct section
+    {
+        boost::uint64_t offset; // in bytes, from the beginning of the file
+        boost::uint64_t count;  // in elements
+    };
+
+    struct header
+    {
+        char magic[8];
+        boost::uint32_t version;
+        boost::uint32_t byte_order;
+        boost::uint32_t header_size;
+        boost::uint32_t nb_sections;
+        section sections[NB_SECTIONS];
+    };
+
+    struct rotated_ellipse
+    {
+        double x, y, a, b, theta;
+    };
+}
+
+/// Read only memory mapping of a ".gvb" file
+class gvb_mapped_file
+{
+public:
+    /// Maps the file and checks its header. Throws std::invalid_argument if the file is not a valid ".gvb" file.
+    explicit gvb_mapped_file(const std::string &filename);
+    ~gvb_mapped_file();
+
+    /// Absolute path of the mapped file
+    const std::string& path() const { return m_path; }
+    /// Number of live mappings of the file (a mapped file cannot be replaced on Windows)
+    static unsigned int mapping_count(const std::string &filename);
+
+    boost::uint64_t count(gvb::section_id id) const { return m_sections[id].count; }
+    template<typename T> const T* data(gvb::section_id id) const
+    {
+        return reinterpret_cast<const T*>(static_cast<const char*>(m_region.get_address()) + m_sections[id].offset);
+    }
+
+private:
+    boost::interprocess::file_mapping m_file;
+    boost::interprocess::mapped_region m_region;
+    gvb::section m_sections[gvb::NB_SECTIONS];
+    std::string m_path;
+};
+
+class gilviewer_file_io_gvb : public gilviewer_file_io
+{
+public:
+    virtual ~gilviewer_file_io_gvb() {}
+
+    virtual boost::shared_ptr<layer> load(const std::string &filename, const std::ptrdiff_t top_left_x=0, const std::ptrdiff_t top_left_y=0, const std::ptrdiff_t dim_x=0, const std::ptrdiff_t dim_y=0);
+    virtual void save(boost::shared_ptr<layer> layer, const std::string &filename);
+
+    virtual bool Register(gilviewer_io_factory *factory);
+};
+
+#endif // GILVIEWER_FILE_IO_GVB_HPP
@@ -61,6 +61,7 @@ Authors:
 #include "../layers/image_types.hpp"
 #include "../convenient/macros_gilviewer.hpp"
 #include "../convenient/utils.hpp"
+#include "../tools/profiler.hpp"
 
 template <class TagType>
 struct write_gil_view_visitor : public boost::static_visitor<>
@@ -94,6 +95,7 @@ public:
         using namespace boost::filesystem;
         using namespace std;
 
+        profiler::scoped_timer timer(profiler::LOAD, filename);
         point_t top_left(top_left_x, top_left_y);
         point_t dim(dim_x, dim_y);
 
@@ -134,6 +136,30 @@ public:
         return layer;
     }
 
+    virtual boost::shared_ptr<gilviewer_image_type> load_pixels(const std::string &filename)
+    {
+        using namespace boost::gil;
+        using namespace std;
+
+        profiler::scoped_timer timer(profiler::LOAD, filename);
+        image_layer::image_ptr image(new image_layer::image_t);
+        try
+        {
+            _info = read_image_info(filename , TagType() );
+            _info_read = true;
+            image_read_settings<TagType> settings(point_t(0, 0), point_t(_info._width, _info._height));
+            read_image(filename
+                       , image->value
+                       , settings);
+        }
+        catch( const std::exception &e )
+        {
+            GILVIEWER_LOG_EXCEPTION("Image read error: " + filename);
+            return image_layer::image_ptr();
+        }
+        return image;
+    }
+
     virtual void save(boost::shared_ptr<layer> layer, const std::string &filename )
     {
         save( layer, filename, boost::gil::image_write_info<TagType>() );
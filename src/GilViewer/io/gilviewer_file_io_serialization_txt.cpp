@@ -46,12 +46,14 @@ Authors:
 #include "gilviewer_io_factory.hpp"
 
 #include "../layers/simple_vector_layer.hpp"
+#include "../tools/profiler.hpp"
 
 using namespace boost;
 using namespace std;
 
 boost::shared_ptr<layer> gilviewer_file_io_serialization_txt::load(const string &filename, const ptrdiff_t top_left_x, const ptrdiff_t top_left_y, const ptrdiff_t dim_x, const ptrdiff_t dim_y)
 {
+    profiler::scoped_timer timer(profiler::LOAD, filename);
     simple_vector_layer simple_layer;
     {
         // create and open an archive for input
@@ -76,6 +78,7 @@ void gilviewer_file_io_serialization_txt::save(boost::shared_ptr<layer> layer, c
         boost::archive::text_oarchive oa(ofs);
         // write class instance to archive
         simple_vector_layer simple_layer = *simple_layer2;
+        simple_layer.unmap();
         oa << BOOST_SERIALIZATION_NVP(simple_layer);
         // archive and stream closed when destructors are called
     }
@@ -46,6 +46,7 @@ Authors:
 #include "gilviewer_io_factory.hpp"
 
 #include "../layers/simple_vector_layer.hpp"
+#include "../tools/profiler.hpp"
 
 using namespace boost;
 using namespace boost::archive;
@@ -53,6 +54,7 @@ using namespace std;
 
 boost::shared_ptr<layer> gilviewer_file_io_serialization_xml::load(const string &filename, const ptrdiff_t top_left_x, const ptrdiff_t top_left_y, const ptrdiff_t dim_x, const ptrdiff_t dim_y)
 {
+    profiler::scoped_timer timer(profiler::LOAD, filename);
     simple_vector_layer simple_layer;
     {
         ifstream ifs(filename.c_str());
@@ -67,6 +69,9 @@ void gilviewer_file_io_serialization_xml::save(boost::shared_ptr<layer> layer, c
     boost::shared_ptr<simple_vector_layer> simple_layer = dynamic_pointer_cast<simple_vector_layer>(layer);
     if(!simple_layer)
         throw invalid_argument("Bad layer type (not a simple_vector_layer)!\n");
+    // geometries mapped from a ".gvb" file have to be copied to be serialized
+    simple_layer.reset(new simple_vector_layer(*simple_layer));
+    simple_layer->unmap();
 
     ofstream ofs(filename.c_str());
     {
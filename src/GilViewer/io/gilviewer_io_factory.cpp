@@ -12,6 +12,7 @@
 #include "gilviewer_file_io_serialization_binary.hpp"
 #include "gilviewer_file_io_serialization_txt.hpp"
 #include "gilviewer_file_io_serialization_xml.hpp"
+#include "gilviewer_file_io_gvb.hpp"
 
 void register_all_image_file_formats(gilviewer_io_factory *factory)
 {
@@ -27,6 +28,7 @@ void register_all_vector_file_formats(gilviewer_io_factory *factory)
     gilviewer_file_io_serialization_txt().Register(factory);
     gilviewer_file_io_serialization_xml().Register(factory);
     gilviewer_file_io_serialization_binary().Register(factory);
+    gilviewer_file_io_gvb().Register(factory);
 }
 
 void register_all_file_formats(gilviewer_io_factory *factory)
@@ -40,6 +40,7 @@ Authors:
 
 #include <sstream>
 #include <boost/filesystem.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
 #ifdef WIN32
 	#pragma warning(disable : 4251)
 	#pragma warning(disable : 4275)
@@ -53,10 +54,92 @@ Authors:
 #include "../gui/panel_viewer.hpp"
 #include "../tools/orientation_2d.hpp"
 #include "../tools/color_lookup_table.hpp"
+#include "../tools/pattern_singleton.hpp"
+#include "gilviewer_io_factory.hpp"
 
 using namespace std;
 
 void xml_display_configuration_io::read( layer_control* layerControl , const string filename )
+{
+    read( filename , layerControl , 0 );
+}
+
+void xml_display_configuration_io::read( const string filename , vector<layer::ptrLayerType>& layers )
+{
+    read( filename , 0 , &layers );
+}
+
+void xml_display_configuration_io::apply( const ImageLayerParameters& parameters , layer& l )
+{
+    l.visible(parameters.visible);
+    l.transformable(parameters.transformable);
+    l.alpha(parameters.alpha);
+    l.gamma(parameters.gamma);
+    l.intensity_min(parameters.intensity_min);
+    l.intensity_max(parameters.intensity_max);
+    l.transparent(parameters.transparent);
+    l.transparency_min(parameters.transparency_min);
+    l.transparency_max(parameters.transparency_max);
+    l.transform().zoom_factor(parameters.zoom_factor);
+    l.transform().translation_x(parameters.translation_x);
+    l.transform().translation_y(parameters.translation_y);
+    l.alpha_channel(parameters.useAlphaChannel,parameters.alphaChannel);
+    // TODO: binary or text?
+    l.colorlookuptable()->load_from_binary_file(parameters.lut_file);
+}
+
+void xml_display_configuration_io::apply( const VectorLayerParameters& parameters , layer& l )
+{
+    l.visible(parameters.visible);
+    l.transformable(parameters.transformable);
+
+    l.point_color(parameters.pointsColor);
+    l.point_width(parameters.pointsWidth);
+
+    l.line_color(parameters.linesColor);
+    l.line_width(parameters.linesWidth);
+    l.line_style(parameters.linesStyle);
+
+    l.polygon_border_color(parameters.polygonsRingsColor);
+    l.polygon_inner_color(parameters.polygonsInsideColor);
+    l.polygon_border_width(parameters.polygonsRingsWidth);
+    l.polygon_border_style(parameters.polygonsRingsStyle);
+    l.polygon_inner_style(parameters.polygonsInsideStyle);
+
+    l.transform().zoom_factor(parameters.zoom_factor);
+    l.transform().translation_x(parameters.translation_x);
+    l.transform().translation_y(parameters.translation_y);
+}
+
+namespace
+{
+    layer::ptrLayerType load_file( const string& filename )
+    {
+        string extension(boost::filesystem::extension(filename));
+        extension = extension.substr(1,extension.size()-1);
+        boost::algorithm::to_lower(extension);
+        boost::shared_ptr<gilviewer_file_io> file = PatternSingleton<gilviewer_io_factory>::instance()->create_object(extension);
+        return file->load(filename);
+    }
+}
+
+layer::ptrLayerType xml_display_configuration_io::load( const ImageLayerParameters& parameters )
+{
+    layer::ptrLayerType l = load_file(parameters.path);
+    if (l)
+        apply(parameters, *l);
+    return l;
+}
+
+layer::ptrLayerType xml_display_configuration_io::load( const VectorLayerParameters& parameters )
+{
+    layer::ptrLayerType l = load_file(parameters.path);
+    if (l)
+        apply(parameters, *l);
+    return l;
+}
+
+void xml_display_configuration_io::read( const string filename , layer_control* layerControl , vector<layer::ptrLayerType>* layers )
 {
     TiXmlDocument doc( filename.c_str() );
     if ( !doc.LoadFile() )
@@ -448,7 +531,21 @@ void xml_display_configuration_io::read( layer_control* layerControl , const str
                     parameters.alphaChannel = alpha_channel;
                     parameters.lut_file = lut_path;
 
-                    layerControl->create_new_image_layer_with_parameters(parameters);
+                    if ( layerControl )
+                        layerControl->create_new_image_layer_with_parameters(parameters);
+                    else
+                    {
+                        try
+                        {
+                            layer::ptrLayerType l = load(parameters);
+                            if ( l )
+                                layers->push_back(l);
+                        }
+                        catch (const std::exception &e)
+                        {
+                            GILVIEWER_LOG_EXCEPTION(e.what())
+                        }
+                    }
                 }
                 else
                 {
@@ -470,7 +567,21 @@ void xml_display_configuration_io::read( layer_control* layerControl , const str
                     parameters.translation_x = translation_x;
                     parameters.translation_y = translation_y;
 
-                    layerControl->create_new_vector_layer_with_parameters( parameters );
+                    if ( layerControl )
+                        layerControl->create_new_vector_layer_with_parameters( parameters );
+                    else
+                    {
+                        try
+                        {
+                            layer::ptrLayerType l = load(parameters);
+                            if ( l )
+                                layers->push_back(l);
+                        }
+                        catch (const std::exception &e)
+                        {
+                            GILVIEWER_LOG_EXCEPTION(e.what())
+                        }
+                    }
                 }
 
                 is_image = false;
@@ -478,6 +589,9 @@ void xml_display_configuration_io::read( layer_control* layerControl , const str
         }
         else if ( string(child->Value()) == "Orientation" )
         {
+            // Without viewer, there is no orientation to set
+            if ( !layerControl )
+                continue;
             // On check les valeurs de l'orientation du viewer
             TiXmlNode *childOrientation = 0;
             while( (childOrientation = child->IterateChildren( childOrientation )) )
@@ -554,7 +668,8 @@ void xml_display_configuration_io::read( layer_control* layerControl , const str
         }
     }
     // Finalement, on fait un petit refresh ...
-    layerControl->m_basicDrawPane->Refresh();
+    if ( layerControl )
+        layerControl->m_basicDrawPane->Refresh();
 }
 
 void xml_display_configuration_io::write( const layer_control* layerControl , const string filename )
@@ -40,14 +40,31 @@ Authors:
 #define __XML_DISPLAY_CONFIGURATION_IO_HPP__
 
 #include <string>
+#include <vector>
+
+#include "../layers/layer.hpp"
 
 class layer_control;
+struct param_image_layer;
+struct param_vector_layer;
 
 class xml_display_configuration_io
 {
 public:
     static void read( layer_control* layerControl , const std::string filename );
+    /// Reads the layers of a configuration, with their appearance, without a layer_control (the viewer orientation is ignored)
+    static void read( const std::string filename , std::vector<layer::ptrLayerType>& layers );
     static void write( const layer_control* layerControl , const std::string filename );
+
+    /// Sets the appearance read in a configuration to a layer
+    static void apply( const param_image_layer& parameters , layer& l );
+    static void apply( const param_vector_layer& parameters , layer& l );
+    /// Reads the layer of the parameters through the io factory, and sets its appearance
+    static layer::ptrLayerType load( const param_image_layer& parameters );
+    static layer::ptrLayerType load( const param_vector_layer& parameters );
+
+private:
+    static void read( const std::string filename , layer_control* layerControl , std::vector<layer::ptrLayerType>* layers );
 };
 
 #endif // __XML_DISPLAY_CONFIGURATION_IO_HPP__
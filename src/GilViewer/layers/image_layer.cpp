@@ -40,8 +40,12 @@ Authors:
 #include <sstream>
 #include <limits>
 #include <utility>
+#include <algorithm>
+
+#include <stdexcept>
 
 #include <boost/filesystem.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
 
 #include <boost/gil/algorithm.hpp>
 #include "boost/gil/extension/numeric/sampler.hpp"
@@ -58,9 +62,15 @@ Authors:
 
 #include "../tools/orientation_2d.hpp"
 #include "../tools/color_lookup_table.hpp"
+#include "../tools/image_stats_cache.hpp"
+#include "../tools/profiler.hpp"
+#include "../tools/tracer.hpp"
+#include "../tools/pattern_singleton.hpp"
+#include "../io/gilviewer_io_factory.hpp"
 #include "../layers/image_types.hpp"
 #include "../gui/image_layer_settings_control.hpp"
 #include "../convenient/utils.hpp"
+#include "../convenient/macros_gilviewer.hpp"
 
 #include "image_layer.hpp"
 #include "image_layer_screen_image_functor.hpp"
@@ -71,6 +81,7 @@ Authors:
 
 
 class alpha_image_type : public boost::gil::gray8_image_t {};
+class screen_image_type : public boost::gil::dev3n8_image_t {};
 
 using namespace std;
 using namespace boost::gil;
@@ -100,15 +111,70 @@ struct nb_components_visitor : public boost::static_visitor<size_t>
             result_type operator()(const ViewType& v) const { return apply_operation(v, nb_components_functor()); }
 };
 
+/// Computes the histogram by strips of rows, so that it stops between two strips once the token is cancelled (null result)
+struct strip_histogram_functor
+{
+    typedef histogram_functor::histogram_type histogram_type;
+    typedef boost::shared_ptr<const histogram_type> result_type;
+
+    strip_histogram_functor(double min, double max, const thread_pool::cancellation_token& token) : m_functor(min, max), m_token(token) {}
+
+    template <typename ViewType>
+    result_type operator()(const ViewType& v) const
+    {
+        // About one million pixels per strip
+        const std::ptrdiff_t rows = std::max<std::ptrdiff_t>(1, (1<<20) / std::max<std::ptrdiff_t>(1, v.width()));
+        boost::shared_ptr<histogram_type> sum;
+        for(std::ptrdiff_t y=0; y<v.height(); y+=rows)
+        {
+            if(m_token.cancelled())
+                return result_type();
+            result_type strip = m_functor(subimage_view(v, 0, y, v.width(), std::min(rows, v.height()-y)));
+            if(!sum)
+            {
+                sum.reset(new histogram_type(*strip));
+                continue;
+            }
+            for(std::size_t c=0; c<sum->size(); ++c)
+                for(std::size_t i=0; i<(*sum)[c].size(); ++i)
+                    (*sum)[c][i] += (*strip)[c][i];
+        }
+        if(!sum)
+            return m_functor(v);
+        return sum;
+    }
+
+private:
+    histogram_functor m_functor;
+    thread_pool::cancellation_token m_token;
+};
+
 struct histogram_visitor : public boost::static_visitor<boost::shared_ptr<const histogram_functor::histogram_type> >
 {
-    histogram_visitor(double &min, double &max) : m_min(min), m_max(max) {}
+    histogram_visitor(double min, double max, const thread_pool::cancellation_token& token = thread_pool::cancellation_token()) : m_functor(min, max, token) {}
 
     template <typename ViewType>
-            result_type operator()(const ViewType& v) const { return apply_operation(v, histogram_functor(m_min, m_max)); }
+            result_type operator()(const ViewType& v) const { return apply_operation(v, m_functor); }
 
 private:
-    double m_min, m_max;
+    strip_histogram_functor m_functor;
+};
+
+/// Histogram computation shared by the requests made while it runs (see image_layer::request_histogram)
+struct image_layer::histogram_job
+{
+    thread_pool::cancellation_token token;
+    /// Captured by the GUI thread: the pixels stay alive, even if the layer releases them or is deleted
+    image_ptr image;
+    variant_view_ptr view;
+    std::string filename;
+    unsigned int width, height;
+    double min, max;
+    /// Written by the worker, read by the continuation
+    boost::shared_ptr<const histogram_type> result;
+    std::string error;
+    /// Only used by the GUI thread
+    std::vector< std::pair<thread_pool::cancellation_token, boost::function<void ()> > > requesters;
 };
 
 struct width_visitor : public boost::static_visitor<int>
@@ -123,6 +189,19 @@ struct height_visitor : public boost::static_visitor<int>
             result_type operator()(const ViewType& v) const { return v.height(); }
 };
 
+struct bytes_functor
+{
+    typedef std::size_t result_type;
+    template <typename ViewType>
+            result_type operator()(const ViewType& v) const { return v.width()*v.height()*sizeof(typename ViewType::value_type); }
+};
+
+struct bytes_visitor : public boost::static_visitor<std::size_t>
+{
+    template <typename ViewType>
+            result_type operator()(const ViewType& v) const { return apply_operation(v, bytes_functor()); }
+};
+
 struct image_position_to_string_visitor : public boost::static_visitor<>
 {
     image_position_to_string_visitor(const int i, const int j, std::ostringstream& oss) : m_i(i), m_j(j), m_oss(oss) {}
@@ -179,8 +258,15 @@ private:
 
 void image_layer::init()
 {
-    min_max_visitor mmv;
-    m_minmaxResult = apply_visitor( mmv, m_variant_view->value );
+    // Statistics of large images are expensive: they are read from the persistent cache when available
+    image_stats_cache *cache = image_stats_cache::instance();
+    if(!cache->find_min_max(filename(), width(), height(), m_minmaxResult.first, m_minmaxResult.second))
+    {
+        profiler::scoped_timer timer(profiler::STATISTICS, filename());
+        min_max_visitor mmv;
+        m_minmaxResult = apply_visitor( mmv, m_variant_view->value );
+        cache->store_min_max(filename(), width(), height(), m_minmaxResult.first, m_minmaxResult.second);
+    }
     intensity_min(m_minmaxResult.first);
     intensity_max(m_minmaxResult.second);
 
@@ -204,26 +290,119 @@ image_layer::image_layer(const image_ptr &image, const std::string &name_, const
         layer(),
         m_img(image),
         m_variant_view(v),
+        m_owns_pixels(!v),
+        m_file_size(0), m_last_write_time(0),
+        m_histogram_min(0.), m_histogram_max(0.),
         m_gamma_array( shared_array<float>(new float[m_gamma_array_size+1]) )
 {
     if(!v)
     {
         m_variant_view.reset( new variant_view_t( boost::gil::view(m_img->value) ) );
     }
+    m_width  = apply_visitor(  width_visitor(), m_variant_view->value );
+    m_height = apply_visitor( height_visitor(), m_variant_view->value );
 
     name(name_);
     filename(filename_);
+    try
+    {
+        if(!filename_.empty() && boost::filesystem::exists(filename_))
+        {
+            m_file_size = boost::filesystem::file_size(filename_);
+            m_last_write_time = boost::filesystem::last_write_time(filename_);
+        }
+    }
+    catch(const boost::filesystem::filesystem_error&) {}
 
     init();
 }
 
+image_layer::~image_layer()
+{
+    cancel_histogram();
+}
+
 layer::ptrLayerType image_layer::create_image_layer(const image_ptr &image, const std::string &name, const std::string &filename, const variant_view_ptr& v)
 {
     return ptrLayerType(new image_layer(image,name,filename,v));
 }
 
+void image_layer::load_pixels() const
+{
+    if(m_variant_view)
+        return;
+    // Workers only read the layer: the pixels are read again by the thread owning it
+    if(thread_pool::in_worker())
+        throw std::runtime_error("The pixels of " + filename() + " have been released and cannot be read again by a worker thread");
+    string ext(boost::filesystem::extension(filename()));
+    if(!ext.empty())
+        ext = ext.substr(1);
+    boost::algorithm::to_lower(ext);
+    image_ptr img;
+    if(!ext.empty() && file_unchanged())
+    {
+        boost::shared_ptr<gilviewer_file_io> file = PatternSingleton<gilviewer_io_factory>::instance()->create_object(ext);
+        img = file->load_pixels(filename());
+    }
+    if(!img)
+        throw std::runtime_error("Unable to read the pixels of " + filename() + " again");
+    variant_view_ptr v( new variant_view_t( boost::gil::view(img->value) ) );
+    if(apply_visitor( width_visitor(), v->value )!=m_width || apply_visitor( height_visitor(), v->value )!=m_height)
+        throw std::runtime_error("Unable to read the pixels of " + filename() + " again");
+    m_img = img;
+    m_variant_view = v;
+}
+
+bool image_layer::file_unchanged() const
+{
+    try
+    {
+        return boost::filesystem::exists(filename())
+                && boost::filesystem::file_size(filename())==m_file_size
+                && boost::filesystem::last_write_time(filename())==m_last_write_time;
+    }
+    catch(const boost::filesystem::filesystem_error&)
+    {
+        return false;
+    }
+}
+
+bool image_layer::reloadable() const
+{
+    // The pixels must not be shared (crops, plugins) and must still be readable
+    return m_owns_pixels && m_img.unique() && m_variant_view.unique()
+            && !filename().empty() && file_unchanged();
+}
+
+std::size_t image_layer::memory_size() const
+{
+    std::size_t bytes = 0;
+    if(m_owns_pixels && m_variant_view)
+        bytes += apply_visitor( bytes_visitor(), m_variant_view->value );
+    if(m_alpha_img)
+        bytes += m_alpha_img->width()*m_alpha_img->height();
+    if(m_bitmap && m_bitmap->IsOk())
+        bytes += 4*m_bitmap->GetWidth()*m_bitmap->GetHeight();
+    return bytes;
+}
+
+void image_layer::release_memory()
+{
+    m_bitmap.reset();
+    m_alpha_img.reset();
+    needs_update(true);
+    if(reloadable())
+    {
+        m_variant_view.reset();
+        m_img.reset();
+    }
+}
+
 void image_layer::update(int width, int height)
 {
+    load_pixels();
+    touch();
+
     // Lecture de la configuration des differentes options ...
     wxConfigBase *pConfig = wxConfigBase::Get();
     if (pConfig == NULL)
@@ -234,14 +413,6 @@ void image_layer::update(int width, int height)
     pConfig->Read(wxT("/Options/LoadWoleImage"), &loadWholeImage, true); //TODO
     pConfig->Read(wxT("/Options/BilinearZoom"), &bilinearZoom, false);
 
-    dev3n8_image_t screen_image(width, height);
-    dev3n8_view_t screen_view = boost::gil::view(screen_image);
-
-    if(!m_alpha_img) m_alpha_img.reset(new alpha_image_t);
-    m_alpha_img->recreate(screen_view.dimensions());
-    alpha_image_t::view_t alpha_view = boost::gil::view(*m_alpha_img);
-    fill_pixels(alpha_view, 0);
-
     unsigned int nb_channels = static_cast<int>(nb_components());
     if(m_red>=nb_channels)
         m_red=nb_channels-1;
@@ -249,42 +420,209 @@ void image_layer::update(int width, int height)
         m_green=nb_channels-1;
     if(m_blue>=nb_channels)
         m_blue=nb_channels-1;
-    channel_converter_functor my_cc(
-            intensity_min(), intensity_max(),
-            m_gamma_array, m_gamma_array_size,
-            *m_cLUT, m_red, m_green, m_blue);
-    screen_image_visitor siv(screen_view, my_cc, transform(), alpha_view, m_transparencyMin, m_transparencyMax, m_alpha, transparent());
-    apply_visitor( siv, m_variant_view->value );
 
+    screen_image_type screen_image;
+    screen_image.recreate(width, height);
+    if(!m_alpha_img) m_alpha_img.reset(new alpha_image_t);
+    m_alpha_img->recreate(width, height);
+    render_screen(transform(), screen_image, *m_alpha_img);
+    dev3n8_view_t screen_view = boost::gil::view(screen_image);
+
+    GILVIEWER_TRACE_SCOPE_DETAIL("wxBitmap", name())
     wxImage monImage(screen_view.width(), screen_view.height(), interleaved_view_get_raw_data(screen_view), true);
     monImage.SetAlpha(interleaved_view_get_raw_data(boost::gil::view(*m_alpha_img)), true);
 
     m_bitmap = boost::shared_ptr<wxBitmap>(new wxBitmap(monImage));
 }
 
+void image_layer::render_screen(const layer_transform& trans, screen_image_type& screen, alpha_image_t& alpha) const
+{
+    variant_view_ptr pixels = variant_view();
+    dev3n8_view_t screen_view = boost::gil::view(screen);
+    alpha_image_t::view_t alpha_view = boost::gil::view(alpha);
+    fill_pixels(alpha_view, 0);
+
+    unsigned int last = static_cast<unsigned int>(nb_components())-1;
+    channel_converter_functor my_cc(
+            intensity_min(), intensity_max(),
+            m_gamma_array, m_gamma_array_size,
+            *m_cLUT, std::min(m_red, last), std::min(m_green, last), std::min(m_blue, last));
+    GILVIEWER_TRACE_SCOPE_DETAIL("screen_image_functor", name())
+    screen_image_visitor siv(screen_view, my_cc, trans, alpha_view, m_transparencyMin, m_transparencyMax, m_alpha, transparent());
+    apply_visitor( siv, pixels->value );
+}
+
+void image_layer::render(const layer_transform& viewport, const rgba_view_type& view) const
+{
+    rgba8_view_t dst = view.value;
+    layer_transform trans(transform());
+    trans.zoom_factor(viewport.zoom_factor());
+    trans.translation_x(viewport.translation_x());
+    trans.translation_y(viewport.translation_y());
+
+    screen_image_type screen;
+    screen.recreate(dst.dimensions());
+    alpha_image_t alpha;
+    alpha.recreate(dst.dimensions());
+    render_screen(trans, screen, alpha);
+
+    // Source over destination, as the bitmap drawn by draw
+    for (std::ptrdiff_t y=0; y<dst.height(); ++y)
+    {
+        dev3n8_view_t::x_iterator src_it = boost::gil::view(screen).row_begin(y);
+        gray8_view_t::x_iterator alpha_it = boost::gil::view(alpha).row_begin(y);
+        rgba8_view_t::x_iterator dst_it = dst.row_begin(y);
+        for (std::ptrdiff_t x=0; x<dst.width(); ++x)
+        {
+            unsigned int a = alpha_it[x], na = 255-a;
+            get_color(dst_it[x], red_t())   = (a*at_c<0>(src_it[x]) + na*get_color(dst_it[x], red_t())   + 127)/255;
+            get_color(dst_it[x], green_t()) = (a*at_c<1>(src_it[x]) + na*get_color(dst_it[x], green_t()) + 127)/255;
+            get_color(dst_it[x], blue_t())  = (a*at_c<2>(src_it[x]) + na*get_color(dst_it[x], blue_t())  + 127)/255;
+            get_color(dst_it[x], alpha_t()) = a + (na*get_color(dst_it[x], alpha_t()) + 127)/255;
+        }
+    }
+}
+
 void image_layer::draw(wxDC &dc, wxCoord x, wxCoord y, bool transparent) const
 {
+    if(!m_bitmap)
+        return;
+    touch();
     dc.DrawBitmap(*m_bitmap, x, y, transparent); //-m_translationX+x*m_zoomFactor, -m_translationX+y*m_zoomFactor
 }
 
 size_t image_layer::nb_components() const
 {
+    load_pixels();
     //return apply_operation(m_view->value, nb_components_functor());
     return apply_visitor( nb_components_visitor(), m_variant_view->value );
 }
 
 string image_layer::type_channel() const
 {
+    load_pixels();
     // return apply_operation(m_view->value, type_channel_functor());
     return apply_visitor( type_channel_visitor(), m_variant_view->value );
 }
 
 boost::shared_ptr<const layer::histogram_type> image_layer::histogram(double &min, double &max) const
 {
+    if(m_histogram)
+        return cached_histogram(min, max);
     min = m_minmaxResult.first;
     max = m_minmaxResult.second;
-    histogram_visitor hv(min, max);
-    return apply_visitor(hv, m_variant_view->value);
+    image_stats_cache *cache = image_stats_cache::instance();
+    boost::shared_ptr<histogram_type> cached(new histogram_type);
+    if(cache->find_histogram(filename(), width(), height(), min, max, *cached))
+        m_histogram = cached;
+    else
+    {
+        load_pixels();
+        profiler::scoped_timer timer(profiler::STATISTICS, filename());
+        histogram_visitor hv(min, max);
+        m_histogram = apply_visitor(hv, m_variant_view->value);
+        cache->store_histogram(filename(), width(), height(), min, max, *m_histogram);
+    }
+    m_histogram_min = min;
+    m_histogram_max = max;
+    return m_histogram;
+}
+
+void image_layer::request_histogram(const boost::function<void ()>& ready, const thread_pool::cancellation_token& requester) const
+{
+    if(m_histogram)
+    {
+        ready();
+        return;
+    }
+    if(!m_histogram_job)
+    {
+        boost::shared_ptr<histogram_job> job(new histogram_job);
+        // Pixels released by memory_manager are read again: if the file changed, the histogram is unavailable
+        try
+        {
+            job->image = image();
+            job->view = variant_view();
+        }
+        catch(const std::exception& e)
+        {
+            GILVIEWER_LOG_ERROR("Histogram of " << filename() << ": " << e.what());
+            ready();
+            return;
+        }
+        job->filename = filename();
+        job->width = width();
+        job->height = height();
+        job->min = m_minmaxResult.first;
+        job->max = m_minmaxResult.second;
+        m_histogram_job = job;
+        thread_pool::instance()->submit(boost::bind(&image_layer::compute_histogram, job), thread_pool::PRIORITY_NORMAL,
+                                        job->token, boost::bind(&image_layer::histogram_ready, this, job));
+    }
+    m_histogram_job->requesters.push_back(std::make_pair(requester, ready));
+}
+
+void image_layer::cancel_histogram() const
+{
+    if(!m_histogram_job)
+        return;
+    m_histogram_job->token.cancel();
+    m_histogram_job.reset();
+}
+
+boost::shared_ptr<const layer::histogram_type> image_layer::cached_histogram(double &min, double &max) const
+{
+    min = m_histogram_min;
+    max = m_histogram_max;
+    return m_histogram;
+}
+
+void image_layer::compute_histogram(const boost::shared_ptr<histogram_job>& job)
+{
+    try
+    {
+        image_stats_cache *cache = image_stats_cache::instance();
+        boost::shared_ptr<histogram_type> cached(new histogram_type);
+        if(cache->find_histogram(job->filename, job->width, job->height, job->min, job->max, *cached))
+        {
+            job->result = cached;
+            return;
+        }
+        profiler::scoped_timer timer(profiler::STATISTICS, job->filename);
+        histogram_visitor hv(job->min, job->max, job->token);
+        job->result = apply_visitor(hv, job->view->value);
+        if(job->result)
+            cache->store_histogram(job->filename, job->width, job->height, job->min, job->max, *job->result);
+    }
+    catch(const std::exception& e)
+    {
+        job->error = e.what();
+    }
+    catch(...)
+    {
+        job->error = "unknown error";
+    }
+}
+
+void image_layer::histogram_ready(const boost::shared_ptr<histogram_job>& job) const
+{
+    // A cancelled job has been replaced by a new one
+    if(job!=m_histogram_job)
+        return;
+    m_histogram_job.reset();
+    if(!job->error.empty())
+    {
+        GILVIEWER_LOG_ERROR("Histogram of " << filename() << ": " << job->error);
+    }
+    else if(job->result)
+    {
+        m_histogram = job->result;
+        m_histogram_min = job->min;
+        m_histogram_max = job->max;
+    }
+    for(std::size_t i=0; i<job->requesters.size(); ++i)
+        if(!job->requesters[i].first.cancelled())
+            job->requesters[i].second();
 }
 
 string image_layer::pixel_value(const wxRealPoint& p) const
@@ -292,6 +630,7 @@ string image_layer::pixel_value(const wxRealPoint& p) const
     ostringstream oss;
     oss.precision(6);
     oss<<"(";
+    load_pixels();
     wxPoint pt=transform().to_local_int(p);
     image_position_to_string_visitor iptsv(pt.x, pt.y, oss);
     apply_visitor( iptsv, m_variant_view->value );
@@ -358,6 +697,7 @@ layer::ptrLayerType image_layer::crop_local(const wxRealPoint& p0, const wxRealP
 
     // abort if trivial range
     if(w0<=0 || h0<=0) return ptrLayerType();
+    load_pixels();
     
     subimage_visitor sv(x0, y0, w0, h0);
     variant_view_t::type crop = apply_visitor( sv, m_variant_view->value );
@@ -427,6 +767,6 @@ bool image_layer::snap( eSNAP snap, double d2[], const wxRealPoint& p, wxRealPoi
     return true;
 }
 
-unsigned int image_layer::width () const {return apply_visitor(  width_visitor(), m_variant_view->value );}
-unsigned int image_layer::height() const {return apply_visitor( height_visitor(), m_variant_view->value );}
+unsigned int image_layer::width () const {return m_width ;}
+unsigned int image_layer::height() const {return m_height;}
     
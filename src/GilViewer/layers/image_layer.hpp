@@ -39,10 +39,14 @@ Authors:
 #ifndef __IMAGE_LAYER_HPP__
 #define __IMAGE_LAYER_HPP__
 
+#include <ctime>
+
+#include <boost/cstdint.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/shared_array.hpp>
 
 #include "layer.hpp"
+#include "../tools/thread_pool.hpp"
 
 class orientation_2d;
 class color_lookup_table;
@@ -52,6 +56,8 @@ struct gilviewer_image_type;
 struct view_type;
 struct variant_view_type;
 class alpha_image_type;
+class screen_image_type;
+struct rgba_view_type;
 
 
 
@@ -69,7 +75,8 @@ public:
     typedef boost::shared_ptr<alpha_image_t> alpha_image_ptr;
 
     image_layer(const image_ptr &image, const std::string &name ="Image Layer", const std::string& filename="", const variant_view_ptr& variant_view=variant_view_ptr() );
-    virtual ~image_layer() {}
+    /// Cancels the histogram job (see request_histogram)
+    virtual ~image_layer();
 
 protected:
     void init();
@@ -80,10 +87,24 @@ public:
 
     virtual void update(int width, int height);
     virtual void draw(wxDC &dc, wxCoord x, wxCoord y, bool transparent) const;
+    /// Blends the layer over the view, with the kernels of update but without wx, as seen through the zoom and
+    /// translation of viewport (the orientation of the layer is kept). Can run in a worker thread, as long as the layer
+    /// is neither modified nor released meanwhile: a worker throws std::runtime_error if the pixels have been released.
+    void render(const layer_transform& viewport, const rgba_view_type& view) const;
 
     virtual size_t nb_components() const ;
     std::string type_channel() const;
+    /// Histogram of the pixels on [intensity min, intensity max], computed by the calling thread if not yet available
     virtual boost::shared_ptr<const histogram_type> histogram(double &min, double &max) const;
+    /// Computes the histogram in the thread pool. There is at most one job per layer: the requests made while it runs
+    /// share it. ready is called by the GUI thread (see thread_pool::run_continuations) once the histogram is available
+    /// (see cached_histogram), unless requester is cancelled before. Must be called by the GUI thread.
+    /// If the pixels cannot be read again (see release_memory), the error is logged and ready is called at once.
+    void request_histogram(const boost::function<void ()>& ready, const thread_pool::cancellation_token& requester) const;
+    /// Stops the histogram job, if any. Its requesters are not called.
+    void cancel_histogram() const;
+    /// Histogram computed by histogram or request_histogram, null if none yet
+    boost::shared_ptr<const histogram_type> cached_histogram(double &min, double &max) const;
     virtual std::string pixel_value(const wxRealPoint& p) const;
 
     virtual boost::shared_ptr<color_lookup_table> colorlookuptable();
@@ -132,8 +153,15 @@ public:
 
     virtual ptrLayerType crop_local(const wxRealPoint& p0, const wxRealPoint& p1) const;
 
-    virtual image_ptr image() const { return m_img; }
-    virtual variant_view_ptr  variant_view() const { return m_variant_view; }
+    /// The pixels released by release_memory are read again from the file by the GUI or main thread. Throws
+    /// std::runtime_error if the file changed, or if called by a worker of the thread_pool.
+    virtual image_ptr image() const { load_pixels(); return m_img; }
+    virtual variant_view_ptr  variant_view() const { load_pixels(); return m_variant_view; }
+
+    /// Decoded pixels (when owned by this layer, not by the layer it was cropped from) and screen buffers
+    virtual std::size_t memory_size() const;
+    /// Releases the screen buffers, and the pixels if they can be read again from the file
+    virtual void release_memory();
 
     virtual std::string available_formats_wildcard() const;
     virtual bool saveable() const {return true;}
@@ -149,14 +177,39 @@ public:
     
         protected:
 
-    image_ptr       m_img;
-    variant_view_ptr        m_variant_view;
+    /// Reads the pixels from the file if they have been released
+    void load_pixels() const;
+    /// The file has the size and modification time it had when the layer was built
+    bool file_unchanged() const;
+    /// Renders the pixels seen through trans, and their opacity, in images of the same size
+    void render_screen(const layer_transform& trans, screen_image_type& screen, alpha_image_t& alpha) const;
+    bool reloadable() const;
+
+    struct histogram_job;
+    /// Runs in a worker thread, on the pixels captured by the job
+    static void compute_histogram(const boost::shared_ptr<histogram_job>& job);
+    /// Continuation of the job, run by the GUI thread: keeps the histogram and calls the requesters
+    void histogram_ready(const boost::shared_ptr<histogram_job>& job) const;
+
+    mutable image_ptr       m_img;
+    mutable variant_view_ptr        m_variant_view;
+    /// m_variant_view covers the whole m_img (i.e. the layer is not a crop)
+    bool m_owns_pixels;
+    /// Size and modification time of the file when the layer was built (see file_unchanged)
+    boost::uintmax_t m_file_size;
+    std::time_t m_last_write_time;
+    unsigned int m_width, m_height;
     alpha_image_ptr m_alpha_img;
 
     double m_dx, m_dy;
 
     std::pair<double, double> m_minmaxResult;
 
+    /// Histogram on [m_histogram_min, m_histogram_max], and the job computing it. Only used by the GUI thread.
+    mutable boost::shared_ptr<const histogram_type> m_histogram;
+    mutable double m_histogram_min, m_histogram_max;
+    mutable boost::shared_ptr<histogram_job> m_histogram_job;
+
     boost::shared_ptr<wxBitmap> m_bitmap;
     unsigned int m_red, m_green, m_blue;
     bool m_useAlphaChannel;
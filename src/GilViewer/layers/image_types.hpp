@@ -77,4 +77,11 @@ struct variant_view_type {
     variant_view_type(const type& v) : value(v) {}
 };
 
+/// Target of the offscreen rendering (see image_layer::render)
+struct rgba_view_type {
+    typedef boost::gil::rgba8_view_t type;
+    type value;
+    rgba_view_type(const type& v) : value(v) {}
+};
+
 #endif // __IMAGE_TYPES_HPP__
@@ -0,0 +1,169 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+#include <wx/dc.h>
+#include <wx/dcmemory.h>
+#include <wx/bitmap.h>
+#include <wx/brush.h>
+#include <wx/font.h>
+#include <wx/image.h>
+
+#include "label_engine.hpp"
+
+#include <algorithm>
+
+label_engine::label_engine(int cell_size, std::size_t max_bitmaps) :
+        m_frame(0), m_nb_bitmaps(0), m_max_bitmaps(max_bitmaps),
+        m_cell_size(std::max(1, cell_size)), m_grid_x(0), m_grid_y(0), m_grid_width(0), m_grid_height(0) {}
+
+void label_engine::clear()
+{
+    std::vector<label>().swap(m_labels);
+    m_nb_bitmaps = 0;
+}
+
+void label_engine::begin(wxDC& dc, const wxColour& colour)
+{
+    ++m_frame;
+    wxString font = dc.GetFont().GetNativeFontInfoDesc();
+    if(font!=m_font || colour!=m_colour)
+    {
+        // Extents depend on the font, bitmaps on the font and the colour
+        for(std::size_t i=0;i<m_labels.size();++i)
+        {
+            m_labels[i].measured = false;
+            m_labels[i].bitmap.reset();
+        }
+        m_nb_bitmaps = 0;
+        m_font = font;
+        m_colour = colour;
+    }
+    else if(m_nb_bitmaps>m_max_bitmaps)
+        evict();
+
+    wxSize size = dc.GetSize();
+    m_grid_x = dc.DeviceToLogicalX(0);
+    m_grid_y = dc.DeviceToLogicalY(0);
+    m_grid_width  = (size.GetWidth() +m_cell_size-1)/m_cell_size;
+    m_grid_height = (size.GetHeight()+m_cell_size-1)/m_cell_size;
+    m_grid.assign(static_cast<std::size_t>(std::max(0, m_grid_width))*std::max(0, m_grid_height), 0);
+}
+
+void label_engine::evict()
+{
+    for(std::size_t i=0;i<m_labels.size();++i)
+    {
+        if(m_labels[i].bitmap && m_labels[i].last_frame+1<m_frame)
+        {
+            m_labels[i].bitmap.reset();
+            --m_nb_bitmaps;
+        }
+    }
+}
+
+bool label_engine::occupy(int x0, int y0, int x1, int y1)
+{
+    // Cells of the rectangle, clipped to the grid
+    int i0 = std::max(0, (x0-m_grid_x)/m_cell_size), i1 = std::min(m_grid_width -1, (x1-m_grid_x)/m_cell_size);
+    int j0 = std::max(0, (y0-m_grid_y)/m_cell_size), j1 = std::min(m_grid_height-1, (y1-m_grid_y)/m_cell_size);
+    if(x1<m_grid_x || y1<m_grid_y || i0>i1 || j0>j1)
+        return false;
+    for(int j=j0;j<=j1;++j)
+        for(int i=i0;i<=i1;++i)
+            if(m_grid[static_cast<std::size_t>(j)*m_grid_width+i])
+                return false;
+    for(int j=j0;j<=j1;++j)
+        std::fill(m_grid.begin()+static_cast<std::size_t>(j)*m_grid_width+i0, m_grid.begin()+static_cast<std::size_t>(j)*m_grid_width+i1+1, 1);
+    return true;
+}
+
+bool label_engine::draw(wxDC& dc, std::size_t id, const wxPoint& p, const std::string& text)
+{
+    if(id>=m_labels.size())
+        m_labels.resize(id+1);
+    label& l = m_labels[id];
+    if(!l.converted)
+    {
+        l.text = wxString(text.c_str(), *wxConvCurrent);
+        l.converted = true;
+    }
+    if(!l.measured)
+    {
+        wxCoord w = 0, h = 0;
+        dc.GetTextExtent(l.text, &w, &h);
+        l.extent = wxSize(w, h);
+        l.measured = true;
+    }
+    if(l.extent.GetWidth()<=0 || l.extent.GetHeight()<=0)
+        return false;
+    // Off screen or overlapping labels are not drawn
+    if(!occupy(p.x, p.y, p.x+l.extent.GetWidth()-1, p.y+l.extent.GetHeight()-1))
+        return false;
+
+    if(!l.bitmap)
+    {
+        // The text is rendered white on black: its (antialiased) coverage becomes the alpha of the text colour,
+        // so that the edges blend with what is below the label instead of with a background colour
+        wxBitmap coverage(l.extent.GetWidth(), l.extent.GetHeight());
+        {
+            wxMemoryDC mdc;
+            mdc.SelectObject(coverage);
+            mdc.SetBackground(*wxBLACK_BRUSH);
+            mdc.Clear();
+            mdc.SetFont(dc.GetFont());
+            mdc.SetTextForeground(*wxWHITE);
+            mdc.DrawText(l.text, 0, 0);
+            mdc.SelectObject(wxNullBitmap);
+        }
+        wxImage image(coverage.ConvertToImage());
+        image.SetAlpha();
+        const int nb_pixels = image.GetWidth()*image.GetHeight();
+        unsigned char *rgb = image.GetData(), *alpha = image.GetAlpha();
+        for(int i=0; i<nb_pixels; ++i, rgb+=3)
+        {
+            alpha[i] = std::max(rgb[0], std::max(rgb[1], rgb[2]));
+            rgb[0] = m_colour.Red();
+            rgb[1] = m_colour.Green();
+            rgb[2] = m_colour.Blue();
+        }
+        l.bitmap.reset(new wxBitmap(image));
+        ++m_nb_bitmaps;
+    }
+    l.last_frame = m_frame;
+    dc.DrawBitmap(*l.bitmap, p.x, p.y, true);
+    return true;
+}
@@ -0,0 +1,102 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+#ifndef __LABEL_ENGINE_HPP__
+#define __LABEL_ENGINE_HPP__
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+#include <boost/shared_ptr.hpp>
+
+#include <wx/string.h>
+#include <wx/gdicmn.h>
+#include <wx/colour.h>
+
+class wxDC;
+class wxBitmap;
+
+/**
+ * @brief Draws the texts of a vector layer.
+ *
+ * Labels are identified by their index in the layer. Their converted strings and extents are cached, as well as
+ * the rendered text of the recently drawn labels (one bitmap with alpha per label, for the current font and colour).
+ * Within a frame, a label overlapping a label already drawn is skipped: the drawn labels are marked in a screen
+ * occupancy grid of cell_size pixels. The caller only submits the labels whose anchor is near the view (through its spatial index).
+ **/
+class label_engine
+{
+public:
+    explicit label_engine(int cell_size=4, std::size_t max_bitmaps=4096);
+
+    /// Starts a frame on dc: the occupancy grid is cleared, and the cached extents and bitmaps are dropped if the font or the colour changed
+    void begin(wxDC& dc, const wxColour& colour);
+    /// Draws the label id at the screen point p (top left corner), unless it overlaps a label already drawn in this frame.
+    /// The text is only read the first time the label is seen. Returns whether the label has been drawn.
+    bool draw(wxDC& dc, std::size_t id, const wxPoint& p, const std::string& text);
+    /// Forgets all the labels (the texts of the layer have been modified)
+    void clear();
+
+private:
+    struct label
+    {
+        label() : converted(false), measured(false), last_frame(0) {}
+        wxString text;
+        wxSize extent;
+        bool converted, measured;
+        /// Rendered text, for the current font and colour
+        boost::shared_ptr<wxBitmap> bitmap;
+        unsigned int last_frame;
+    };
+    /// Marks the cells covered by the rectangle, unless one of them is already marked. Returns whether they were free.
+    bool occupy(int x0, int y0, int x1, int y1);
+    /// Drops the bitmaps of the labels not drawn in the current frame
+    void evict();
+
+    std::vector<label> m_labels;
+    wxString m_font;
+    wxColour m_colour;
+    unsigned int m_frame;
+    std::size_t m_nb_bitmaps, m_max_bitmaps;
+
+    /// Occupancy grid of the current frame, covering the device context
+    int m_cell_size, m_grid_x, m_grid_y, m_grid_width, m_grid_height;
+    std::vector<unsigned char> m_grid;
+};
+
+#endif // __LABEL_ENGINE_HPP__
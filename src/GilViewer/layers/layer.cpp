@@ -22,11 +22,12 @@ layer::layer(const boost::function<void()> &notifyLayerControl, const boost::fun
         m_ori(boost::shared_ptr<orientation_2d>(new orientation_2d)),
         m_hasOri(false),
         m_infos(""),
+        m_point_rendering(POINTS_ALL), m_point_cell_size(4),
         m_point_width(3), m_line_width(3),
         m_line_style(wxSOLID),
         m_polygon_border_width(3),
         m_polygon_border_style(wxSOLID), m_polygon_inner_style(wxSOLID),
-        m_point_color(*wxRED), m_line_color(*wxBLUE), m_polygon_border_color(*wxLIGHT_GREY), m_polygon_inner_color(*wxGREEN), m_text_color(*wxRED) {
+        m_point_color(*wxRED), m_line_color(*wxBLUE), m_polygon_border_color(*wxLIGHT_GREY), m_polygon_inner_color(*wxGREEN), m_text_color(*wxRED), m_revision(0) {
     
     static unsigned int countId=0;
     ++countId;
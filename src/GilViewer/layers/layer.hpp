@@ -51,6 +51,8 @@ Authors:
 #include <wx/colour.h>
 
 #include "layer_transform.hpp"
+#include "../tools/bbox_rtree.hpp"
+#include "../tools/memory_manager.hpp"
 
 class wxDC;
 #ifdef WIN32
@@ -62,11 +64,13 @@ class color_lookup_table;
 class layer_settings_control;
 class layer_control;
 
-class layer
+/// Layers account for their memory to memory_manager (see memory_size and release_memory)
+class layer : public memory_manager::client
 {
 public:
     typedef boost::shared_ptr< layer > ptrLayerType;
     typedef std::vector<std::vector<double> > histogram_type;
+    typedef std::pair<wxRealPoint,wxRealPoint> segment_type;
 
     layer(const boost::function<void()> &notifyLayerControl = notify_none, const boost::function<void()> &notifyLayerSettingsControl = notify_none);
     static void notify_none() {}
@@ -114,6 +118,9 @@ public:
     virtual double center_y() {return 0.;}
         
     unsigned int getId()const{return m_id;}
+    /// Revision of the geometries, incremented each time geometries are added or removed.
+    /// Caches built on the content of the layer (e.g. snapping) are valid while it is unchanged.
+    unsigned int revision() const { return m_revision; }
 
     virtual void has_ori(bool hasOri) { m_hasOri = hasOri; }
     virtual bool has_ori() const { return m_hasOri; }
@@ -155,6 +162,8 @@ public:
     virtual void add_vector_layer_content( const std::string &shapefileFileName ) {}
 
     virtual bool snap( eSNAP snap, double d2[], const wxRealPoint& p, wxRealPoint& psnap ) { return false; }
+    /// Appends the segments intersecting a window given in screen coordinates, in screen coordinates (used for SNAP_INTERSECTION)
+    virtual void screen_segments( const bbox_rtree::box& window, std::vector<segment_type>& segments ) const {}
     virtual void add_point( double x , double y ) {}
     virtual void add_text( double x , double y , const std::string &text , const wxColour &color = *wxBLACK ) {}
     virtual void add_line( double x1 , double y1 , double x2 , double y2 ) {}
@@ -164,9 +173,20 @@ public:
     virtual void add_spline( std::vector<std::pair<double, double> > points ) {}
     virtual void add_ellipse(double x_center, double y_center, double a, double b) {}
     virtual void add_ellipse(double x_center, double y_center, double a, double b, double theta) {}
+    /// Bulk appends of n geometries: the coordinates of the geometry i are x[offsets[i]..offsets[i+1]) and y[offsets[i]..offsets[i+1]),
+    /// offsets having n+1 entries. The storage is reserved once and the spatial index is built in bulk.
+    virtual void add_points( const double *x , const double *y , std::size_t n ) {}
+    virtual void add_polylines( const double *x , const double *y , const std::size_t *offsets , std::size_t n ) {}
+    virtual void add_polygons( const double *x , const double *y , const std::size_t *offsets , std::size_t n ) {}
+
+    /// Rendering of the points of vector layers: one marker per point, one marker per occupied cell of point_cell_size() pixels,
+    /// or a density map of the cells through colorlookuptable()
+    enum point_rendering_type { POINTS_ALL=0, POINTS_PER_CELL, POINTS_DENSITY };
 
     void point_color(const wxColor& c, bool update=true)          {m_point_color=c;          if(update) notifyLayerSettingsControl_();}
     void point_width(unsigned int w, bool update=true)            {m_point_width=w;          if(update) notifyLayerSettingsControl_();}
+    void point_rendering(unsigned int r, bool update=true)        {m_point_rendering=r;      if(update) notifyLayerSettingsControl_();}
+    void point_cell_size(unsigned int s, bool update=true)        {m_point_cell_size=s;      if(update) notifyLayerSettingsControl_();}
     void line_color(const wxColor& c, bool update=true)           {m_line_color=c;           if(update) notifyLayerSettingsControl_();}
     void line_width(unsigned int w, bool update=true)             {m_line_width=w;           if(update) notifyLayerSettingsControl_();}
     void line_style(unsigned int s, bool update=true)             {m_line_style=s;           if(update) notifyLayerSettingsControl_();}
@@ -178,6 +198,8 @@ public:
     void text_color(const wxColor& c, bool update=true)           {m_text_color=c;           if(update) notifyLayerSettingsControl_();}
     wxColor point_color() const                                   {return m_point_color;}
     unsigned int point_width() const                              {return m_point_width;}
+    unsigned int point_rendering() const                          {return m_point_rendering;}
+    unsigned int point_cell_size() const                          {return m_point_cell_size;}
     wxColor line_color() const                                    {return m_line_color;}
     unsigned int line_width() const                               {return m_line_width;}
     unsigned int line_style() const                               {return m_line_style;}
@@ -223,10 +245,15 @@ protected:
     //infos du layer
     std::string m_infos;
 
+    unsigned int m_point_rendering, m_point_cell_size;
     unsigned int m_point_width, m_line_width, m_line_style, m_polygon_border_width, m_polygon_border_style, m_polygon_inner_style;
     wxColor m_point_color, m_line_color, m_polygon_border_color, m_polygon_inner_color, m_text_color;
     
     unsigned int m_id;
+    unsigned int m_revision;
+
+    /// Must be called by the methods which add or remove geometries
+    void content_changed() { ++m_revision; }
 
 };
 
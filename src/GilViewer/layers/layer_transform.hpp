@@ -185,7 +185,9 @@ bool snap_segment(const layer_transform& trans, double invzoom2, double d2[], co
     wxRealPoint p0(_p0.x,_p0.y), p1(_p1.x,_p1.y);
     wxRealPoint u(q -p0);
     wxRealPoint v(p1-p0);
-    double t = dot(u,v)/dot(v,v);
+    double vv = dot(v,v);
+    if(vv==0) return false; // degenerated segment: handled by point snapping
+    double t = dot(u,v)/vv;
     if(t<0 || t> 1) return false;
     wxRealPoint proj(p0+t*v);
     double d = squared_distance(q,proj)*invzoom2;
@@ -0,0 +1,279 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <boost/gil/algorithm.hpp>
+
+#include "offscreen_renderer.hpp"
+#include "image_layer.hpp"
+#include "image_types.hpp"
+#include "vector_layer.hpp"
+#include "../tools/tracer.hpp"
+
+using namespace std;
+using namespace boost::gil;
+
+namespace
+{
+    /// Rasterisation of the geometries of the vector layers in a view, without antialiasing.
+    /// The screen coordinates are rounded as by layer_transform::from_local_int, pixel (i,j) covering [i,i+1)x[j,j+1).
+    class vector_rasterizer
+    {
+    public:
+        vector_rasterizer(const rgba8_view_t& view, const layer_transform& transform) : m_view(view), m_transform(transform) {}
+
+        void color(const wxColour& c) { m_color = rgba8_pixel_t(c.Red(), c.Green(), c.Blue(), 255); }
+
+        /// Screen coordinates of a local point: center of the pixel where a wxDC draws it
+        void screen(double lx, double ly, double& sx, double& sy) const
+        {
+            m_transform.from_local(lx, ly, sx, sy);
+            sx = std::floor(sx)+0.5;
+            sy = std::floor(sy)+0.5;
+        }
+
+        /// Fills the polygon of screen coordinates with the even-odd rule, sampling the centers of the pixels
+        void fill(const std::vector<double>& xs, const std::vector<double>& ys)
+        {
+            m_ends.assign(1, xs.size());
+            fill(xs, ys, m_ends);
+        }
+
+        /// Fills the rings of screen coordinates (ending at ring_ends, see vector_layer::get_polygon_rings) together with the even-odd rule
+        void fill(const std::vector<double>& xs, const std::vector<double>& ys, const std::vector<std::size_t>& ring_ends)
+        {
+            const std::size_t n = xs.size();
+            if(n<3)
+                return;
+            double ymin = *std::min_element(ys.begin(), ys.end());
+            double ymax = *std::max_element(ys.begin(), ys.end());
+            std::ptrdiff_t row0 = std::max<std::ptrdiff_t>(0, static_cast<std::ptrdiff_t>(std::ceil(ymin-0.5)));
+            std::ptrdiff_t row1 = std::min<std::ptrdiff_t>(m_view.height(), static_cast<std::ptrdiff_t>(std::ceil(ymax-0.5)));
+            std::vector<double> crossings;
+            for(std::ptrdiff_t row=row0; row<row1; ++row)
+            {
+                const double yc = row+0.5;
+                crossings.clear();
+                for(std::size_t r=0, begin=0; r<ring_ends.size(); begin=ring_ends[r++])
+                {
+                    const std::size_t end = ring_ends[r];
+                    if(end-begin<3)
+                        continue;
+                    for(std::size_t i=begin, j=end-1; i<end; j=i++)
+                        if((ys[i]<=yc) != (ys[j]<=yc))
+                            crossings.push_back(xs[j] + (yc-ys[j])*(xs[i]-xs[j])/(ys[i]-ys[j]));
+                }
+                std::sort(crossings.begin(), crossings.end());
+                for(std::size_t k=0; k+1<crossings.size(); k+=2)
+                    span(row, crossings[k], crossings[k+1]);
+            }
+        }
+
+        /// Segment of width pixels (at least 1) between screen coordinates, with square caps when wider than 1
+        void segment(double x0, double y0, double x1, double y1, unsigned int width)
+        {
+            const double half = std::max(1u, width)/2.;
+            const double length = std::sqrt((x1-x0)*(x1-x0)+(y1-y0)*(y1-y0));
+            if(length==0.)
+            {
+                square(x0, y0, width);
+                return;
+            }
+            const double nx = -(y1-y0)/length*half, ny = (x1-x0)/length*half;
+            m_xs.resize(4); m_ys.resize(4);
+            m_xs[0] = x0+nx; m_ys[0] = y0+ny;
+            m_xs[1] = x1+nx; m_ys[1] = y1+ny;
+            m_xs[2] = x1-nx; m_ys[2] = y1-ny;
+            m_xs[3] = x0-nx; m_ys[3] = y0-ny;
+            fill(m_xs, m_ys);
+            if(width>1)
+            {
+                square(x0, y0, width);
+                square(x1, y1, width);
+            }
+        }
+
+        /// Polyline of screen coordinates, closed for the outlines of the polygons
+        void polyline(const std::vector<double>& xs, const std::vector<double>& ys, unsigned int width, bool closed)
+        {
+            polyline(xs, ys, 0, xs.size(), width, closed);
+        }
+
+        /// Polyline of the screen coordinates [begin,end)
+        void polyline(const std::vector<double>& xs, const std::vector<double>& ys, std::size_t begin, std::size_t end, unsigned int width, bool closed)
+        {
+            for(std::size_t i=begin; i+1<end; ++i)
+                segment(xs[i], ys[i], xs[i+1], ys[i+1], width);
+            if(closed && end-begin>2)
+                segment(xs[end-1], ys[end-1], xs[begin], ys[begin], width);
+        }
+
+        /// Square of width pixels (at least 1) centered on screen coordinates
+        void square(double x, double y, unsigned int width)
+        {
+            const double half = std::max(1u, width)/2.;
+            std::ptrdiff_t row0 = std::max<std::ptrdiff_t>(0, static_cast<std::ptrdiff_t>(std::ceil(y-half-0.5)));
+            std::ptrdiff_t row1 = std::min<std::ptrdiff_t>(m_view.height(), static_cast<std::ptrdiff_t>(std::ceil(y+half-0.5)));
+            for(std::ptrdiff_t row=row0; row<row1; ++row)
+                span(row, x-half, x+half);
+        }
+
+    private:
+        /// Pixels of the row whose centers are in [x0,x1)
+        void span(std::ptrdiff_t row, double x0, double x1)
+        {
+            std::ptrdiff_t begin = std::max<std::ptrdiff_t>(0, static_cast<std::ptrdiff_t>(std::ceil(x0-0.5)));
+            std::ptrdiff_t end = std::min<std::ptrdiff_t>(m_view.width(), static_cast<std::ptrdiff_t>(std::ceil(x1-0.5)));
+            if(begin<end)
+                std::fill(m_view.row_begin(row)+begin, m_view.row_begin(row)+end, m_color);
+        }
+
+        rgba8_view_t m_view;
+        const layer_transform& m_transform;
+        rgba8_pixel_t m_color;
+        std::vector<double> m_xs, m_ys;
+        std::vector<std::size_t> m_ends;
+    };
+
+    void render_vector_layer(const vector_layer& l, const layer_transform& viewport, const rgba8_view_t& view)
+    {
+        layer_transform trans(l.transform());
+        trans.zoom_factor(viewport.zoom_factor());
+        trans.translation_x(viewport.translation_x());
+        trans.translation_y(viewport.translation_y());
+        vector_rasterizer r(view, trans);
+        std::vector<double> lx, ly, sx, sy;
+        std::vector<std::size_t> ring_ends;
+        double x0, y0, x1, y1;
+
+        // 2D
+        const bool filled = l.polygon_inner_style()!=wxTRANSPARENT;
+        const bool outlined = l.polygon_border_style()!=wxTRANSPARENT;
+        for(unsigned int i=0; i<l.num_polygons(); ++i)
+        {
+            lx.clear(); ly.clear(); ring_ends.clear();
+            l.get_polygon_rings(i, lx, ly, ring_ends);
+            sx.resize(lx.size()); sy.resize(ly.size());
+            for(std::size_t j=0; j<lx.size(); ++j)
+                r.screen(lx[j], ly[j], sx[j], sy[j]);
+            if(filled)
+            {
+                r.color(l.polygon_inner_color());
+                r.fill(sx, sy, ring_ends);
+            }
+            if(outlined)
+            {
+                r.color(l.polygon_border_color());
+                for(std::size_t k=0, begin=0; k<ring_ends.size(); begin=ring_ends[k++])
+                    r.polyline(sx, sy, begin, ring_ends[k], l.polygon_border_width(), true);
+            }
+        }
+
+        // 1D
+        if(l.line_style()!=wxTRANSPARENT)
+        {
+            r.color(l.line_color());
+            for(unsigned int i=0; i<l.num_polylines(); ++i)
+            {
+                lx.clear(); ly.clear();
+                l.get_polyline(i, lx, ly);
+                sx.resize(lx.size()); sy.resize(ly.size());
+                for(std::size_t j=0; j<lx.size(); ++j)
+                    r.screen(lx[j], ly[j], sx[j], sy[j]);
+                r.polyline(sx, sy, l.line_width(), false);
+            }
+            for(unsigned int i=0; i<l.num_lines(); ++i)
+            {
+                l.get_line(i, x0, y0, x1, y1);
+                r.screen(x0, y0, x0, y0);
+                r.screen(x1, y1, x1, y1);
+                r.segment(x0, y0, x1, y1, l.line_width());
+            }
+        }
+
+        // 0D
+        r.color(l.point_color());
+        for(unsigned int i=0; i<l.num_points(); ++i)
+        {
+            l.get_point(i, x0, y0);
+            r.screen(x0, y0, x0, y0);
+            r.square(x0, y0, l.point_width());
+        }
+    }
+}
+
+offscreen_renderer::offscreen_renderer(unsigned int width, unsigned int height) :
+        m_width(width), m_height(height), m_background(0, 0, 0, 0) {}
+
+unsigned int offscreen_renderer::render(const std::vector<layer::ptrLayerType>& layers, rgba8_image_t& image) const
+{
+    image.recreate(m_width, m_height);
+    return render(layers, view(image));
+}
+
+unsigned int offscreen_renderer::render(const std::vector<layer::ptrLayerType>& layers, const rgba8_view_t& view) const
+{
+    if(view.width()!=static_cast<std::ptrdiff_t>(m_width) || view.height()!=static_cast<std::ptrdiff_t>(m_height))
+        throw std::invalid_argument("offscreen_renderer: the view does not have the output size");
+    GILVIEWER_TRACE_SCOPE("offscreen_render")
+    fill_pixels(view, m_background);
+    unsigned int skipped = 0;
+    for(std::vector<layer::ptrLayerType>::const_iterator it=layers.begin(); it!=layers.end(); ++it)
+    {
+        if(!(*it)->visible())
+            continue;
+        if(!supported(*it))
+            ++skipped;
+        else if(boost::shared_ptr<const image_layer> l = boost::dynamic_pointer_cast<const image_layer>(*it))
+            l->render(m_viewport, rgba_view_type(view));
+        else
+            render_vector_layer(dynamic_cast<const vector_layer&>(**it), m_viewport, view);
+    }
+    return skipped;
+}
+
+bool offscreen_renderer::supported(const layer::ptrLayerType& l)
+{
+    if(boost::dynamic_pointer_cast<const image_layer>(l))
+        return true;
+    boost::shared_ptr<const vector_layer> v = boost::dynamic_pointer_cast<const vector_layer>(l);
+    return v && v->geometry_accessors();
+}
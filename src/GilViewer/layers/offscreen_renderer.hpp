@@ -0,0 +1,98 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+
+#ifndef __OFFSCREEN_RENDERER_HPP__
+#define __OFFSCREEN_RENDERER_HPP__
+
+#include <vector>
+
+#include <boost/gil/typedefs.hpp>
+
+#include "layer.hpp"
+#include "layer_transform.hpp"
+
+/**
+ * @brief Renders a stack of layers in an RGBA image, without GUI nor wxConfig.
+ *
+ * The image layers are rendered with the kernels of the viewer (see image_layer::render), all through the zoom and
+ * translation of the viewport. The vector layers draw through a wxDC: they are rasterised here instead, from the
+ * geometries given by the accessors of vector_layer, in the order of draw_geometries (polygons, polylines and lines,
+ * then points). The colours are opaque and the pens solid, as with a wxDC. The rings of each polygon, holes and parts
+ * of multipolygons included (see vector_layer::get_polygon_rings), are filled together (even-odd rule) unless the inner
+ * style is wxTRANSPARENT, the points are squares of point_width pixels. Texts, and the circles,
+ * ellipses and splines of simple_vector_layer, which have no accessor, are not drawn.
+ * render does not modify the renderer and may be called from several worker threads (see thread_pool), as long as the
+ * layers are neither modified nor released meanwhile.
+ *
+ * @code
+ * offscreen_renderer renderer(256, 256);
+ * renderer.viewport(layers.front()->transform());
+ * boost::gil::rgba8_image_t thumbnail;
+ * renderer.render(layers, thumbnail);
+ * @endcode
+ **/
+class offscreen_renderer
+{
+public:
+    offscreen_renderer(unsigned int width, unsigned int height);
+
+    void size(unsigned int width, unsigned int height) { m_width = width; m_height = height; }
+    unsigned int width() const { return m_width; }
+    unsigned int height() const { return m_height; }
+    void viewport(const layer_transform& viewport) { m_viewport = viewport; }
+    const layer_transform& viewport() const { return m_viewport; }
+    /// Pixel of the image under the layers (transparent black by default)
+    void background(const boost::gil::rgba8_pixel_t& background) { m_background = background; }
+    const boost::gil::rgba8_pixel_t& background() const { return m_background; }
+
+    /// Renders the visible layers, the first one at the bottom (as in layer_control), in image, resized to the output size.
+    /// Returns the number of visible layers which could not be rendered (neither image nor vector layers, or vector
+    /// layers without geometry accessors, see vector_layer::geometry_accessors): the image is then incomplete.
+    /// supported tells beforehand whether a layer can be rendered.
+    unsigned int render(const std::vector<layer::ptrLayerType>& layers, boost::gil::rgba8_image_t& image) const;
+    /// Same, in a view of the output size
+    unsigned int render(const std::vector<layer::ptrLayerType>& layers, const boost::gil::rgba8_view_t& view) const;
+    static bool supported(const layer::ptrLayerType& l);
+
+private:
+    unsigned int m_width, m_height;
+    layer_transform m_viewport;
+    boost::gil::rgba8_pixel_t m_background;
+};
+
+#endif // __OFFSCREEN_RENDERER_HPP__
@@ -48,8 +48,12 @@ Authors:
 #include "GilViewer/convenient/wxrealpoint.hpp"
 #include "GilViewer/convenient/utils.hpp"
 
+#include "GilViewer/io/gilviewer_file_io_gvb.hpp"
+
 #include "simple_vector_layer.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <sstream>
 using namespace std;
@@ -58,10 +62,8 @@ simple_vector_layer::simple_vector_layer(const std::string& layer_name): vector_
 m_circles(std::vector<circle_type>() ),
 m_ellipses(std::vector<ellipse_type>() ),
 m_rotatedellipses(std::vector<rotated_ellipse_type> ()),
-m_arcs(std::vector<arc_type> ()),
 m_points(std::vector<point_type> ()),
-m_splines(std::vector< spline_type > ()),
-m_polygons(std::vector< polygon_type > ())
+m_index_dirty(false)
 {
     m_name=layer_name;
     filename( "" );
@@ -70,11 +72,272 @@ m_polygons(std::vector< polygon_type > ())
     notifyLayerSettingsControl_();
 }
 
+namespace
+{
+    typedef simple_vector_layer::point_type point_type;
+
+    // Number of runs (arcs, splines or polygons) described by an offset table of the mapped file
+    inline std::size_t mapped_runs(const gvb_mapped_file& m, gvb::section_id offsets)
+    {
+        return m.count(offsets)>0 ? static_cast<std::size_t>(m.count(offsets)-1) : 0;
+    }
+
+    typedef boost::shared_ptr<const gvb_mapped_file> mapped_ptr;
+
+    // Geometry i of a kind: the mapped geometries come first, then the layer containers
+    template<class T>
+    const T& item(const mapped_ptr& m, gvb::section_id s, const std::vector<T>& v, std::size_t i)
+    {
+        std::size_t nm = m ? static_cast<std::size_t>(m->count(s)) : 0;
+        return i<nm ? m->data<T>(s)[i] : v[i-nm];
+    }
+
+    // Coordinates of the run (arc, spline or polygon) i, mapped runs first
+    const point_type* run(const mapped_ptr& m, gvb::section_id offsets, gvb::section_id coords, const simple_vector_layer::runs_type& v, std::size_t i, std::size_t& n)
+    {
+        std::size_t nm = m ? mapped_runs(*m, offsets) : 0;
+        if(i>=nm)
+            return v.run(i-nm, n);
+        const boost::uint64_t *o = m->data<boost::uint64_t>(offsets);
+        n = static_cast<std::size_t>(o[i+1]-o[i]);
+        return m->data<point_type>(coords)+o[i];
+    }
+
+    bbox_rtree::box bounding_box(const point_type* pts, std::size_t n)
+    {
+        bbox_rtree::box b;
+        for(std::size_t j=0;j<n;++j)
+            b.expand(pts[j].x, pts[j].y);
+        return b;
+    }
+
+    // Arcs or polygons as runs of coordinates (see level_of_detail)
+    struct runs_adaptor
+    {
+        runs_adaptor(const mapped_ptr& m, gvb::section_id offsets, gvb::section_id coords, const simple_vector_layer::runs_type& v, std::size_t count, bool closed) :
+                m_mapped(m), m_offsets(offsets), m_coords(coords), m_runs(v), m_count(count), m_closed(closed) {}
+
+        std::size_t size() const { return m_count; }
+        const point_type* run(std::size_t i, std::size_t& n) const { return ::run(m_mapped, m_offsets, m_coords, m_runs, i, n); }
+        bool closed(std::size_t) const { return m_closed; }
+
+        const mapped_ptr& m_mapped;
+        gvb::section_id m_offsets, m_coords;
+        const simple_vector_layer::runs_type& m_runs;
+        std::size_t m_count;
+        bool m_closed;
+    };
+
+    // Appends the segment [a,b] in screen coordinates if its bounding box intersects the local window
+    void push_screen_segment(const layer_transform& t, const bbox_rtree::box& local, const point_type& a, const point_type& b, std::vector<layer::segment_type>& segments)
+    {
+        if(!local.intersects(bbox_rtree::box(a.x, a.y, b.x, b.y)))
+            return;
+        segments.push_back(layer::segment_type(t.from_local(a), t.from_local(b)));
+    }
+
+    void draw_circle(wxDC &dc, const layer_transform& t, const simple_vector_layer::circle_type& c)
+    {
+        wxPoint p = t.from_local_int(c);
+        wxCoord r = static_cast<wxCoord>(c.radius / t.zoom_factor());
+        dc.DrawCircle(p, r);
+    }
+
+    void draw_ellipse(wxDC &dc, const layer_transform& t, const simple_vector_layer::ellipse_type& e)
+    {
+        wxPoint p = t.from_local_int(e);
+        wxSize  s(
+                static_cast<wxCoord>(2*e.a/t.zoom_factor()),
+                static_cast<wxCoord>(2*e.b/t.zoom_factor())
+                );
+        dc.DrawEllipse(p,s);
+    }
+
+    // Number of batched polygon vertices above which the batch is drawn
+    const std::size_t max_batch_points = 65536;
+
+    void batch_polygon(const layer_transform& t, const point_type* pts, std::size_t n, std::vector<wxPoint>& points, std::vector<int>& counts)
+    {
+        if(n==0) return;
+        for (std::size_t j=0;j<n;++j)
+            points.push_back(t.from_local_int(pts[j]));
+        counts.push_back(static_cast<int>(n));
+    }
+
+    void flush_polygons(wxDC &dc, std::vector<wxPoint>& points, std::vector<int>& counts)
+    {
+        if(!counts.empty())
+            dc.DrawPolyPolygon(static_cast<int>(counts.size()), &counts.front(), &points.front(), 0, 0, wxODDEVEN_RULE);
+        points.clear();
+        counts.clear();
+    }
+
+    void draw_arc(wxDC &dc, const layer_transform& t, const point_type* pts, std::size_t n, std::vector<wxPoint>& points)
+    {
+        if(n<2) return;
+        points.resize(n);
+        for (std::size_t j=0;j<n;++j)
+            points[j] = t.from_local_int(pts[j]);
+        dc.DrawLines(static_cast<int>(n), &points.front());
+    }
+
+    void draw_spline(wxDC &dc, const layer_transform& t, const point_type* pts, std::size_t n, std::vector<wxPoint>& points)
+    {
+        if(n<2) return;
+        points.resize(n);
+        for (std::size_t j=0;j<n;++j)
+            points[j] = t.from_local_int(pts[j]);
+        dc.DrawSpline(static_cast<int>(n),&points.front());
+    }
+}
+
+std::size_t simple_vector_layer::index_size(index_kind kind) const
+{
+    switch(kind)
+    {
+    case CIRCLE_INDEX:          return (m_mapped ? m_mapped->count(gvb::CIRCLES) : 0) + m_circles.size();
+    case ELLIPSE_INDEX:         return (m_mapped ? m_mapped->count(gvb::ELLIPSES) : 0) + m_ellipses.size();
+    case ROTATED_ELLIPSE_INDEX: return m_rotatedellipses.size();
+    case POLYGON_INDEX:         return (m_mapped ? mapped_runs(*m_mapped, gvb::POLYGON_OFFSETS) : 0) + m_polygon_runs.size();
+    case ARC_INDEX:             return (m_mapped ? mapped_runs(*m_mapped, gvb::ARC_OFFSETS) : 0) + m_arc_runs.size();
+    case SPLINE_INDEX:          return (m_mapped ? mapped_runs(*m_mapped, gvb::SPLINE_OFFSETS) : 0) + m_spline_runs.size();
+    case POINT_INDEX:           return (m_mapped ? m_mapped->count(gvb::POINTS) : 0) + m_points.size();
+    case TEXT_INDEX:            return m_texts.size();
+    default:                    return 0;
+    }
+}
+
+bbox_rtree::box simple_vector_layer::bounding_box(index_kind kind, std::size_t i) const
+{
+    std::size_t n;
+    switch(kind)
+    {
+    case CIRCLE_INDEX:
+    {
+        const circle_type& c = item(m_mapped, gvb::CIRCLES, m_circles, i);
+        return bbox_rtree::box(c.x-c.radius, c.y-c.radius, c.x+c.radius, c.y+c.radius);
+    }
+    case ELLIPSE_INDEX:
+    {
+        // Ellipses are stored by their top left corner
+        const ellipse_type& e = item(m_mapped, gvb::ELLIPSES, m_ellipses, i);
+        return bbox_rtree::box(e.x, e.y, e.x+2*e.a, e.y+2*e.b);
+    }
+    case ROTATED_ELLIPSE_INDEX:
+    {
+        bbox_rtree::box b;
+        const std::vector<wxPoint>& pts = m_rotatedellipses[i].controlPoints;
+        for(std::size_t j=0;j<pts.size();++j)
+            b.expand(pts[j].x, pts[j].y);
+        return b;
+    }
+    case POLYGON_INDEX:
+    {
+        const point_type *pts = run(m_mapped, gvb::POLYGON_OFFSETS, gvb::POLYGON_COORDS, m_polygon_runs, i, n);
+        return ::bounding_box(pts, n);
+    }
+    case ARC_INDEX:
+    {
+        const point_type *pts = run(m_mapped, gvb::ARC_OFFSETS, gvb::ARC_COORDS, m_arc_runs, i, n);
+        return ::bounding_box(pts, n);
+    }
+    case SPLINE_INDEX:
+    {
+        const point_type *pts = run(m_mapped, gvb::SPLINE_OFFSETS, gvb::SPLINE_COORDS, m_spline_runs, i, n);
+        return ::bounding_box(pts, n);
+    }
+    case POINT_INDEX:
+    {
+        const point_type& p = item(m_mapped, gvb::POINTS, m_points, i);
+        return bbox_rtree::box(p.x, p.y, p.x, p.y);
+    }
+    case TEXT_INDEX:
+        return bbox_rtree::box(m_texts[i].first.x, m_texts[i].first.y, m_texts[i].first.x, m_texts[i].first.y);
+    default:
+        return bbox_rtree::box();
+    }
+}
+
+void simple_vector_layer::build_index() const
+{
+    std::vector<bbox_rtree::entry> entries;
+    for(unsigned int k=0;k<NB_INDICES;++k)
+    {
+        index_kind kind = static_cast<index_kind>(k);
+        std::size_t n = index_size(kind);
+        entries.clear();
+        entries.reserve(n);
+        for(std::size_t i=0;i<n;++i)
+        {
+            bbox_rtree::box b = bounding_box(kind, i);
+            if(!b.empty())
+                entries.push_back(bbox_rtree::entry(b, static_cast<unsigned int>(i)));
+        }
+        m_index[k].bulk_load(entries);
+    }
+    m_index_dirty = false;
+}
+
+void simple_vector_layer::index_last(index_kind kind)
+{
+    invalidate_cache();
+    content_changed();
+    // A dirty index is rebuilt in bulk anyway
+    if(m_index_dirty)
+        return;
+    std::size_t i = index_size(kind)-1;
+    bbox_rtree::box b = bounding_box(kind, i);
+    if(!b.empty())
+        m_index[kind].insert(b, static_cast<unsigned int>(i));
+}
+
+void simple_vector_layer::visible(index_kind kind, const bbox_rtree::box& viewport, std::vector<unsigned int>& ids) const
+{
+    ids.clear();
+    m_index[kind].query(viewport, ids);
+    std::sort(ids.begin(), ids.end());
+}
+
+void simple_vector_layer::build_lod() const
+{
+    boost::shared_ptr<lod_type> lod(new lod_type);
+    lod->polygons.build(runs_adaptor(m_mapped, gvb::POLYGON_OFFSETS, gvb::POLYGON_COORDS, m_polygon_runs, index_size(POLYGON_INDEX), true));
+    lod->arcs.build(runs_adaptor(m_mapped, gvb::ARC_OFFSETS, gvb::ARC_COORDS, m_arc_runs, index_size(ARC_INDEX), false));
+    boost::mutex::scoped_lock lock(m_lod_mutex);
+    m_lod = lod;
+}
+
+void simple_vector_layer::reset_lod()
+{
+    invalidate_lod();
+    boost::mutex::scoped_lock lock(m_lod_mutex);
+    m_lod.reset();
+}
+
 //void simple_vector_layer::Draw(wxDC &dc, wxCoord x, wxCoord y, bool transparent, double zoomFactor, double translationX, double translationY, double resolution) const
-void simple_vector_layer::draw(wxDC &dc, wxCoord x, wxCoord y, bool transparent) const
+void simple_vector_layer::draw_geometries(wxDC &dc) const
 {
     wxPen pen;
     wxBrush brush;
+    std::vector<wxPoint> points;
+    std::vector<int> counts;
+    std::vector<unsigned int> ids;
+    std::size_t n;
+
+    if(m_index_dirty)
+        build_index();
+    // When zoomed out, the simplified polygons and arcs are drawn
+    update_lod();
+    boost::shared_ptr<const lod_type> lod;
+    {
+        boost::mutex::scoped_lock lock(m_lod_mutex);
+        lod = m_lod;
+    }
+    const level_of_detail<point_type>::level *polygons_lod = lod ? lod->polygons.select(transform().zoom_factor()) : 0;
+    const level_of_detail<point_type>::level *arcs_lod = lod ? lod->arcs.select(transform().zoom_factor()) : 0;
+    // Only the geometries intersecting the viewport (grown by the pen widths) are drawn
+    int width = std::max(m_point_width, std::max(m_line_width, m_polygon_border_width));
+    bbox_rtree::box viewport = local_viewport(dc, width+1);
 
     // 2D
     pen.SetWidth(m_polygon_border_width);
@@ -84,96 +347,84 @@ void simple_vector_layer::draw(wxDC &dc, wxCoord x, wxCoord y, bool transparent)
     brush.SetStyle(m_polygon_inner_style);
     dc.SetPen(pen);
     dc.SetBrush(brush);
-    for (unsigned int i = 0; i < m_circles.size(); i++)
-    {
-        wxPoint p = transform().from_local_int(m_circles[i]);
-        wxCoord r = static_cast<wxCoord>(m_circles[i].radius / transform().zoom_factor());
-        dc.DrawCircle(p, r);
-    }
+    visible(CIRCLE_INDEX, viewport, ids);
+    for (std::size_t i = 0; i < ids.size(); i++)
+        draw_circle(dc, transform(), item(m_mapped, gvb::CIRCLES, m_circles, ids[i]));
     // Ellipses alignees
-    for (unsigned int i=0;i<m_ellipses.size();++i)
-    {
-        wxPoint p = transform().from_local_int(m_ellipses[i]);
-        wxSize  s(
-                static_cast<wxCoord>(2*m_ellipses[i].a/transform().zoom_factor()),
-                static_cast<wxCoord>(2*m_ellipses[i].b/transform().zoom_factor())
-                );
-        dc.DrawEllipse(p,s);
-        //dc.DrawEllipticArc(p,s,0.,90.);
-        //dc.DrawEllipticArcRot(p,s,0.,90.);
-    }
+    visible(ELLIPSE_INDEX, viewport, ids);
+    for (std::size_t i = 0; i < ids.size(); i++)
+        draw_ellipse(dc, transform(), item(m_mapped, gvb::ELLIPSES, m_ellipses, ids[i]));
     // Ellipses non alignees
-    for (unsigned int i=0;i<m_rotatedellipses.size();++i)
+    visible(ROTATED_ELLIPSE_INDEX, viewport, ids);
+    for (std::size_t i=0;i<ids.size();++i)
     {
-        std::vector<wxPoint> points;
-        points.reserve( m_rotatedellipses[i].controlPoints.size() );
-        for (unsigned int j=0;j<m_rotatedellipses[i].controlPoints.size();++j)
-            points.push_back(transform().from_local_int(m_rotatedellipses[i].controlPoints[j]));
+        const rotated_ellipse_type& e = m_rotatedellipses[ids[i]];
+        points.clear();
+        points.reserve( e.controlPoints.size() );
+        for (unsigned int j=0;j<e.controlPoints.size();++j)
+            points.push_back(transform().from_local_int(e.controlPoints[j]));
         dc.DrawSpline(static_cast<int>(points.size()),&points.front());
     }
-    for (unsigned int i=0;i<m_polygons.size();++i)
+    // Filled polygons are drawn one by one, so that each fill covers the outlines of the polygons below.
+    // Outlines only are batched in DrawPolyPolygon calls, as their overlaps do not matter.
+    const bool batch_polygons = (m_polygon_inner_style==wxTRANSPARENT);
+    visible(POLYGON_INDEX, viewport, ids);
+    for (std::size_t i=0;i<ids.size();++i)
     {
-        std::vector<wxPoint> points;
-        points.reserve( m_polygons[i].size() );
-        for (unsigned int j=0;j<m_polygons[i].size();++j)
-            points.push_back(transform().from_local_int(m_polygons[i][j]));
-        dc.DrawPolygon( static_cast<int>(points.size()) , &(points.front()) );
+        const point_type *pts = polygons_lod ? polygons_lod->run(ids[i], n) : run(m_mapped, gvb::POLYGON_OFFSETS, gvb::POLYGON_COORDS, m_polygon_runs, ids[i], n);
+        batch_polygon(transform(), pts, n, points, counts);
+        if(!batch_polygons || points.size()>=max_batch_points)
+            flush_polygons(dc, points, counts);
     }
+    flush_polygons(dc, points, counts);
 
     // 1D
     pen.SetColour(m_line_color);
     pen.SetWidth(m_line_width);
     pen.SetStyle(m_line_style);
     dc.SetPen(pen);
-    for (unsigned int i = 0; i < m_arcs.size(); i++)
+    visible(ARC_INDEX, viewport, ids);
+    for (std::size_t i=0;i<ids.size();++i)
     {
-        const arc_type &local_tab = m_arcs[i];
-        for (unsigned int j = 0; j < local_tab.arc_points.size() - 1; ++j)
-        {
-            wxPoint p = transform().from_local_int(local_tab.arc_points[j  ]);
-            wxPoint q = transform().from_local_int(local_tab.arc_points[j+1]);
-            dc.DrawLine(p,q);
-        }
+        const point_type *pts = arcs_lod ? arcs_lod->run(ids[i], n) : run(m_mapped, gvb::ARC_OFFSETS, gvb::ARC_COORDS, m_arc_runs, ids[i], n);
+        draw_arc(dc, transform(), pts, n, points);
     }
     // Splines
-    for (unsigned int i=0;i<m_splines.size();++i)
+    visible(SPLINE_INDEX, viewport, ids);
+    for (std::size_t i=0;i<ids.size();++i)
     {
-        const spline_type& spline = m_splines[i];
-        std::vector<wxPoint> points;
-        unsigned int n = static_cast<int>(spline.size());
-        for (unsigned int j=0;j<n;++j)
-        {
-            wxPoint p = transform().from_local_int(spline[j]);
-            points.push_back(p);
-        }
-        dc.DrawSpline(n,&points.front());
+        const point_type *pts = run(m_mapped, gvb::SPLINE_OFFSETS, gvb::SPLINE_COORDS, m_spline_runs, ids[i], n);
+        draw_spline(dc, transform(), pts, n, points);
     }
 
     // 0D
     pen.SetColour(m_point_color);
     pen.SetWidth(m_point_width);
     dc.SetPen(pen);
-    for (unsigned int i = 0; i < m_points.size(); i++)
-    {
-        wxPoint p = transform().from_local_int(m_points[i]);
-        //dc.DrawLine(p);
-        dc.DrawPoint(p);
-    }
-
-    // Text
-    if(text_visibility())
+    if(!draw_points(dc, m_index[POINT_INDEX]))
     {
-        pen.SetColour(m_text_color);
-        dc.SetPen(pen);
-        for (unsigned int i = 0; i < m_texts.size(); i++)
+        visible(POINT_INDEX, viewport, ids);
+        for (std::size_t i = 0; i < ids.size(); i++)
         {
-            wxPoint p = transform().from_local_int(m_texts[i].first);
+            wxPoint p = transform().from_local_int(item(m_mapped, gvb::POINTS, m_points, ids[i]));
             //dc.DrawLine(p);
-            dc.DrawText(wxString(m_texts[i].second.c_str(),*wxConvCurrent),p);
+            dc.DrawPoint(p);
         }
     }
 }
 
+void simple_vector_layer::draw_texts(wxDC &dc) const
+{
+    if(m_index_dirty)
+        build_index();
+    // Texts extend to the right of their anchor: keep a wider margin
+    std::vector<unsigned int> ids;
+    visible(TEXT_INDEX, local_viewport(dc, 256), ids);
+    m_label_engine.begin(dc, m_text_color);
+    for (std::size_t i = 0; i < ids.size(); i++)
+        m_label_engine.draw(dc, ids[i], transform().from_local_int(m_texts[ids[i]].first), m_texts[ids[i]].second);
+}
+
 void simple_vector_layer::add_circle(double x, double y, double radius)
 {
     circle_type ct;
@@ -181,25 +432,27 @@ void simple_vector_layer::add_circle(double x, double y, double radius)
     ct.y = y;
     ct.radius = radius;
     m_circles.push_back(ct);
+    index_last(CIRCLE_INDEX);
 }
 
 void simple_vector_layer::add_line(double x1, double y1, double x2, double y2)
 {
-    arc_type unArc;
-    point_type unPoint;
-    unPoint.x = x1; unPoint.y = y1;
-    unArc.arc_points.push_back(unPoint);
-    unPoint.x = x2; unPoint.y = y2;
-    unArc.arc_points.push_back(unPoint);
-    m_arcs.push_back(unArc);
+    reset_lod();
+    point_type unArc[2];
+    unArc[0].x = x1; unArc[0].y = y1;
+    unArc[1].x = x2; unArc[1].y = y2;
+    m_arc_runs.push_back(unArc, 2);
+    index_last(ARC_INDEX);
 }
 
 void simple_vector_layer::add_polyline( const std::vector<double> &x , const std::vector<double> &y )
 {
-    assert(x.size()==y.size());
-    for(unsigned int i=0;i<x.size()-1;++i)
-        add_line(x[i  ],y[i  ],
-                 x[i+1],y[i+1]);
+    // The polyline is stored as a single arc
+    if (x.size() != y.size() || x.size() < 2)
+        return;
+    reset_lod();
+    m_arc_runs.push_back(&x.front(), &y.front(), x.size());
+    index_last(ARC_INDEX);
 }
 
 void simple_vector_layer::add_point( double x , double y )
@@ -207,23 +460,62 @@ void simple_vector_layer::add_point( double x , double y )
     point_type pt;
     pt.x=x; pt.y=y;
     m_points.push_back(pt);
+    index_last(POINT_INDEX);
 }
 
 void simple_vector_layer::add_spline( spline_type points )
 {
-    m_splines.push_back( points );
+    m_spline_runs.push_back(points.empty() ? 0 : &points.front(), points.size());
+    index_last(SPLINE_INDEX);
 }
 void simple_vector_layer::add_polygon( const std::vector<double> &x , const std::vector<double> &y )
 {
     if (x.size() != y.size())
         return;
-    m_polygons.resize(m_polygons.size()+1);
-    for (unsigned int j=0;j<x.size();++j)
+    reset_lod();
+    m_polygon_runs.push_back(x.empty() ? 0 : &x.front(), y.empty() ? 0 : &y.front(), x.size());
+    index_last(POLYGON_INDEX);
+}
+
+void simple_vector_layer::add_points( const double *x , const double *y , std::size_t n )
+{
+    invalidate_cache();
+    content_changed();
+    runs_type::grow(m_points, n);
+    point_type pt;
+    for (std::size_t i=0;i<n;++i)
     {
-        point_type pt;
-        pt.x=x[j]; pt.y=y[j];
-        m_polygons.back().push_back(pt);
+        pt.x=x[i]; pt.y=y[i];
+        m_points.push_back(pt);
     }
+    m_index_dirty = true;
+}
+
+void simple_vector_layer::add_polylines( const double *x , const double *y , const std::size_t *offsets , std::size_t n )
+{
+    if(n==0)
+        return;
+    reset_lod();
+    invalidate_cache();
+    content_changed();
+    m_arc_runs.reserve(n, offsets[n]-offsets[0]);
+    for (std::size_t i=0;i<n;++i)
+        if(offsets[i+1]-offsets[i]>=2)
+            m_arc_runs.push_back(x+offsets[i], y+offsets[i], offsets[i+1]-offsets[i]);
+    m_index_dirty = true;
+}
+
+void simple_vector_layer::add_polygons( const double *x , const double *y , const std::size_t *offsets , std::size_t n )
+{
+    if(n==0)
+        return;
+    reset_lod();
+    invalidate_cache();
+    content_changed();
+    m_polygon_runs.reserve(n, offsets[n]-offsets[0]);
+    for (std::size_t i=0;i<n;++i)
+        m_polygon_runs.push_back(x+offsets[i], y+offsets[i], offsets[i+1]-offsets[i]);
+    m_index_dirty = true;
 }
 
 
@@ -235,6 +527,7 @@ void simple_vector_layer::add_ellipse(double x_center, double y_center, double a
     et.a = a;
     et.b = b;
     m_ellipses.push_back(et);
+    index_last(ELLIPSE_INDEX);
 }
 
 void simple_vector_layer::add_ellipse(double dx_center, double dy_center, double da, double db, double theta)
@@ -268,6 +561,7 @@ void simple_vector_layer::add_ellipse(double dx_center, double dy_center, double
     et.controlPoints.push_back(wxPoint(x_center-a,y_center));
 
     m_rotatedellipses.push_back(et);
+    index_last(ROTATED_ELLIPSE_INDEX);
 }
 
 void simple_vector_layer::add_text( double x , double y , const std::string &text , const wxColour &color )
@@ -275,27 +569,83 @@ void simple_vector_layer::add_text( double x , double y , const std::string &tex
     point_type pt;
     pt.x=x; pt.y=y;
     m_texts.push_back( make_pair<point_type,string>(pt,text) );
+    index_last(TEXT_INDEX);
+}
+
+std::size_t simple_vector_layer::memory_size() const
+{
+    std::size_t bytes = vector_layer::memory_size();
+    bytes += m_circles.capacity()*sizeof(circle_type) + m_ellipses.capacity()*sizeof(ellipse_type);
+    bytes += m_rotatedellipses.capacity()*sizeof(rotated_ellipse_type) + m_points.capacity()*sizeof(point_type);
+    bytes += m_texts.capacity()*sizeof(text_type);
+    bytes += m_arc_runs.memory() + m_spline_runs.memory() + m_polygon_runs.memory();
+    boost::mutex::scoped_lock lock(m_lod_mutex);
+    if(m_lod)
+        bytes += m_lod->polygons.memory() + m_lod->arcs.memory();
+    return bytes;
 }
 
 void simple_vector_layer::clear()
 {
+    reset_lod();
+    invalidate_cache();
+    content_changed();
     m_circles.clear();
     m_ellipses.clear();
     m_rotatedellipses.clear();
-    m_arcs.clear();
     m_points.clear();
-    m_splines.clear();
-    m_polygons.clear();
     m_texts.clear();
+    m_label_engine.clear();
     // deallocate memory
     vector<circle_type>().        swap(m_circles);
     vector<ellipse_type>().       swap(m_ellipses);
     vector<rotated_ellipse_type>().swap(m_rotatedellipses);
-    vector<arc_type>().           swap(m_arcs);
     vector<point_type>().         swap(m_points);
-    vector<spline_type>().swap(m_splines);
-    vector<polygon_type>().swap(m_polygons);
     vector<text_type>().swap(m_texts);
+    m_arc_runs.clear();
+    m_spline_runs.clear();
+    m_polygon_runs.clear();
+    m_mapped.reset();
+    for(unsigned int k=0;k<NB_INDICES;++k)
+        m_index[k].clear();
+    m_index_dirty = false;
+}
+
+void simple_vector_layer::unmap()
+{
+    if(!m_mapped) return;
+    reset_lod();
+    boost::shared_ptr<const gvb_mapped_file> mapped = m_mapped;
+    m_mapped.reset();
+
+    const circle_type *circles = mapped->data<circle_type>(gvb::CIRCLES);
+    m_circles.insert(m_circles.begin(), circles, circles+mapped->count(gvb::CIRCLES));
+    const ellipse_type *ellipses = mapped->data<ellipse_type>(gvb::ELLIPSES);
+    m_ellipses.insert(m_ellipses.begin(), ellipses, ellipses+mapped->count(gvb::ELLIPSES));
+    const point_type *points = mapped->data<point_type>(gvb::POINTS);
+    m_points.insert(m_points.begin(), points, points+mapped->count(gvb::POINTS));
+
+    // The mapped runs are copied in front of the runs of the layer
+    const gvb::section_id offsets_ids[3] = { gvb::ARC_OFFSETS, gvb::SPLINE_OFFSETS, gvb::POLYGON_OFFSETS };
+    runs_type *layer_runs[3] = { &m_arc_runs, &m_spline_runs, &m_polygon_runs };
+    for(unsigned int k=0; k<3; ++k)
+    {
+        const boost::uint64_t *offsets = mapped->data<boost::uint64_t>(offsets_ids[k]);
+        const point_type *coords = mapped->data<point_type>(gvb::section_id(offsets_ids[k]+1));
+        std::size_t n = mapped_runs(*mapped, offsets_ids[k]);
+        runs_type runs;
+        runs.reserve(n+layer_runs[k]->size(), (n ? static_cast<std::size_t>(offsets[n]) : 0)+layer_runs[k]->coordinates.size());
+        for(std::size_t i=0; i<n; ++i)
+            runs.push_back(coords+offsets[i], static_cast<std::size_t>(offsets[i+1]-offsets[i]));
+        for(std::size_t i=0; i<layer_runs[k]->size(); ++i)
+        {
+            std::size_t nb;
+            const point_type *pts = layer_runs[k]->run(i, nb);
+            runs.push_back(pts, nb);
+        }
+        layer_runs[k]->coordinates.swap(runs.coordinates);
+        layer_runs[k]->offsets.swap(runs.offsets);
+    }
 }
 
 string simple_vector_layer::available_formats_wildcard() const
@@ -310,91 +660,140 @@ layer_settings_control* simple_vector_layer::build_layer_settings_control(unsign
 
 std::string simple_vector_layer::infos()
 {
+    std::size_t nb_mapped_circles = 0, nb_mapped_ellipses = 0, nb_mapped_arcs = 0, nb_mapped_splines = 0;
+    if(m_mapped)
+    {
+        nb_mapped_circles  = static_cast<std::size_t>(m_mapped->count(gvb::CIRCLES));
+        nb_mapped_ellipses = static_cast<std::size_t>(m_mapped->count(gvb::ELLIPSES));
+        nb_mapped_arcs     = mapped_runs(*m_mapped, gvb::ARC_OFFSETS);
+        nb_mapped_splines  = mapped_runs(*m_mapped, gvb::SPLINE_OFFSETS);
+    }
     ostringstream oss;
-    oss << m_circles.size() << " circles\n";
-    oss << m_ellipses.size() << " ellipses\n";
+    oss << m_circles.size()+nb_mapped_circles << " circles\n";
+    oss << m_ellipses.size()+nb_mapped_ellipses << " ellipses\n";
     oss << m_rotatedellipses.size() << " rotated ellipses\n";
-    oss << m_arcs.size() << " arcs\n";
-    oss << m_points.size() << " points\n";
-    oss << m_splines.size() << " splines\n";
-    oss << m_polygons.size() << " polygons\n";
+    oss << m_arc_runs.size()+nb_mapped_arcs << " arcs\n";
+    oss << num_points() << " points\n";
+    oss << m_spline_runs.size()+nb_mapped_splines << " splines\n";
+    oss << num_polygons() << " polygons\n";
+    if(m_mapped)
+        oss << "(memory mapped from " << filename() << ")\n";
     m_infos = oss.str();
     return m_infos;
 }
 
 
+namespace
+{
+    bool snap_circle(const layer_transform& t, eSNAP snap, double invzoom2, double d2[], const wxRealPoint& q, const simple_vector_layer::circle_type& circle, wxRealPoint& psnap)
+    {
+        double zoom = t.zoom_factor();
+        wxRealPoint c(circle.x,circle.y);
+        double d = squared_distance(q,c)*invzoom2;
+        if((snap&SNAP_POINT) && (d < d2[SNAP_POINT] ))
+        {
+            for(unsigned int j=0; j<SNAP_POINT; ++j) d2[j]=0;
+            d2[SNAP_POINT] = d;
+            psnap = t.from_local(c);
+            return true;
+        }
+        double radius =  std::sqrt(d)*zoom;
+        d =radius-circle.radius;
+        d = d*d*invzoom2;
+        if((snap&SNAP_LINE) && (d < d2[SNAP_LINE] ))
+        {
+            for(unsigned int j=0; j<SNAP_LINE; ++j) d2[j]=0;
+            d2[SNAP_LINE] = d;
+            psnap = t.from_local(c+(circle.radius/radius)*(q-c));
+            return true;
+        }
+        return false;
+    }
+
+    bool snap_polygon(const layer_transform& t, eSNAP snap, double invzoom2, double d2[], const wxRealPoint& q, const point_type* pts, std::size_t n, wxRealPoint& psnap)
+    {
+        bool snapped = false;
+        if(n==0) return false;
+        wxRealPoint p0(pts[n-1].x,pts[n-1].y), p1;
+        for (std::size_t j=0;j<n;++j, p0=p1)
+        {
+            p1 = wxRealPoint(pts[j].x,pts[j].y);
+            if((snap&SNAP_POINT) && snap_point(t, invzoom2, d2, q, p1, psnap )) snapped = true;
+            if((snap&SNAP_LINE ) && snap_segment(t, invzoom2, d2, q, p0, p1, psnap )) snapped = true;
+        }
+        return snapped;
+    }
+
+    bool snap_arc(const layer_transform& t, eSNAP snap, double invzoom2, double d2[], const wxRealPoint& q, const point_type* pts, std::size_t n, wxRealPoint& psnap)
+    {
+        bool snapped = false;
+        if(n==0) return false;
+        if((snap&SNAP_POINT) && snap_point(t, invzoom2, d2, q, pts[0], psnap )) snapped = true;
+        for (std::size_t j = 0; j+1 < n; ++j)
+        {
+            if((snap&SNAP_POINT) && snap_point(t, invzoom2, d2, q, pts[j+1], psnap )) snapped = true;
+            if((snap&SNAP_LINE ) && snap_segment(t, invzoom2, d2, q, pts[j], pts[j+1], psnap )) snapped = true;
+        }
+        return snapped;
+    }
+}
+
 bool simple_vector_layer::snap( eSNAP snap, double d2[], const wxRealPoint& p, wxRealPoint& psnap )
 {
+    if(!(snap&(SNAP_POINT|SNAP_LINE)))
+        return false;
+    if(m_index_dirty)
+        build_index();
+
     wxRealPoint q =  transform().to_local(p);
     double zoom = transform().zoom_factor();
     double invzoom2 = 1.0/(zoom*zoom);
     bool snapped = false;
 
-    if(snap&(SNAP_POINT|SNAP_LINE))
-    {
-        for (unsigned int i = 0; i < m_circles.size(); i++)
-        {
-            wxRealPoint c(m_circles[i].x,m_circles[i].y);
-            double d = squared_distance(q,c)*invzoom2;
-            if((snap&SNAP_POINT) && (d < d2[SNAP_POINT] ))
-            {
-                for(unsigned int j=0; j<SNAP_POINT; ++j) d2[j]=0;
-                d2[SNAP_POINT] = d;
-                psnap = transform().from_local(c);
-                snapped = true;
-            }
-            else
-            {
-                double radius =  std::sqrt(d)*zoom;
-                d =radius-m_circles[i].radius;
-                d = d*d*invzoom2;
-                if((snap&SNAP_LINE) && (d < d2[SNAP_LINE] ))
-                {
-                    for(unsigned int j=0; j<SNAP_LINE; ++j) d2[j]=0;
-                    d2[SNAP_LINE] = d;
-                    psnap = transform().from_local(c+(m_circles[i].radius/radius)*(q-c));
-                    snapped = true;
-                }
-            }
-        }
-    }
+    // Only the geometries within the tolerance window are tested
+    double d = 0.;
+    if(snap&SNAP_POINT) d = std::max(d, d2[SNAP_POINT]);
+    if(snap&SNAP_LINE ) d = std::max(d, d2[SNAP_LINE ]);
+    bbox_rtree::box window(q.x, q.y, q.x, q.y);
+    window.inflate(std::sqrt(d)*zoom);
+    std::vector<unsigned int> ids;
+    std::size_t n;
+
+    m_index[CIRCLE_INDEX].query(window, ids);
+    for (std::size_t i = 0; i < ids.size(); i++)
+        if(snap_circle(transform(), snap, invzoom2, d2, q, item(m_mapped, gvb::CIRCLES, m_circles, ids[i]), psnap)) snapped = true;
     // Ellipses alignees
-    if(!m_ellipses.empty())
+    ids.clear();
+    m_index[ELLIPSE_INDEX].query(window, ids);
+    if(!ids.empty())
     {
         wxLogMessage(wxT("snapping to ellipses not implemented in simple_vector_layer"));
     }
     // Ellipses non alignees
-    if(!m_rotatedellipses.empty())
+    ids.clear();
+    m_index[ROTATED_ELLIPSE_INDEX].query(window, ids);
+    if(!ids.empty())
     {
         wxLogMessage(wxT("snapping to rotated ellipses not implemented in simple_vector_layer"));
     }
 
-
-    if(snap&(SNAP_POINT|SNAP_LINE))
+    ids.clear();
+    m_index[POLYGON_INDEX].query(window, ids);
+    for (std::size_t i=0;i<ids.size();++i)
     {
-        for (unsigned int i=0;i<m_polygons.size();++i)
-        {
-            wxRealPoint p0(m_polygons[i].back().x,m_polygons[i].back().y), p1;
-            for (unsigned int j=0;j<m_polygons[i].size();++j, p0=p1)
-            {
-                p1 = wxRealPoint(m_polygons[i][j].x,m_polygons[i][j].y);
-                if(snap&SNAP_POINT) snapped=snapped||snap_point(transform(), invzoom2, d2, q, p1, psnap );
-                if(snap&SNAP_LINE ) snapped=snapped||snap_segment(transform(), invzoom2, d2, q, p0, p1, psnap );
-            }
-        }
-        for (unsigned int i = 0; i < m_arcs.size(); i++)
-        {
-            const arc_type &arc = m_arcs[i];
-            if(!arc.arc_points.empty() && (snap&SNAP_POINT))
-                snapped=snapped||snap_point(transform(), invzoom2, d2, q, arc.arc_points.front(), psnap );
-            for (unsigned int j = 0; j < arc.arc_points.size() - 1; ++j)
-            {
-                if(snap&SNAP_POINT) snapped=snapped||snap_point(transform(), invzoom2, d2, q, arc.arc_points[j+1], psnap );
-                if(snap&SNAP_LINE ) snapped=snapped||snap_segment(transform(), invzoom2, d2, q, arc.arc_points[j], arc.arc_points[j+1], psnap );
-            }
-        }
+        const point_type *pts = run(m_mapped, gvb::POLYGON_OFFSETS, gvb::POLYGON_COORDS, m_polygon_runs, ids[i], n);
+        if(snap_polygon(transform(), snap, invzoom2, d2, q, pts, n, psnap)) snapped = true;
+    }
+    ids.clear();
+    m_index[ARC_INDEX].query(window, ids);
+    for (std::size_t i=0;i<ids.size();++i)
+    {
+        const point_type *pts = run(m_mapped, gvb::ARC_OFFSETS, gvb::ARC_COORDS, m_arc_runs, ids[i], n);
+        if(snap_arc(transform(), snap, invzoom2, d2, q, pts, n, psnap)) snapped = true;
     }
-    if(!m_splines.empty())
+    ids.clear();
+    m_index[SPLINE_INDEX].query(window, ids);
+    if(!ids.empty())
     {
         wxLogMessage(wxT("snapping to splines not implemented in simple_vector_layer"));
     }
@@ -402,47 +801,127 @@ bool simple_vector_layer::snap( eSNAP snap, double d2[], const wxRealPoint& p, w
     // 0D
     if(snap&SNAP_POINT)
     {
-
-        for (unsigned int i = 0; i < m_points.size(); i++)
-        {
-            snapped=snapped||snap_point(transform(), invzoom2, d2, q, m_points[i], psnap );
-        }
+        ids.clear();
+        m_index[POINT_INDEX].query(window, ids);
+        for (std::size_t i = 0; i < ids.size(); i++)
+            if(snap_point(transform(), invzoom2, d2, q, item(m_mapped, gvb::POINTS, m_points, ids[i]), psnap )) snapped = true;
 
         // Text
         if(text_visibility())
         {
-            for (unsigned int i = 0; i < m_texts.size(); i++)
-            {
-                snapped=snapped||snap_point(transform(), invzoom2, d2, q, m_texts[i].first, psnap );
-            }
+            ids.clear();
+            m_index[TEXT_INDEX].query(window, ids);
+            for (std::size_t i = 0; i < ids.size(); i++)
+                if(snap_point(transform(), invzoom2, d2, q, m_texts[ids[i]].first, psnap )) snapped = true;
         }
     }
     return snapped;
 }
 
-unsigned int simple_vector_layer::num_polygons() const { return m_polygons.size(); }
+void simple_vector_layer::screen_segments( const bbox_rtree::box& window, std::vector<segment_type>& segments ) const
+{
+    if(m_index_dirty)
+        build_index();
+    bbox_rtree::box local = local_box(window);
+    std::vector<unsigned int> ids;
+    std::size_t n;
+
+    m_index[POLYGON_INDEX].query(local, ids);
+    for (std::size_t i=0;i<ids.size();++i)
+    {
+        const point_type *pts = run(m_mapped, gvb::POLYGON_OFFSETS, gvb::POLYGON_COORDS, m_polygon_runs, ids[i], n);
+        for (std::size_t j=0;j<n;++j)
+            push_screen_segment(transform(), local, pts[j>0 ? j-1 : n-1], pts[j], segments);
+    }
+    ids.clear();
+    m_index[ARC_INDEX].query(local, ids);
+    for (std::size_t i=0;i<ids.size();++i)
+    {
+        const point_type *pts = run(m_mapped, gvb::ARC_OFFSETS, gvb::ARC_COORDS, m_arc_runs, ids[i], n);
+        for (std::size_t j=0;j+1<n;++j)
+            push_screen_segment(transform(), local, pts[j], pts[j+1], segments);
+    }
+}
+
+unsigned int simple_vector_layer::num_polygons() const
+{
+    return m_polygon_runs.size() + (m_mapped ? mapped_runs(*m_mapped, gvb::POLYGON_OFFSETS) : 0);
+}
 void simple_vector_layer::get_polygon(unsigned int i, std::vector<double> &x , std::vector<double> &y ) const
 {
-    for(unsigned int j=0; j<m_polygons[i].size(); ++j)
+    if(m_mapped)
     {
-        x.push_back(m_polygons[i][j].x);
-        y.push_back(m_polygons[i][j].y);
+        const std::size_t n = mapped_runs(*m_mapped, gvb::POLYGON_OFFSETS);
+        if(i<n)
+        {
+            const boost::uint64_t *offsets = m_mapped->data<boost::uint64_t>(gvb::POLYGON_OFFSETS);
+            const point_type *coords = m_mapped->data<point_type>(gvb::POLYGON_COORDS);
+            for(boost::uint64_t j=offsets[i]; j<offsets[i+1]; ++j)
+            {
+                x.push_back(coords[j].x);
+                y.push_back(coords[j].y);
+            }
+            return;
+        }
+        i -= n;
+    }
+    std::size_t n;
+    const point_type *pts = m_polygon_runs.run(i, n);
+    for(std::size_t j=0; j<n; ++j)
+    {
+        x.push_back(pts[j].x);
+        y.push_back(pts[j].y);
     }
 }
 
 
-unsigned int simple_vector_layer::num_points() const { return m_points.size(); }
+unsigned int simple_vector_layer::num_points() const
+{
+    return m_points.size() + (m_mapped ? static_cast<std::size_t>(m_mapped->count(gvb::POINTS)) : 0);
+}
 void simple_vector_layer::get_point(unsigned int i, double &x , double &y ) const
 {
+    if(m_mapped)
+    {
+        const std::size_t n = static_cast<std::size_t>(m_mapped->count(gvb::POINTS));
+        if(i<n)
+        {
+            x = m_mapped->data<point_type>(gvb::POINTS)[i].x;
+            y = m_mapped->data<point_type>(gvb::POINTS)[i].y;
+            return;
+        }
+        i -= n;
+    }
     x = m_points[i].x;
     y = m_points[i].y;
 }
-unsigned int simple_vector_layer::num_polylines() const { return m_arcs.size(); }
+unsigned int simple_vector_layer::num_polylines() const
+{
+    return m_arc_runs.size() + (m_mapped ? mapped_runs(*m_mapped, gvb::ARC_OFFSETS) : 0);
+}
 void simple_vector_layer::get_polyline(unsigned int i, std::vector<double> &x , std::vector<double> &y ) const
 {
-    for(unsigned int j=0; j<m_arcs[i].arc_points.size(); ++j)
+    if(m_mapped)
+    {
+        const std::size_t n = mapped_runs(*m_mapped, gvb::ARC_OFFSETS);
+        if(i<n)
+        {
+            const boost::uint64_t *offsets = m_mapped->data<boost::uint64_t>(gvb::ARC_OFFSETS);
+            const point_type *coords = m_mapped->data<point_type>(gvb::ARC_COORDS);
+            for(boost::uint64_t j=offsets[i]; j<offsets[i+1]; ++j)
+            {
+                x.push_back(coords[j].x);
+                y.push_back(coords[j].y);
+            }
+            return;
+        }
+        i -= n;
+    }
+    std::size_t n;
+    const point_type *pts = m_arc_runs.run(i, n);
+    for(std::size_t j=0; j<n; ++j)
     {
-        x.push_back(m_arcs[i].arc_points[j].x);
-        y.push_back(m_arcs[i].arc_points[j].y);
+        x.push_back(pts[j].x);
+        y.push_back(pts[j].y);
     }
 }
@@ -40,8 +40,15 @@ Authors:
 #define __SIMPLE_VECTOR_LAYER_HPP__
 
 #include "vector_layer.hpp"
+#include "../tools/level_of_detail.hpp"
 
+#include <boost/shared_ptr.hpp>
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/split_member.hpp>
+
+#include <algorithm>
+
+class gvb_mapped_file;
 
 namespace boost { namespace serialization {
 
@@ -57,6 +64,9 @@ void serialize(Archive & ar, wxPoint & p, const unsigned int version)
 
 class simple_vector_layer: public vector_layer
 {
+    // The native format reader maps its data directly into the layer
+    friend class gilviewer_file_io_gvb;
+
 public:
 
     struct circle_type
@@ -127,16 +137,67 @@ public:
     typedef std::vector<point_type> polygon_type;
     typedef std::pair< point_type, std::string > text_type ;
 
+    /// Runs of coordinates (arcs, splines or polygons) stored one after the other in a single buffer
+    struct runs_type
+    {
+        runs_type() : offsets(1, 0) {}
+
+        std::size_t size() const { return offsets.size()-1; }
+        /// Coordinates of the run i, n receives their number
+        const point_type* run(std::size_t i, std::size_t& n) const
+        {
+            n = offsets[i+1]-offsets[i];
+            return n ? &coordinates[offsets[i]] : 0;
+        }
+        void push_back(const point_type* pts, std::size_t n)
+        {
+            coordinates.insert(coordinates.end(), pts, pts+n);
+            offsets.push_back(static_cast<unsigned int>(coordinates.size()));
+        }
+        void push_back(const double* x, const double* y, std::size_t n)
+        {
+            point_type pt;
+            for(std::size_t i=0;i<n;++i)
+            {
+                pt.x=x[i]; pt.y=y[i];
+                coordinates.push_back(pt);
+            }
+            offsets.push_back(static_cast<unsigned int>(coordinates.size()));
+        }
+        /// Reserves room for nb_runs more runs and nb_coordinates more coordinates
+        void reserve(std::size_t nb_runs, std::size_t nb_coordinates)
+        {
+            grow(offsets, nb_runs);
+            grow(coordinates, nb_coordinates);
+        }
+        /// Reserves room for n more elements, without losing the geometric growth of push_back over successive calls
+        template<class T>
+        static void grow(std::vector<T>& v, std::size_t n)
+        {
+            if(v.size()+n > v.capacity())
+                v.reserve(std::max(v.size()+n, 2*v.capacity()));
+        }
+        std::size_t memory() const { return coordinates.capacity()*sizeof(point_type) + offsets.capacity()*sizeof(unsigned int); }
+        void clear()
+        {
+            std::vector<point_type>().swap(coordinates);
+            std::vector<unsigned int>(1, 0).swap(offsets);
+        }
+
+        std::vector<point_type> coordinates;
+        /// Index of the first coordinate of each run, followed by the number of coordinates
+        std::vector<unsigned int> offsets;
+    };
+
     simple_vector_layer(const std::string& layer_name="default layer name");
-    virtual ~simple_vector_layer() {}
+    virtual ~simple_vector_layer() { stop_lod(); }
 
-    virtual void draw(wxDC &dc, wxCoord x, wxCoord y, bool transparent) const;
-    virtual void update(int, int) {}
 
     virtual layer_settings_control* build_layer_settings_control(unsigned int index, layer_control* parent);
     virtual std::string infos();
 
     virtual bool snap( eSNAP snap, double d2[], const wxRealPoint& p, wxRealPoint& psnap );
+    virtual void screen_segments( const bbox_rtree::box& window, std::vector<segment_type>& segments ) const;
 
     virtual std::string available_formats_wildcard() const;
 
@@ -150,6 +211,11 @@ public:
     void add_polygon( const std::vector<double> &x , const std::vector<double> &y );
     void add_text( double x , double y , const std::string &text , const wxColour &color = *wxRED );
 
+    /// Bulk appends (see layer::add_polygons). The spatial indices are rebuilt in bulk on the next draw.
+    virtual void add_points( const double *x , const double *y , std::size_t n );
+    virtual void add_polylines( const double *x , const double *y , const std::size_t *offsets , std::size_t n );
+    virtual void add_polygons( const double *x , const double *y , const std::size_t *offsets , std::size_t n );
+
     /// Accessors
     virtual unsigned int num_polygons() const;
     virtual void get_polygon(unsigned int i, std::vector<double> &x , std::vector<double> &y ) const;
@@ -160,10 +226,22 @@ public:
 
     virtual void clear();
 
+    /// Geometries, levels of detail and cached raster (the memory mapped ".gvb" files are not counted)
+    virtual std::size_t memory_size() const;
+
+    /// Copies the geometries drawn from a memory mapped ".gvb" file into the layer own containers and releases the mapping
+    void unmap();
+
+    // The runs are archived as one vector of points per run, so that the archives are unchanged
     template<class Archive>
-    void serialize(Archive & ar, const unsigned int version)
+    void save(Archive & ar, const unsigned int version) const
     {
-        // note, version is always the latest when saving
+        std::vector<arc_type> m_arcs;
+        std::vector<spline_type> m_splines;
+        std::vector<polygon_type> m_polygons;
+        from_runs(m_arc_runs, m_arcs);
+        from_runs(m_spline_runs, m_splines);
+        from_runs(m_polygon_runs, m_polygons);
         ar & BOOST_SERIALIZATION_NVP(m_circles)
            & BOOST_SERIALIZATION_NVP(m_ellipses)
            & BOOST_SERIALIZATION_NVP(m_rotatedellipses)
@@ -173,15 +251,107 @@ public:
            & BOOST_SERIALIZATION_NVP(m_polygons);
     }
 
+    template<class Archive>
+    void load(Archive & ar, const unsigned int version)
+    {
+        reset_lod();
+        invalidate_cache();
+        content_changed();
+        m_index_dirty = true;
+        std::vector<arc_type> m_arcs;
+        std::vector<spline_type> m_splines;
+        std::vector<polygon_type> m_polygons;
+        ar & BOOST_SERIALIZATION_NVP(m_circles)
+           & BOOST_SERIALIZATION_NVP(m_ellipses)
+           & BOOST_SERIALIZATION_NVP(m_rotatedellipses)
+           & BOOST_SERIALIZATION_NVP(m_arcs)
+           & BOOST_SERIALIZATION_NVP(m_points)
+           & BOOST_SERIALIZATION_NVP(m_splines)
+           & BOOST_SERIALIZATION_NVP(m_polygons);
+        to_runs(m_arcs, m_arc_runs);
+        to_runs(m_splines, m_spline_runs);
+        to_runs(m_polygons, m_polygon_runs);
+    }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+protected:
+    virtual void draw_geometries(wxDC &dc) const;
+    virtual void draw_texts(wxDC &dc) const;
+
 private:
+    /// One spatial index per kind of geometry. Identifiers index the mapped geometries first, then the containers below.
+    enum index_kind
+    {
+        CIRCLE_INDEX = 0,
+        ELLIPSE_INDEX,
+        ROTATED_ELLIPSE_INDEX,
+        POLYGON_INDEX,
+        ARC_INDEX,
+        SPLINE_INDEX,
+        POINT_INDEX,
+        TEXT_INDEX,
+        NB_INDICES
+    };
+    std::size_t index_size(index_kind kind) const;
+    bbox_rtree::box bounding_box(index_kind kind, std::size_t i) const;
+    /// Bulk loads all the spatial indices
+    void build_index() const;
+    /// Inserts the last geometry of a kind in its spatial index
+    void index_last(index_kind kind);
+    /// Identifiers of the geometries of a kind intersecting the viewport, in drawing order
+    void visible(index_kind kind, const bbox_rtree::box& viewport, std::vector<unsigned int>& ids) const;
+
+    static const std::vector<point_type>& points_of(const arc_type& a) { return a.arc_points; }
+    static const std::vector<point_type>& points_of(const std::vector<point_type>& a) { return a; }
+    static std::vector<point_type>& points_of(arc_type& a) { return a.arc_points; }
+    static std::vector<point_type>& points_of(std::vector<point_type>& a) { return a; }
+    template<class Run>
+    static void to_runs(const std::vector<Run>& v, runs_type& runs)
+    {
+        runs.clear();
+        for(std::size_t i=0;i<v.size();++i)
+        {
+            const std::vector<point_type>& pts = points_of(v[i]);
+            runs.push_back(pts.empty() ? 0 : &pts.front(), pts.size());
+        }
+    }
+    template<class Run>
+    static void from_runs(const runs_type& runs, std::vector<Run>& v)
+    {
+        v.resize(runs.size());
+        for(std::size_t i=0;i<v.size();++i)
+        {
+            std::size_t n;
+            const point_type *pts = runs.run(i, n);
+            points_of(v[i]).assign(pts, pts+n);
+        }
+    }
+
+    virtual void build_lod() const;
+    /// Interrupts the computation of the levels of detail and drops them. Must be called before the arcs or the polygons are modified.
+    void reset_lod();
+
     std::vector<circle_type> m_circles;
     std::vector<ellipse_type> m_ellipses;
     std::vector<rotated_ellipse_type> m_rotatedellipses;
-    std::vector<arc_type> m_arcs;
     std::vector<point_type> m_points;
-    std::vector<spline_type> m_splines;
-    std::vector<polygon_type> m_polygons;
+    runs_type m_arc_runs;
+    runs_type m_spline_runs;
+    runs_type m_polygon_runs;
     std::vector<text_type> m_texts;
+    /// Read only geometries of a ".gvb" file, drawn in addition to the containers above
+    boost::shared_ptr<const gvb_mapped_file> m_mapped;
+
+    mutable bbox_rtree m_index[NB_INDICES];
+    /// The indices are rebuilt in bulk on the next draw (after a load or a clear)
+    mutable bool m_index_dirty;
+
+    struct lod_type
+    {
+        level_of_detail<point_type> polygons, arcs;
+    };
+    /// Simplified polygons and arcs (in index order), drawn when zoomed out
+    mutable boost::shared_ptr<const lod_type> m_lod;
 };
 
 #endif /* __SIMPLE_VECTOR_LAYER_HPP__ */
@@ -36,11 +36,22 @@ Authors:
 
 ***********************************************************************/
 
+#include <wx/dc.h>
+#include <wx/dcmemory.h>
+#include <wx/bitmap.h>
+#include <wx/brush.h>
+#include <wx/image.h>
+
+#include <boost/thread/thread.hpp>
+
 #include "vector_layer.hpp"
 #include "../convenient/utils.hpp"
 
 #include "../config/config.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <new>
 #include <sstream>
 
 using namespace std;
@@ -73,3 +84,229 @@ void vector_layer::clear()
     vector<pair<double,double> >().swap(m_text_coordinates);
     vector<string              >().swap(m_text_value      );
 }
+
+std::size_t vector_layer::memory_size() const
+{
+    // Colour and mask
+    return m_cache ? 4*m_cache->GetWidth()*m_cache->GetHeight() : 0;
+}
+
+wxColour vector_layer::mask_colour() const
+{
+    std::vector<wxColour> used;
+    used.push_back(m_point_color);
+    used.push_back(m_line_color);
+    used.push_back(m_polygon_border_color);
+    used.push_back(m_polygon_inner_color);
+    const std::vector<unsigned char>& lut = m_density_lut->get_data();
+    for(std::size_t i=0; i+512<lut.size() && i<256; ++i)
+        used.push_back(wxColour(lut[i], lut[i+256], lut[i+512]));
+    // At most used.size() candidates are rejected
+    for(unsigned int k=0; ; ++k)
+    {
+        wxColour c((k*37+1)%256, (k*91+2)%256, (k*53+3)%256);
+        if(std::find(used.begin(), used.end(), c)==used.end())
+            return c;
+    }
+}
+
+void vector_layer::release_memory()
+{
+    m_cache.reset();
+    m_cache_valid = false;
+}
+
+void vector_layer::draw(wxDC &dc, wxCoord x, wxCoord y, bool transparent) const
+{
+    touch();
+    wxSize size = dc.GetSize();
+    double zoom = transform().zoom_factor();
+    if(m_cache && m_cache_valid && zoom==m_cache_zoom && size==m_cache_size)
+    {
+        // Offset of the view since the cache was rendered. The transform must have followed it: the view may also be
+        // moved without offset (and without update), the cache is then rendered again.
+        wxCoord ox = x-m_cache_x, oy = y-m_cache_y;
+        double dx = (transform().translation_x()-m_cache_translation_x)/zoom;
+        double dy = (transform().translation_y()-m_cache_translation_y)/zoom;
+        if(std::abs(ox)<=m_cache_margin && std::abs(oy)<=m_cache_margin && std::abs(dx-ox)<1. && std::abs(dy-oy)<1.)
+        {
+            dc.DrawBitmap(*m_cache, ox-m_cache_margin, oy-m_cache_margin, transparent);
+            if(text_visibility())
+                draw_texts(dc);
+            return;
+        }
+    }
+
+    // The pens and brushes of a wxDC are not antialiased: the geometries never blend with the mask colour
+    const wxColour mask = mask_colour();
+    m_cache.reset(new wxBitmap(size.GetWidth()+2*m_cache_margin, size.GetHeight()+2*m_cache_margin));
+    {
+        wxMemoryDC mdc;
+        mdc.SelectObject(*m_cache);
+        mdc.SetBackground(wxBrush(mask));
+        mdc.Clear();
+        mdc.SetDeviceOrigin(m_cache_margin, m_cache_margin);
+        draw_geometries(mdc);
+        mdc.SelectObject(wxNullBitmap);
+    }
+    m_cache->SetMask(new wxMask(*m_cache, mask));
+    m_cache_valid = true;
+    m_cache_size = size;
+    m_cache_zoom = zoom;
+    m_cache_translation_x = transform().translation_x();
+    m_cache_translation_y = transform().translation_y();
+    m_cache_x = x;
+    m_cache_y = y;
+    dc.DrawBitmap(*m_cache, -m_cache_margin, -m_cache_margin, transparent);
+    if(text_visibility())
+        draw_texts(dc);
+}
+
+namespace
+{
+    // Counts the points visited by bbox_rtree::aggregate in a grid of screen cells, and keeps the first point of each cell
+    struct cell_accumulator
+    {
+        const layer_transform& transform;
+        double x0, y0, cell;
+        int width, height;
+        std::vector<unsigned int>& counts;
+        std::vector<wxPoint>& representatives;
+
+        void operator()(double x, double y, unsigned int count)
+        {
+            wxRealPoint p = transform.from_local(x,y);
+            int i = static_cast<int>(std::floor((p.x-x0)/cell));
+            int j = static_cast<int>(std::floor((p.y-y0)/cell));
+            if(i<0 || j<0 || i>=width || j>=height)
+                return;
+            std::size_t k = static_cast<std::size_t>(j)*width+i;
+            if(counts[k]==0)
+                representatives[k] = wxPoint(static_cast<int>(std::floor(p.x+0.5)), static_cast<int>(std::floor(p.y+0.5)));
+            counts[k] += count;
+        }
+    };
+}
+
+bool vector_layer::draw_points(wxDC &dc, const std::vector<const bbox_rtree*>& indices) const
+{
+    if(m_point_rendering!=POINTS_PER_CELL && m_point_rendering!=POINTS_DENSITY)
+        return false;
+
+    int cell = std::max(1, static_cast<int>(m_point_cell_size));
+    wxSize size = dc.GetSize();
+    wxCoord x0 = dc.DeviceToLogicalX(0), y0 = dc.DeviceToLogicalY(0);
+    int width = (size.GetWidth()+cell-1)/cell, height = (size.GetHeight()+cell-1)/cell;
+    if(width<=0 || height<=0)
+        return true;
+
+    std::vector<unsigned int> counts(static_cast<std::size_t>(width)*height, 0);
+    std::vector<wxPoint> representatives(counts.size());
+    cell_accumulator accumulator = { transform(), static_cast<double>(x0), static_cast<double>(y0), static_cast<double>(cell), width, height, counts, representatives };
+    bbox_rtree::box viewport = local_viewport(dc, 0);
+    double resolution = cell*std::abs(transform().zoom_factor());
+    for(std::size_t i=0;i<indices.size();++i)
+        indices[i]->aggregate(viewport, resolution, accumulator);
+
+    if(m_point_rendering==POINTS_PER_CELL)
+    {
+        for(std::size_t k=0;k<counts.size();++k)
+            if(counts[k])
+                dc.DrawPoint(representatives[k]);
+        return true;
+    }
+
+    // Density map: logarithm of the count of each cell through the LUT, empty cells are transparent
+    unsigned int max_count = *std::max_element(counts.begin(), counts.end());
+    if(max_count==0)
+        return true;
+    const std::vector<unsigned char>& lut = m_density_lut->get_data();
+    int w = width*cell, h = height*cell;
+    std::vector<unsigned char> rgb(3*static_cast<std::size_t>(w)*h, 0), alpha(static_cast<std::size_t>(w)*h, 0);
+    double scale = 255./std::log(1.+max_count);
+    for(int j=0;j<height;++j)
+        for(int i=0;i<width;++i)
+        {
+            unsigned int c = counts[static_cast<std::size_t>(j)*width+i];
+            if(c==0)
+                continue;
+            unsigned int v = std::min(255u, static_cast<unsigned int>(std::log(1.+c)*scale));
+            for(int y=j*cell;y<(j+1)*cell;++y)
+                for(int x=i*cell;x<(i+1)*cell;++x)
+                {
+                    std::size_t p = static_cast<std::size_t>(y)*w+x;
+                    rgb[3*p  ] = lut[v    ];
+                    rgb[3*p+1] = lut[v+256];
+                    rgb[3*p+2] = lut[v+512];
+                    alpha[p] = 255;
+                }
+        }
+    wxImage image(w, h, &rgb.front(), true);
+    image.SetAlpha(&alpha.front(), true);
+    dc.DrawBitmap(wxBitmap(image), x0, y0, true);
+    return true;
+}
+
+bbox_rtree::box vector_layer::local_viewport(const wxDC &dc, double margin) const
+{
+    // The device origin is shifted when rendering the cache with its margin
+    wxSize size = dc.GetSize();
+    double x0 = dc.DeviceToLogicalX(0), y0 = dc.DeviceToLogicalY(0);
+    double x1 = dc.DeviceToLogicalX(size.GetWidth()), y1 = dc.DeviceToLogicalY(size.GetHeight());
+    return local_box(bbox_rtree::box(x0-margin, y0-margin, x1+margin, y1+margin));
+}
+
+bbox_rtree::box vector_layer::local_box(const bbox_rtree::box& screen) const
+{
+    bbox_rtree::box local;
+    wxRealPoint p = transform().to_local(screen.min_x,screen.min_y); local.expand(p.x,p.y);
+    p = transform().to_local(screen.max_x,screen.min_y); local.expand(p.x,p.y);
+    p = transform().to_local(screen.min_x,screen.max_y); local.expand(p.x,p.y);
+    p = transform().to_local(screen.max_x,screen.max_y); local.expand(p.x,p.y);
+    return local;
+}
+
+void vector_layer::update_lod() const
+{
+    if(!m_lod_dirty)
+        return;
+    m_lod_dirty = false;
+    stop_lod();
+    m_lod_thread.reset(new boost::thread(boost::bind(&vector_layer::lod_thread, this)));
+}
+
+void vector_layer::invalidate_lod()
+{
+    stop_lod();
+    m_lod_dirty = true;
+}
+
+void vector_layer::stop_lod() const
+{
+    if(!m_lod_thread)
+        return;
+    m_lod_thread->interrupt();
+    m_lod_thread->join();
+    m_lod_thread.reset();
+}
+
+void vector_layer::wait_lod() const
+{
+    update_lod();
+    if(!m_lod_thread)
+        return;
+    m_lod_thread->join();
+    m_lod_thread.reset();
+}
+
+void vector_layer::lod_thread() const
+{
+    try
+    {
+        build_lod();
+    }
+    catch(const std::bad_alloc&)
+    {
+        // Not enough memory for the simplified geometries: the layer is drawn with its full geometries
+    }
+}
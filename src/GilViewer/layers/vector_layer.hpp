@@ -43,23 +43,44 @@ Authors:
 	#pragma warning(disable : 4275)
 #endif
 #include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "../layers/layer.hpp"
+#include "../tools/bbox_rtree.hpp"
+#include "../tools/color_lookup_table.hpp"
+#include "label_engine.hpp"
+
+namespace boost { class thread; }
+class wxBitmap;
 
 class vector_layer : public layer
 {
 public:
-    virtual ~vector_layer() {}
+    virtual ~vector_layer() { stop_lod(); }
     /// Cette methode recupere les donnees d'affichage par defaut dans les parametres et les affecte au nouveau calque
     virtual void default_display_parameters();
 
-    // Abstract interface
-    virtual void draw(wxDC &dc, wxCoord x, wxCoord y, bool transparent) const {}
-    virtual void update(int width, int height) {}
+    /// Draws the geometries through a cached raster, then the texts. As for the image layers, (x,y) is the offset of the
+    /// view since the last update (while panning), and transparent tells whether the background of the raster is drawn.
+    /// The raster is rendered once, on a mask colour which no style uses (see mask_colour). The texts are antialiased:
+    /// they are drawn directly, each through the bitmap cached by the label engine.
+    /// While panning, the raster is only shifted: it is rendered again when the view leaves its margin, when the zoom
+    /// changes, when the transform is moved by another offset than (x,y), or after update.
+    virtual void draw(wxDC &dc, wxCoord x, wxCoord y, bool transparent) const;
+    /// Invalidates the cached raster (zoom, resize, change of style or end of a pan)
+    virtual void update(int width, int height) { invalidate_cache(); update_lod(); }
+
+    /// Bytes of the cached raster. The derived classes add their geometries.
+    virtual std::size_t memory_size() const;
+    /// Releases the cached raster, rendered again by the next draw
+    virtual void release_memory();
 
     // Accessors
     virtual std::string layer_type_as_string() const {return "Vector";}
     virtual bool saveable() const {return true;}
+    /// LUT of the density map of the points (see point_rendering)
+    virtual boost::shared_ptr<color_lookup_table> colorlookuptable() { return m_density_lut; }
 
     // TODO
     virtual void text_visibility( bool value , bool update = true ) { m_is_text_visible = value; if (update) notifyLayerSettingsControl_(); }
@@ -67,8 +88,23 @@ public:
 
     virtual void clear();
 
+    /// Computes the levels of detail now and waits for them: the next draw does not depend on the background thread
+    /// (offscreen rendering, regression tests)
+    void wait_lod() const;
+
+    /// The accessors below give all the polygons, polylines, lines and points of the layer (see offscreen_renderer)
+    virtual bool geometry_accessors() const { return true; }
+
     virtual unsigned int num_polygons() const { return 0; }
+    /// Exterior ring of the (first part of the) polygon
     virtual void get_polygon(unsigned int i, std::vector<double> &x , std::vector<double> &y ) const {}
+    /// All the rings of the polygon, holes and parts included, to be filled together with the even-odd rule.
+    /// The coordinates are appended to x and y, and the end of each ring in x and y is appended to ring_ends.
+    virtual void get_polygon_rings(unsigned int i, std::vector<double> &x , std::vector<double> &y , std::vector<std::size_t> &ring_ends ) const
+    {
+        get_polygon(i,x,y);
+        ring_ends.push_back(x.size());
+    }
 
     virtual unsigned int num_points() const { return 0; }
     virtual void get_point(unsigned int i, double &x , double &y ) const {}
@@ -85,10 +121,78 @@ private:
     std::vector< std::pair<double,double> > m_text_coordinates;
     std::vector< std::string > m_text_value;
 
+    void lod_thread() const;
+    mutable boost::shared_ptr<boost::thread> m_lod_thread;
+    mutable bool m_lod_dirty;
+
+    /// Colour of the background of the cached raster, different from the colours of the styles and of the density LUT
+    wxColour mask_colour() const;
+
+    /// Masked raster of the geometries, rendered with a margin of m_cache_margin pixels around the view
+    mutable boost::shared_ptr<wxBitmap> m_cache;
+    mutable bool m_cache_valid;
+    mutable wxSize m_cache_size;
+    /// Transform and view offset used to render the cache
+    mutable double m_cache_zoom, m_cache_translation_x, m_cache_translation_y;
+    mutable wxCoord m_cache_x, m_cache_y;
+    int m_cache_margin;
+
+    boost::shared_ptr<color_lookup_table> m_density_lut;
+
 protected:
+    /// Area of the device context in local coordinates, grown by margin pixels on each side (used for view culling)
+    bbox_rtree::box local_viewport(const wxDC &dc, double margin) const;
+    /// Bounding box, in local coordinates, of a box given in screen coordinates
+    bbox_rtree::box local_box(const bbox_rtree::box& screen) const;
+
+    /// Draws the points of the indices (in local coordinates) according to point_rendering(), with the current pen.
+    /// The points are counted in a grid of point_cell_size() pixels through bbox_rtree::aggregate, so that the cost depends
+    /// on the size of the view, not on the number of points. Returns false for POINTS_ALL: the caller then draws each point.
+    bool draw_points(wxDC &dc, const std::vector<const bbox_rtree*>& indices) const;
+    bool draw_points(wxDC &dc, const bbox_rtree& index) const { return draw_points(dc, std::vector<const bbox_rtree*>(1, &index)); }
+
+    /// Texts of the derived classes, drawn without overlap. Must be cleared with the texts.
+    mutable label_engine m_label_engine;
+
+    /// Draws the geometries at the screen coordinates given by transform(), without the texts
+    virtual void draw_geometries(wxDC &dc) const {}
+    /// Draws the texts at the screen coordinates given by transform(), when they are visible (see text_visibility)
+    virtual void draw_texts(wxDC &dc) const {}
+    /// The cached raster must be rendered again before the next draw (the geometries have changed)
+    void invalidate_cache() { m_cache_valid = false; }
+
+    /// Levels of detail (see level_of_detail.hpp) are computed by build_lod in a background thread, started by the first update or draw after invalidate_lod
+    void update_lod() const;
+    /// Interrupts the computation of the levels of detail and schedules a new one. Must be called before the geometries are modified.
+    /// Only waits if a computation is running, for its next interruption point: successive additions between two updates wait at most once.
+    void invalidate_lod();
+    /// Interrupts and waits for the computation of the levels of detail. Must be called by the destructors of the derived classes.
+    void stop_lod() const;
+    /// Computes and publishes (under m_lod_mutex) the levels of detail. Runs in a background thread and only reads the geometries.
+    virtual void build_lod() const {}
+    mutable boost::mutex m_lod_mutex;
+
     vector_layer(): m_is_text_visible(true)
             , m_text_coordinates(std::vector< std::pair<double,double> >())
-            , m_text_value(std::vector< std::string >()) {}
+            , m_text_value(std::vector< std::string >())
+            , m_lod_dirty(false)
+            , m_cache_valid(false), m_cache_size(0,0)
+            , m_cache_zoom(1.), m_cache_translation_x(0.), m_cache_translation_y(0.)
+            , m_cache_x(0), m_cache_y(0)
+            , m_cache_margin(256)
+            , m_density_lut(new color_lookup_table) { m_density_lut->create_heat(); }
+    /// Copies the texts and the display parameters. The background thread and the cached raster are not shared with the copy.
+    vector_layer(const vector_layer& l): layer(l)
+            , m_is_text_visible(l.m_is_text_visible)
+            , m_text_coordinates(l.m_text_coordinates)
+            , m_text_value(l.m_text_value)
+            , m_lod_dirty(l.m_lod_dirty || l.m_lod_thread)
+            , m_cache_valid(false), m_cache_size(0,0)
+            , m_cache_zoom(1.), m_cache_translation_x(0.), m_cache_translation_y(0.)
+            , m_cache_x(0), m_cache_y(0)
+            , m_cache_margin(l.m_cache_margin)
+            , m_density_lut(new color_lookup_table(*l.m_density_lut))
+            , m_label_engine() {}
 };
 
 
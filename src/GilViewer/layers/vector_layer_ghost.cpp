@@ -58,6 +58,7 @@ struct vlg_drawer : public boost::static_visitor<void>
     wxDC &m_dc;
     wxCoord m_x, m_y;
     bool m_transparent;
+    mutable std::vector<wxPoint> m_points;
 
     void operator()(const vector_layer_ghost::Nothing&) const {}
     void operator()(const vector_layer_ghost::Point& p) const
@@ -86,16 +87,24 @@ struct vlg_drawer : public boost::static_visitor<void>
     {
         if(l.empty()) return;
         m_dc.SetPen(m_layer.m_penLine);
-        for (unsigned int i=0;i<l.size()-1;++i)
-            m_dc.DrawLine(m_layer.transform().from_local_int(l[i]),m_layer.transform().from_local_int(l[i+1]));
+        draw_lines(l, false);
     }
     void operator()(const vector_layer_ghost::Polygon& p) const
     {
         if(p.empty()) return;
         m_dc.SetPen(m_layer.m_penLine);
-        for (unsigned int i=0;i<p.size()-1;++i)
-            m_dc.DrawLine(m_layer.transform().from_local_int(p[i]),m_layer.transform().from_local_int(p[i+1]));
-        m_dc.DrawLine(m_layer.transform().from_local_int(p.back()),m_layer.transform().from_local_int(p.front()));
+        draw_lines(p, true);
+    }
+
+    // Draws the outline with a single call, closed by the first point for polygons
+    void draw_lines(const std::vector<vector_layer_ghost::Point>& l, bool closed) const
+    {
+        m_points.resize(l.size()+(closed?1:0));
+        for (unsigned int i=0;i<l.size();++i)
+            m_points[i] = m_layer.transform().from_local_int(l[i]);
+        if(closed) m_points.back() = m_points.front();
+        if(m_points.size()<2) return;
+        m_dc.DrawLines(static_cast<int>(m_points.size()),&m_points.front());
     }
 };
 
@@ -8,6 +8,7 @@ using namespace boost::filesystem;
 using namespace std;
 
 #include "GilViewer/plugins/plugin_base.hpp"
+#include "GilViewer/tools/profiler.hpp"
 IMPLEMENT_PLUGIN(gilviewer_file_io_exr)
 
 namespace ign{ namespace imageio
@@ -129,6 +130,7 @@ struct image_copier : public boost::static_visitor<layer::ptrLayerType>
 
 shared_ptr<layer> gilviewer_file_io_exr::load(const string &filename, const ptrdiff_t top_left_x, const ptrdiff_t top_left_y, const ptrdiff_t dim_x, const ptrdiff_t dim_y)
 {
+    profiler::scoped_timer timer(profiler::LOAD, filename);
 
     int width=0, height=0;
     ReadEXRHeader(filename, width, height);
@@ -7,6 +7,7 @@
 #include "GilViewer/convenient/utils.hpp"
 #include "GilViewer/layers/image_layer.hpp"
 #include "GilViewer/layers/image_types.hpp"
+#include "GilViewer/tools/profiler.hpp"
 
 #include "gdal_priv.h"
 #include <iostream>
@@ -21,6 +22,7 @@ using namespace std;
 
 shared_ptr<layer> gilviewer_file_io_gdal_jp2::load(const string &filename, const ptrdiff_t top_left_x, const ptrdiff_t top_left_y, const ptrdiff_t dim_x, const ptrdiff_t dim_y)
 {
+    profiler::scoped_timer timer(profiler::LOAD, filename);
     static bool passer=false;
     if(!passer)
         GDALAllRegister();
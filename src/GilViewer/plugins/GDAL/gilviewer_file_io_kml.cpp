@@ -1,6 +1,5 @@
 #include "gilviewer_file_io_kml.hpp"
 
-#include <boost/variant/get.hpp>
 
 #include <gdal/ogrsf_frmts.h>
 
@@ -39,116 +38,21 @@ void gilviewer_file_io_kml::save(shared_ptr<layer> layer, const string &filename
     if( poLayer == NULL )
         throw ios_base::failure("Creation of layer failed.\n");
 
-    std::vector<std::pair<geometry_types,OGRFeature*> > geometries = ogr_layer->geometries_features();
-    typedef std::vector<std::pair<geometry_types,OGRFeature*> >::const_iterator const_iterator;
-    const_iterator itb=geometries.begin(), ite=geometries.end();
-    for(;itb!=ite;++itb)
+    const ogr_attribute_table& attributes = ogr_layer->attributes();
+    attributes.create_fields(poLayer);
+    const ogr_flat_geometries& geometries = ogr_layer->geometries();
+    for(std::size_t i=0;i<geometries.size();++i)
     {
         OGRFeature *poFeature = OGRFeature::CreateFeature( poLayer->GetLayerDefn() );
-        // --------- Point --------- //
+        poFeature->SetGeometryDirectly(geometries.build_ogr_geometry(i));
+        if(i<attributes.size())
+            attributes.fill(i, poFeature);
+        OGRErr err = poLayer->CreateFeature( poFeature );
+        OGRFeature::DestroyFeature( poFeature );
+        if( err != OGRERR_NONE )
         {
-            try
-            {
-                OGRPoint *poPoint = boost::get<OGRPoint*>(itb->first);
-                poFeature->SetGeometry(poPoint);
-                if( poLayer->CreateFeature( poFeature ) != OGRERR_NONE )
-                    throw invalid_argument("Failed to create feature in shapefile.\n");
-                OGRFeature::DestroyFeature( poFeature );
-                continue;
-            }
-            catch(const bad_get& e)
-            {
-            }
-        }
-        // --------- MultiPoint --------- //
-        {
-            try
-            {
-                OGRMultiPoint *poMPoint = boost::get<OGRMultiPoint*>(itb->first);
-                poFeature->SetGeometry(poMPoint);
-                if( poLayer->CreateFeature( poFeature ) != OGRERR_NONE )
-                    throw invalid_argument("Failed to create feature in shapefile.\n");
-                OGRFeature::DestroyFeature( poFeature );
-                continue;
-            }
-            catch(const bad_get& e)
-            {
-            }
-        }
-        // --------- Polygon --------- //
-        {
-            try
-            {
-                OGRPolygon *poPolygon = boost::get<OGRPolygon*>(itb->first);
-                poFeature->SetGeometry(poPolygon);
-                if( poLayer->CreateFeature( poFeature ) != OGRERR_NONE )
-                    throw invalid_argument("Failed to create feature in shapefile.\n");
-                OGRFeature::DestroyFeature( poFeature );
-                continue;
-            }
-            catch(const bad_get& e)
-            {
-            }
-        }
-        // --------- MultiPolygon --------- //
-        {
-            try
-            {
-                OGRMultiPolygon *poMPolygon = boost::get<OGRMultiPolygon*>(itb->first);
-                poFeature->SetGeometry(poMPolygon);
-                if( poLayer->CreateFeature( poFeature ) != OGRERR_NONE )
-                    throw invalid_argument("Failed to create feature in shapefile.\n");
-                OGRFeature::DestroyFeature( poFeature );
-                continue;
-            }
-            catch(const bad_get& e)
-            {
-            }
-        }
-        // --------- LinearRing --------- //
-        {
-            try
-            {
-                OGRLinearRing *poLinear = boost::get<OGRLinearRing*>(itb->first);
-                poFeature->SetGeometry(poLinear);
-                if( poLayer->CreateFeature( poFeature ) != OGRERR_NONE )
-                    throw invalid_argument("Failed to create feature in shapefile.\n");
-                OGRFeature::DestroyFeature( poFeature );
-                continue;
-            }
-            catch(const bad_get& e)
-            {
-            }
-        }
-        // --------- LineString --------- //
-        {
-            try
-            {
-                OGRLineString *poLinear = boost::get<OGRLineString*>(itb->first);
-                poFeature->SetGeometry(poLinear);
-                if( poLayer->CreateFeature( poFeature ) != OGRERR_NONE )
-                    throw invalid_argument("Failed to create feature in shapefile.\n");
-                OGRFeature::DestroyFeature( poFeature );
-                continue;
-            }
-            catch(const bad_get& e)
-            {
-            }
-        }
-        // --------- MultiLineString --------- //
-        {
-            try
-            {
-                OGRMultiLineString *poMLinear = boost::get<OGRMultiLineString*>(itb->first);
-                poFeature->SetGeometry(poMLinear);
-                if( poLayer->CreateFeature( poFeature ) != OGRERR_NONE )
-                    throw invalid_argument("Failed to create feature in shapefile.\n");
-                OGRFeature::DestroyFeature( poFeature );
-                continue;
-            }
-            catch(const bad_get& e)
-            {
-            }
+            OGRDataSource::DestroyDataSource( poDS );
+            throw invalid_argument("Failed to create feature in KML file.\n");
         }
     }
     OGRDataSource::DestroyDataSource( poDS );
@@ -1,12 +1,15 @@
 
 #include <boost/filesystem/convenience.hpp>
-#include <boost/variant/get.hpp>
 
 #include <gdal/ogrsf_frmts.h>
 
+#include <wx/config.h>
+
 #include "GilViewer/io/gilviewer_io_factory.hpp"
 #include "gilviewer_file_io_shp.hpp"
 #include "ogr_vector_layer.hpp"
+#include "ogr_streaming_vector_layer.hpp"
+#include "GilViewer/tools/profiler.hpp"
 
 using namespace boost;
 using namespace std;
@@ -16,6 +19,18 @@ using namespace std;
 
 shared_ptr<layer> gilviewer_file_io_shp::load(const string &filename, const ptrdiff_t top_left_x, const ptrdiff_t top_left_y, const ptrdiff_t dim_x, const ptrdiff_t dim_y)
 {
+    profiler::scoped_timer timer(profiler::LOAD, filename);
+    // Large datasources are not loaded in memory: their features are read on demand, for the current viewport
+    bool streaming = true;
+    long threshold = 200000, cache_size = 256;
+    if(wxConfigBase *pConfig = wxConfigBase::Get())
+    {
+        pConfig->Read(wxT("/Options/OGR/Streaming"), &streaming, true);
+        pConfig->Read(wxT("/Options/OGR/StreamingThreshold"), &threshold, 200000);
+        pConfig->Read(wxT("/Options/OGR/CacheSize"), &cache_size, 256);
+    }
+    if(streaming && ogr_streaming_vector_layer::feature_count(filename) > threshold)
+        return shared_ptr<layer>(new ogr_streaming_vector_layer(filesystem::basename(filename), filename, static_cast<size_t>(cache_size)*1024*1024));
     return shared_ptr<layer>(new ogr_vector_layer(filesystem::basename(filename),filename));
 }
 
@@ -41,116 +56,21 @@ void gilviewer_file_io_shp::save(shared_ptr<layer> layer, const string &filename
     if( poLayer == NULL )
         throw ios_base::failure("Creation of layer failed.\n");
 
-    std::vector<std::pair<geometry_types,OGRFeature*> > geometries = ogr_layer->geometries_features();
-    typedef std::vector<std::pair<geometry_types,OGRFeature*> >::const_iterator const_iterator;
-    const_iterator itb=geometries.begin(), ite=geometries.end();
-    for(;itb!=ite;++itb)
+    const ogr_attribute_table& attributes = ogr_layer->attributes();
+    attributes.create_fields(poLayer);
+    const ogr_flat_geometries& geometries = ogr_layer->geometries();
+    for(std::size_t i=0;i<geometries.size();++i)
     {
         OGRFeature *poFeature = OGRFeature::CreateFeature( poLayer->GetLayerDefn() );
-        // --------- Point --------- //
-        {
-            try
-            {
-                OGRPoint *poPoint = boost::get<OGRPoint*>(itb->first);
-                poFeature->SetGeometry(poPoint);
-                if( poLayer->CreateFeature( poFeature ) != OGRERR_NONE )
-                    throw invalid_argument("Failed to create feature in shapefile.\n");
-                OGRFeature::DestroyFeature( poFeature );
-                continue;
-            }
-            catch(const bad_get& e)
-            {
-            }
-        }
-        // --------- MultiPoint --------- //
-        {
-            try
-            {
-                OGRMultiPoint *poMPoint = boost::get<OGRMultiPoint*>(itb->first);
-                poFeature->SetGeometry(poMPoint);
-                if( poLayer->CreateFeature( poFeature ) != OGRERR_NONE )
-                    throw invalid_argument("Failed to create feature in shapefile.\n");
-                OGRFeature::DestroyFeature( poFeature );
-                continue;
-            }
-            catch(const bad_get& e)
-            {
-            }
-        }
-        // --------- Polygon --------- //
-        {
-            try
-            {
-                OGRPolygon *poPolygon = boost::get<OGRPolygon*>(itb->first);
-                poFeature->SetGeometry(poPolygon);
-                if( poLayer->CreateFeature( poFeature ) != OGRERR_NONE )
-                    throw invalid_argument("Failed to create feature in shapefile.\n");
-                OGRFeature::DestroyFeature( poFeature );
-                continue;
-            }
-            catch(const bad_get& e)
-            {
-            }
-        }
-        // --------- MultiPolygon --------- //
-        {
-            try
-            {
-                OGRMultiPolygon *poMPolygon = boost::get<OGRMultiPolygon*>(itb->first);
-                poFeature->SetGeometry(poMPolygon);
-                if( poLayer->CreateFeature( poFeature ) != OGRERR_NONE )
-                    throw invalid_argument("Failed to create feature in shapefile.\n");
-                OGRFeature::DestroyFeature( poFeature );
-                continue;
-            }
-            catch(const bad_get& e)
-            {
-            }
-        }
-        // --------- LinearRing --------- //
-        {
-            try
-            {
-                OGRLinearRing *poLinear = boost::get<OGRLinearRing*>(itb->first);
-                poFeature->SetGeometry(poLinear);
-                if( poLayer->CreateFeature( poFeature ) != OGRERR_NONE )
-                    throw invalid_argument("Failed to create feature in shapefile.\n");
-                OGRFeature::DestroyFeature( poFeature );
-                continue;
-            }
-            catch(const bad_get& e)
-            {
-            }
-        }
-        // --------- LineString --------- //
-        {
-            try
-            {
-                OGRLineString *poLinear = boost::get<OGRLineString*>(itb->first);
-                poFeature->SetGeometry(poLinear);
-                if( poLayer->CreateFeature( poFeature ) != OGRERR_NONE )
-                    throw invalid_argument("Failed to create feature in shapefile.\n");
-                OGRFeature::DestroyFeature( poFeature );
-                continue;
-            }
-            catch(const bad_get& e)
-            {
-            }
-        }
-        // --------- MultiLineString --------- //
+        poFeature->SetGeometryDirectly(geometries.build_ogr_geometry(i));
+        if(i<attributes.size())
+            attributes.fill(i, poFeature);
+        OGRErr err = poLayer->CreateFeature( poFeature );
+        OGRFeature::DestroyFeature( poFeature );
+        if( err != OGRERR_NONE )
         {
-            try
-            {
-                OGRMultiLineString *poMLinear = boost::get<OGRMultiLineString*>(itb->first);
-                poFeature->SetGeometry(poMLinear);
-                if( poLayer->CreateFeature( poFeature ) != OGRERR_NONE )
-                    throw invalid_argument("Failed to create feature in shapefile.\n");
-                OGRFeature::DestroyFeature( poFeature );
-                continue;
-            }
-            catch(const bad_get& e)
-            {
-            }
+            OGRDataSource::DestroyDataSource( poDS );
+            throw invalid_argument("Failed to create feature in shapefile.\n");
         }
     }
     OGRDataSource::DestroyDataSource( poDS );
@@ -0,0 +1,151 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage:
+
+        http://code.google.com/p/gilviewer
+
+Copyright:
+
+        Institut Geographique National (2009)
+
+Authors:
+
+        Olivier Tournaire, Adrien Chauve
+
+
+
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+#include "ogr_attribute_table.hpp"
+
+#include <sstream>
+#include <stdexcept>
+
+#include <gdal/ogrsf_frmts.h>
+
+bool ogr_attribute_table::column::numeric() const
+{
+    return type==OFTInteger || type==OFTReal;
+}
+
+ogr_attribute_table::ogr_attribute_table() : m_nb_rows(0) {}
+
+void ogr_attribute_table::clear()
+{
+    m_columns.clear();
+    m_index.clear();
+    m_nb_rows = 0;
+}
+
+std::size_t ogr_attribute_table::column_index(const std::string& name, int type)
+{
+    std::map<std::string, std::size_t>::const_iterator it = m_index.find(name);
+    if(it!=m_index.end())
+        return it->second;
+    column c;
+    c.name = name;
+    c.type = type;
+    if(c.numeric())
+        c.numbers.resize(m_nb_rows, 0.);
+    else
+        c.strings.resize(m_nb_rows);
+    m_columns.push_back(c);
+    return m_index[name] = m_columns.size()-1;
+}
+
+void ogr_attribute_table::append(OGRFeature* feature)
+{
+    OGRFeatureDefn *defn = feature->GetDefnRef();
+    for(int i=0;i<defn->GetFieldCount();++i)
+    {
+        OGRFieldDefn *field = defn->GetFieldDefn(i);
+        column& c = m_columns[column_index(field->GetNameRef(), field->GetType())];
+        if(c.numeric())
+            c.numbers.push_back(feature->IsFieldSet(i) ? feature->GetFieldAsDouble(i) : 0.);
+        else
+            c.strings.push_back(feature->IsFieldSet(i) ? feature->GetFieldAsString(i) : "");
+    }
+    ++m_nb_rows;
+    // Pads the columns which are not in this feature
+    for(std::size_t i=0;i<m_columns.size();++i)
+    {
+        if(m_columns[i].numeric()) m_columns[i].numbers.resize(m_nb_rows, 0.);
+        else                       m_columns[i].strings.resize(m_nb_rows);
+    }
+}
+
+void ogr_attribute_table::append(std::size_t n)
+{
+    m_nb_rows += n;
+    for(std::size_t i=0;i<m_columns.size();++i)
+    {
+        if(m_columns[i].numeric()) m_columns[i].numbers.resize(m_nb_rows, 0.);
+        else                       m_columns[i].strings.resize(m_nb_rows);
+    }
+}
+
+std::string ogr_attribute_table::value(std::size_t row, std::size_t col) const
+{
+    const column& c = m_columns[col];
+    if(!c.numeric())
+        return c.strings[row];
+    std::ostringstream oss;
+    oss << c.numbers[row];
+    return oss.str();
+}
+
+std::string ogr_attribute_table::row_to_string(std::size_t row) const
+{
+    std::ostringstream oss;
+    for(std::size_t i=0;i<m_columns.size();++i)
+    {
+        if(i>0) oss << " ";
+        oss << m_columns[i].name << "=" << value(row,i);
+    }
+    return oss.str();
+}
+
+void ogr_attribute_table::create_fields(OGRLayer* layer) const
+{
+    for(std::size_t i=0;i<m_columns.size();++i)
+    {
+        OGRFieldDefn field(m_columns[i].name.c_str(), m_columns[i].numeric() ? static_cast<OGRFieldType>(m_columns[i].type) : OFTString);
+        if(layer->CreateField(&field)!=OGRERR_NONE)
+            throw std::invalid_argument("Failed to create field " + m_columns[i].name + ".\n");
+    }
+}
+
+void ogr_attribute_table::fill(std::size_t row, OGRFeature* feature) const
+{
+    for(std::size_t i=0;i<m_columns.size();++i)
+    {
+        int index = feature->GetFieldIndex(m_columns[i].name.c_str());
+        if(index<0)
+            continue;
+        if(m_columns[i].type==OFTInteger)
+            feature->SetField(index, static_cast<int>(m_columns[i].numbers[row]));
+        else if(m_columns[i].type==OFTReal)
+            feature->SetField(index, m_columns[i].numbers[row]);
+        else
+            feature->SetField(index, m_columns[i].strings[row].c_str());
+    }
+}
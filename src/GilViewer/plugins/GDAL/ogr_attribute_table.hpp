@@ -0,0 +1,96 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage:
+
+        http://code.google.com/p/gilviewer
+
+Copyright:
+
+        Institut Geographique National (2009)
+
+Authors:
+
+        Olivier Tournaire, Adrien Chauve
+
+
+
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+#ifndef OGR_ATTRIBUTE_TABLE_HPP
+#define OGR_ATTRIBUTE_TABLE_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+class OGRFeature;
+class OGRLayer;
+
+/**
+ * @brief Columnar storage of the attributes of OGR features.
+ *
+ * One row per feature, one column per field. Integer and real fields are stored as doubles,
+ * all the other field types are stored as strings. Columns are created on demand, so that
+ * features coming from layers with different schemas may be mixed (missing values are left empty).
+ **/
+class ogr_attribute_table
+{
+public:
+    struct column
+    {
+        std::string name;
+        /// OGRFieldType of the field
+        int type;
+        std::vector<double> numbers;
+        std::vector<std::string> strings;
+        bool numeric() const;
+    };
+
+    ogr_attribute_table();
+
+    /// Adds a row with the fields of the feature
+    void append(OGRFeature* feature);
+    /// Adds n rows without any value
+    void append(std::size_t n=1);
+    void clear();
+
+    std::size_t size() const { return m_nb_rows; }
+    const std::vector<column>& columns() const { return m_columns; }
+
+    std::string value(std::size_t row, std::size_t col) const;
+    /// Formats all the values of a row as "name=value" pairs
+    std::string row_to_string(std::size_t row) const;
+
+    /// Creates the fields of the table in an OGR layer
+    void create_fields(OGRLayer* layer) const;
+    /// Sets the fields of a feature created in a layer prepared with create_fields
+    void fill(std::size_t row, OGRFeature* feature) const;
+
+private:
+    std::size_t column_index(const std::string& name, int type);
+
+    std::vector<column> m_columns;
+    std::map<std::string, std::size_t> m_index;
+    std::size_t m_nb_rows;
+};
+
+#endif // OGR_ATTRIBUTE_TABLE_HPP
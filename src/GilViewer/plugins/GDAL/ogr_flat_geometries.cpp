@@ -0,0 +1,589 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage:
+
+        http://code.google.com/p/gilviewer
+
+Copyright:
+
+        Institut Geographique National (2009)
+
+Authors:
+
+        Olivier Tournaire, Adrien Chauve
+
+
+
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+#include "ogr_flat_geometries.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <gdal/ogrsf_frmts.h>
+#include <ogr_geometry.h>
+
+#include <wx/dc.h>
+#include <wx/pen.h>
+#include <wx/brush.h>
+
+namespace
+{
+    // Number of batched polygon vertices above which the batch is drawn
+    const std::size_t max_batch_points = 65536;
+
+    // Rings as runs of coordinates (see level_of_detail)
+    struct ring_runs
+    {
+        ring_runs(const ogr_flat_geometries& g, const std::vector<char>& closed) : m_geometries(g), m_closed(closed) {}
+
+        std::size_t size() const { return m_geometries.nb_rings(); }
+        const ogr_flat_geometries::point_type* run(std::size_t ring, std::size_t& n) const
+        {
+            std::size_t cb = m_geometries.coord_begin(ring);
+            n = m_geometries.coord_end(ring)-cb;
+            return n ? &m_geometries.coordinate(cb) : 0;
+        }
+        bool closed(std::size_t ring) const { return m_closed[ring]!=0; }
+
+        const ogr_flat_geometries& m_geometries;
+        const std::vector<char>& m_closed;
+    };
+
+    double squared_distance_to_segment(const wxRealPoint& q, const ogr_flat_geometries::point_type& a, const ogr_flat_geometries::point_type& b)
+    {
+        double vx = b.x-a.x, vy = b.y-a.y;
+        double ux = q.x-a.x, uy = q.y-a.y;
+        double vv = vx*vx+vy*vy;
+        double t = (vv>0.) ? (ux*vx+uy*vy)/vv : 0.;
+        t = std::max(0.,std::min(1.,t));
+        double dx = ux-t*vx, dy = uy-t*vy;
+        return dx*dx+dy*dy;
+    }
+}
+
+ogr_flat_geometries::ogr_flat_geometries() : m_chunks(), m_chunks_dirty(true), m_points(), m_points_dirty(true)
+{
+    clear();
+}
+
+void ogr_flat_geometries::clear()
+{
+    std::vector<point_type>().swap(m_coordinates);
+    std::vector<unsigned int>().swap(m_ring_offsets);
+    std::vector<unsigned int>().swap(m_part_offsets);
+    std::vector<unsigned int>().swap(m_feature_offsets);
+    std::vector<unsigned char>().swap(m_types);
+    m_ring_offsets.push_back(0);
+    m_part_offsets.push_back(0);
+    m_feature_offsets.push_back(0);
+    std::fill(m_nb_features, m_nb_features+NB_FEATURE_TYPES, 0);
+    m_chunks.clear();
+    std::vector<unsigned int>().swap(m_chunk_begin);
+    std::vector<unsigned int>().swap(m_chunk_end);
+    m_chunks_dirty = true;
+    m_points.clear();
+    m_points_dirty = true;
+}
+
+void ogr_flat_geometries::reserve(std::size_t nb_features, std::size_t nb_coordinates)
+{
+    m_types.reserve(nb_features);
+    m_feature_offsets.reserve(nb_features+1);
+    m_part_offsets.reserve(nb_features+1);
+    m_ring_offsets.reserve(nb_features+1);
+    m_coordinates.reserve(nb_coordinates);
+}
+
+std::size_t ogr_flat_geometries::memory() const
+{
+    return m_coordinates.capacity()*sizeof(point_type)
+            + (m_ring_offsets.capacity()+m_part_offsets.capacity()+m_feature_offsets.capacity())*sizeof(unsigned int)
+            + m_types.capacity();
+}
+
+void ogr_flat_geometries::begin_feature(feature_type type)
+{
+    m_chunks_dirty = true;
+    m_points_dirty = true;
+    m_types.push_back(static_cast<unsigned char>(type));
+    ++m_nb_features[type];
+}
+
+void ogr_flat_geometries::end_ring()
+{
+    m_ring_offsets.push_back(static_cast<unsigned int>(m_coordinates.size()));
+}
+
+void ogr_flat_geometries::end_part()
+{
+    m_part_offsets.push_back(static_cast<unsigned int>(m_ring_offsets.size()-1));
+}
+
+void ogr_flat_geometries::end_feature()
+{
+    m_feature_offsets.push_back(static_cast<unsigned int>(m_part_offsets.size()-1));
+}
+
+void ogr_flat_geometries::append_line_string(OGRGeometry* geometry)
+{
+    OGRLineString *line = static_cast<OGRLineString*>(geometry);
+    int n = line->getNumPoints();
+    for(int i=0;i<n;++i)
+    {
+        point_type p = { line->getX(i), line->getY(i) };
+        m_coordinates.push_back(p);
+    }
+    end_ring();
+}
+
+void ogr_flat_geometries::append_polygon(OGRGeometry* geometry)
+{
+    OGRPolygon *polygon = static_cast<OGRPolygon*>(geometry);
+    if(polygon->getExteriorRing())
+        append_line_string(polygon->getExteriorRing());
+    for(int i=0;i<polygon->getNumInteriorRings();++i)
+        append_line_string(polygon->getInteriorRing(i));
+    end_part();
+}
+
+bool ogr_flat_geometries::append(OGRGeometry* geometry)
+{
+    if(!geometry)
+        return false;
+    // Order matters: OGRLinearRing derives from OGRLineString
+    if(OGRLinearRing *g = dynamic_cast<OGRLinearRing*>(geometry))
+    {
+        begin_feature(LINEAR_RING);
+        append_line_string(g);
+        end_part();
+    }
+    else if(OGRLineString *g = dynamic_cast<OGRLineString*>(geometry))
+    {
+        begin_feature(LINE_STRING);
+        append_line_string(g);
+        end_part();
+    }
+    else if(OGRMultiLineString *g = dynamic_cast<OGRMultiLineString*>(geometry))
+    {
+        begin_feature(MULTI_LINE_STRING);
+        for(int i=0;i<g->getNumGeometries();++i)
+        {
+            if(!dynamic_cast<OGRLineString*>(g->getGeometryRef(i)))
+                continue;
+            append_line_string(g->getGeometryRef(i));
+            end_part();
+        }
+    }
+    else if(OGRMultiPoint *g = dynamic_cast<OGRMultiPoint*>(geometry))
+    {
+        begin_feature(MULTI_POINT);
+        for(int i=0;i<g->getNumGeometries();++i)
+        {
+            OGRPoint *point = dynamic_cast<OGRPoint*>(g->getGeometryRef(i));
+            if(!point)
+                continue;
+            point_type p = { point->getX(), point->getY() };
+            m_coordinates.push_back(p);
+            end_ring();
+            end_part();
+        }
+    }
+    else if(OGRMultiPolygon *g = dynamic_cast<OGRMultiPolygon*>(geometry))
+    {
+        begin_feature(MULTI_POLYGON);
+        for(int i=0;i<g->getNumGeometries();++i)
+            if(dynamic_cast<OGRPolygon*>(g->getGeometryRef(i)))
+                append_polygon(g->getGeometryRef(i));
+    }
+    else if(OGRPoint *g = dynamic_cast<OGRPoint*>(geometry))
+    {
+        begin_feature(POINT);
+        point_type p = { g->getX(), g->getY() };
+        m_coordinates.push_back(p);
+        end_ring();
+        end_part();
+    }
+    else if(OGRPolygon *g = dynamic_cast<OGRPolygon*>(geometry))
+    {
+        begin_feature(POLYGON);
+        append_polygon(g);
+    }
+    else
+        return false;
+    end_feature();
+    return true;
+}
+
+void ogr_flat_geometries::append(feature_type type, const std::vector<double>& x, const std::vector<double>& y)
+{
+    std::size_t n = std::min(x.size(),y.size());
+    append(type, n ? &x.front() : 0, n ? &y.front() : 0, n);
+}
+
+void ogr_flat_geometries::append(feature_type type, const double* x, const double* y, std::size_t n)
+{
+    begin_feature(type);
+    for(std::size_t i=0;i<n;++i)
+    {
+        point_type p = { x[i], y[i] };
+        m_coordinates.push_back(p);
+    }
+    // Polygons are stored with closed rings, as read from OGR
+    if((type==POLYGON || type==MULTI_POLYGON) && n>0 && (x[0]!=x[n-1] || y[0]!=y[n-1]))
+    {
+        point_type p = { x[0], y[0] };
+        m_coordinates.push_back(p);
+    }
+    end_ring();
+    end_part();
+    end_feature();
+}
+
+OGRGeometry* ogr_flat_geometries::build_ogr_geometry(std::size_t feature) const
+{
+    std::size_t pb = part_begin(feature), pe = part_end(feature);
+    switch(type(feature))
+    {
+    case POINT:
+    case MULTI_POINT:
+    {
+        OGRMultiPoint *multi = (type(feature)==MULTI_POINT) ? new OGRMultiPoint : NULL;
+        for(std::size_t part=pb;part<pe;++part)
+        {
+            const point_type& p = m_coordinates[coord_begin(ring_begin(part))];
+            if(!multi)
+                return new OGRPoint(p.x,p.y);
+            multi->addGeometryDirectly(new OGRPoint(p.x,p.y));
+        }
+        return multi;
+    }
+    case LINE_STRING:
+    case LINEAR_RING:
+    case MULTI_LINE_STRING:
+    {
+        OGRMultiLineString *multi = (type(feature)==MULTI_LINE_STRING) ? new OGRMultiLineString : NULL;
+        for(std::size_t part=pb;part<pe;++part)
+        {
+            std::size_t ring = ring_begin(part);
+            OGRLineString *line = (type(feature)==LINEAR_RING) ? new OGRLinearRing : new OGRLineString;
+            line->setNumPoints(static_cast<int>(coord_end(ring)-coord_begin(ring)));
+            for(std::size_t i=coord_begin(ring);i<coord_end(ring);++i)
+                line->setPoint(static_cast<int>(i-coord_begin(ring)), m_coordinates[i].x, m_coordinates[i].y);
+            if(!multi)
+                return line;
+            multi->addGeometryDirectly(line);
+        }
+        return multi;
+    }
+    case POLYGON:
+    case MULTI_POLYGON:
+    {
+        OGRMultiPolygon *multi = (type(feature)==MULTI_POLYGON) ? new OGRMultiPolygon : NULL;
+        for(std::size_t part=pb;part<pe;++part)
+        {
+            OGRPolygon *polygon = new OGRPolygon;
+            for(std::size_t ring=ring_begin(part);ring<ring_end(part);++ring)
+            {
+                OGRLinearRing *r = new OGRLinearRing;
+                r->setNumPoints(static_cast<int>(coord_end(ring)-coord_begin(ring)));
+                for(std::size_t i=coord_begin(ring);i<coord_end(ring);++i)
+                    r->setPoint(static_cast<int>(i-coord_begin(ring)), m_coordinates[i].x, m_coordinates[i].y);
+                polygon->addRingDirectly(r);
+            }
+            if(!multi)
+                return polygon;
+            multi->addGeometryDirectly(polygon);
+        }
+        return multi;
+    }
+    default:
+        return NULL;
+    }
+}
+
+bbox_rtree::box ogr_flat_geometries::bounding_box(std::size_t feature) const
+{
+    bbox_rtree::box b;
+    std::size_t cb = coord_begin(ring_begin(part_begin(feature))), ce = coord_begin(ring_begin(part_end(feature)));
+    for(std::size_t i=cb;i<ce;++i)
+        b.expand(m_coordinates[i].x, m_coordinates[i].y);
+    return b;
+}
+
+bool ogr_flat_geometries::extent(double& min_x, double& min_y, double& max_x, double& max_y) const
+{
+    if(m_coordinates.empty())
+        return false;
+    min_x = max_x = m_coordinates[0].x;
+    min_y = max_y = m_coordinates[0].y;
+    for(std::size_t i=1;i<m_coordinates.size();++i)
+    {
+        min_x = std::min(min_x, m_coordinates[i].x); max_x = std::max(max_x, m_coordinates[i].x);
+        min_y = std::min(min_y, m_coordinates[i].y); max_y = std::max(max_y, m_coordinates[i].y);
+    }
+    return true;
+}
+
+void ogr_flat_geometries::draw(wxDC& dc, const layer_transform& t, const wxPen& point_pen, const wxPen& line_pen, const wxPen& polygon_pen, const wxBrush& polygon_brush) const
+{
+    draw_buffer buffer;
+    for(std::size_t f=0;f<size();++f)
+        draw_feature(dc,t,f,point_pen,line_pen,polygon_pen,polygon_brush,buffer);
+    buffer.flush(dc);
+}
+
+void ogr_flat_geometries::draw_feature(wxDC& dc, const layer_transform& t, std::size_t feature, const wxPen& point_pen, const wxPen& line_pen, const wxPen& polygon_pen, const wxBrush& polygon_brush, draw_buffer& buffer, const lod_type::level* level) const
+{
+    const std::vector<point_type>& coordinates = level ? level->coordinates : m_coordinates;
+    const std::vector<unsigned int>& offsets = level ? level->offsets : m_ring_offsets;
+    std::vector<wxPoint>& points = buffer.points;
+    std::size_t rb = ring_begin(part_begin(feature)), re = ring_begin(part_end(feature));
+    switch(type(feature))
+    {
+    case POINT:
+    case MULTI_POINT:
+        buffer.flush(dc);
+        if(buffer.pen!=&point_pen) { dc.SetPen(point_pen); buffer.pen = &point_pen; }
+        for(std::size_t i=offsets[rb];i<offsets[re];++i)
+        {
+            wxPoint p = t.from_local_int(coordinates[i]);
+            dc.DrawLine(p,p);
+        }
+        break;
+    case LINE_STRING:
+    case LINEAR_RING:
+    case MULTI_LINE_STRING:
+        buffer.flush(dc);
+        if(buffer.pen!=&line_pen) { dc.SetPen(line_pen); buffer.pen = &line_pen; }
+        for(std::size_t ring=rb;ring<re;++ring)
+        {
+            std::size_t cb = offsets[ring], ce = offsets[ring+1];
+            if(ce-cb<2) continue;
+            points.resize(ce-cb);
+            for(std::size_t i=cb;i<ce;++i)
+                points[i-cb] = t.from_local_int(coordinates[i]);
+            dc.DrawLines(static_cast<int>(points.size()),&points.front());
+            points.clear();
+        }
+        break;
+    case POLYGON:
+    case MULTI_POLYGON:
+        if(buffer.pen!=&polygon_pen)
+        {
+            dc.SetPen(polygon_pen);
+            dc.SetBrush(polygon_brush);
+            buffer.pen = &polygon_pen;
+        }
+        // All the rings of the feature are drawn together, so that the holes stay empty (odd-even rule)
+        for(std::size_t ring=rb;ring<re;++ring)
+        {
+            std::size_t cb = offsets[ring], ce = offsets[ring+1];
+            if(ce==cb) continue;
+            for(std::size_t i=cb;i<ce;++i)
+                points.push_back(t.from_local_int(coordinates[i]));
+            buffer.counts.push_back(static_cast<int>(ce-cb));
+        }
+        // Filled features are drawn one by one: the fill of a feature must cover the outlines of the features below.
+        // Outlines only can be batched, whatever their overlaps.
+        if(polygon_brush.GetStyle()!=wxTRANSPARENT || points.size()>=max_batch_points)
+            buffer.flush(dc);
+        break;
+    default:
+        break;
+    }
+}
+
+void ogr_flat_geometries::draw_buffer::flush(wxDC& dc)
+{
+    if(!counts.empty())
+        dc.DrawPolyPolygon(static_cast<int>(counts.size()),&counts.front(),&points.front(),0,0,wxODDEVEN_RULE);
+    counts.clear();
+    points.clear();
+}
+
+void ogr_flat_geometries::build_lod(lod_type& lod) const
+{
+    std::vector<char> closed(nb_rings(), 0);
+    for(std::size_t f=0;f<size();++f)
+    {
+        feature_type ft = type(f);
+        if(ft==LINEAR_RING || ft==POLYGON || ft==MULTI_POLYGON)
+            std::fill(closed.begin()+ring_begin(part_begin(f)), closed.begin()+ring_begin(part_end(f)), 1);
+    }
+    lod.build(ring_runs(*this, closed));
+}
+
+void ogr_flat_geometries::build_chunks() const
+{
+    static const std::size_t chunk_size = 32;
+    m_chunk_begin.clear();
+    m_chunk_end.clear();
+    std::vector<bbox_rtree::entry> entries;
+    for(std::size_t ring=0;ring+1<m_ring_offsets.size();++ring)
+    {
+        std::size_t cb = coord_begin(ring), ce = coord_end(ring);
+        if(ce==cb) continue;
+        // Consecutive runs share their end coordinate, so that no segment is lost
+        for(std::size_t b=cb;;)
+        {
+            std::size_t e = std::min(b+chunk_size, ce-1);
+            bbox_rtree::box box;
+            for(std::size_t i=b;i<=e;++i)
+                box.expand(m_coordinates[i].x, m_coordinates[i].y);
+            entries.push_back(bbox_rtree::entry(box, static_cast<unsigned int>(m_chunk_begin.size())));
+            m_chunk_begin.push_back(static_cast<unsigned int>(b));
+            m_chunk_end.push_back(static_cast<unsigned int>(e));
+            if(e+1>=ce) break;
+            b = e;
+        }
+    }
+    m_chunks.bulk_load(entries);
+    m_chunks_dirty = false;
+}
+
+const bbox_rtree& ogr_flat_geometries::point_index() const
+{
+    if(!m_points_dirty)
+        return m_points;
+    std::vector<bbox_rtree::entry> entries;
+    entries.reserve(m_nb_features[POINT]+m_nb_features[MULTI_POINT]);
+    for(std::size_t f=0;f<size();++f)
+    {
+        if(!is_point(type(f)))
+            continue;
+        for(std::size_t i=coord_begin(ring_begin(part_begin(f)));i<coord_begin(ring_begin(part_end(f)));++i)
+            entries.push_back(bbox_rtree::entry(bbox_rtree::box(m_coordinates[i].x, m_coordinates[i].y, m_coordinates[i].x, m_coordinates[i].y), static_cast<unsigned int>(i)));
+    }
+    m_points.bulk_load(entries);
+    m_points_dirty = false;
+    return m_points;
+}
+
+bool ogr_flat_geometries::snap(const layer_transform& t, eSNAP snap, double d2[], const wxRealPoint& p, wxRealPoint& psnap) const
+{
+    if(!(snap&(SNAP_POINT|SNAP_LINE)))
+        return false;
+    if(m_chunks_dirty)
+        build_chunks();
+    wxRealPoint q = t.to_local(p);
+    double zoom = t.zoom_factor();
+    double invzoom2 = 1.0/(zoom*zoom);
+    bool snapped = false;
+
+    // Only the runs within the tolerance window are tested
+    double d = 0.;
+    if(snap&SNAP_POINT) d = std::max(d, d2[SNAP_POINT]);
+    if(snap&SNAP_LINE ) d = std::max(d, d2[SNAP_LINE ]);
+    bbox_rtree::box window(q.x, q.y, q.x, q.y);
+    window.inflate(std::sqrt(d)*zoom);
+    std::vector<unsigned int> ids;
+    m_chunks.query(window, ids);
+
+    for(std::size_t k=0;k<ids.size();++k)
+    {
+        std::size_t b = m_chunk_begin[ids[k]], e = m_chunk_end[ids[k]];
+        if(snap&SNAP_POINT)
+            for(std::size_t i=b;i<=e;++i)
+                if(snap_point(t, invzoom2, d2, q, m_coordinates[i], psnap)) snapped = true;
+        if(snap&SNAP_LINE)
+            for(std::size_t i=b;i<e;++i)
+                if(snap_segment(t, invzoom2, d2, q, m_coordinates[i], m_coordinates[i+1], psnap)) snapped = true;
+    }
+    return snapped;
+}
+
+void ogr_flat_geometries::screen_segments(const layer_transform& t, const bbox_rtree::box& local, std::vector< std::pair<wxRealPoint,wxRealPoint> >& segments) const
+{
+    if(m_chunks_dirty)
+        build_chunks();
+    std::vector<unsigned int> ids;
+    m_chunks.query(local, ids);
+    for(std::size_t k=0;k<ids.size();++k)
+    {
+        for(std::size_t i=m_chunk_begin[ids[k]];i<m_chunk_end[ids[k]];++i)
+        {
+            const point_type& a = m_coordinates[i];
+            const point_type& b = m_coordinates[i+1];
+            if(local.intersects(bbox_rtree::box(a.x, a.y, b.x, b.y)))
+                segments.push_back(std::make_pair(t.from_local(a), t.from_local(b)));
+        }
+    }
+}
+
+bool ogr_flat_geometries::hit(std::size_t f, const wxRealPoint& q, double tolerance2) const
+{
+    feature_type ft = type(f);
+    if(ft==POLYGON || ft==MULTI_POLYGON)
+    {
+        // Even-odd rule over all the rings of each part
+        for(std::size_t part=part_begin(f);part<part_end(f);++part)
+        {
+            bool inside = false;
+            for(std::size_t ring=ring_begin(part);ring<ring_end(part);++ring)
+            {
+                std::size_t cb = coord_begin(ring), ce = coord_end(ring);
+                for(std::size_t i=cb, j=ce-1;i<ce;j=i++)
+                {
+                    const point_type& a = m_coordinates[i];
+                    const point_type& b = m_coordinates[j];
+                    if(((a.y>q.y)!=(b.y>q.y)) && (q.x < (b.x-a.x)*(q.y-a.y)/(b.y-a.y)+a.x))
+                        inside = !inside;
+                }
+            }
+            if(inside)
+                return true;
+        }
+    }
+    std::size_t rb = ring_begin(part_begin(f)), re = ring_begin(part_end(f));
+    for(std::size_t ring=rb;ring<re;++ring)
+    {
+        std::size_t cb = coord_begin(ring), ce = coord_end(ring);
+        if(ce-cb==1)
+        {
+            double dx = q.x-m_coordinates[cb].x, dy = q.y-m_coordinates[cb].y;
+            if(dx*dx+dy*dy<=tolerance2)
+                return true;
+            continue;
+        }
+        for(std::size_t i=cb;i+1<ce;++i)
+            if(squared_distance_to_segment(q,m_coordinates[i],m_coordinates[i+1])<=tolerance2)
+                return true;
+    }
+    return false;
+}
+
+long ogr_flat_geometries::hit_test(const layer_transform& t, const wxRealPoint& p, double tolerance) const
+{
+    wxRealPoint q = t.to_local(p);
+    // Tolerance is given in screen pixels
+    double zoom = t.zoom_factor();
+    double tolerance2 = tolerance*tolerance*zoom*zoom;
+
+    // Features are drawn in order: the last one is on top
+    for(std::size_t f=size();f-->0;)
+        if(hit(f,q,tolerance2))
+            return static_cast<long>(f);
+    return -1;
+}
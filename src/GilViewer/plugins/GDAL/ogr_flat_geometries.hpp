@@ -0,0 +1,180 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage:
+
+        http://code.google.com/p/gilviewer
+
+Copyright:
+
+        Institut Geographique National (2009)
+
+Authors:
+
+        Olivier Tournaire, Adrien Chauve
+
+
+
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+#ifndef OGR_FLAT_GEOMETRIES_HPP
+#define OGR_FLAT_GEOMETRIES_HPP
+
+#include <vector>
+#include <cstddef>
+
+#include "GilViewer/layers/layer_transform.hpp"
+#include "GilViewer/tools/bbox_rtree.hpp"
+#include "GilViewer/tools/level_of_detail.hpp"
+
+class wxDC;
+class wxPen;
+class wxBrush;
+class OGRGeometry;
+
+/**
+ * @brief Structure of arrays storage of OGR geometries.
+ *
+ * Every feature is made of parts, every part of rings and every ring of coordinates:
+ * - a (multi)point has one part per point, each with a single ring of a single coordinate,
+ * - a (multi)linestring has one part per linestring, each with a single ring,
+ * - a (multi)polygon has one part per polygon, whose first ring is the exterior ring.
+ *
+ * All coordinates are stored in a single contiguous buffer, and the hierarchy is described by three offset arrays.
+ * Drawing, snapping and hit-testing only iterate over these arrays, without any virtual call.
+ **/
+class ogr_flat_geometries
+{
+public:
+    enum feature_type
+    {
+        POINT = 0,
+        MULTI_POINT,
+        LINE_STRING,
+        LINEAR_RING,
+        MULTI_LINE_STRING,
+        POLYGON,
+        MULTI_POLYGON,
+        NB_FEATURE_TYPES
+    };
+
+    struct point_type { double x, y; };
+    /// Simplified coordinates of the rings, drawn when zoomed out
+    typedef level_of_detail<point_type> lod_type;
+
+    /// Buffers reused by the successive calls to draw_feature within a draw, so that a feature is drawn without allocation.
+    /// Consecutive unfilled polygon features are batched in the buffer: flush must be called at the end of the draw.
+    struct draw_buffer
+    {
+        draw_buffer() : pen(0) {}
+        /// Draws the batched polygons
+        void flush(wxDC& dc);
+
+        std::vector<wxPoint> points;
+        std::vector<int> counts;
+        /// Pen currently selected in the device context by draw_feature: it is only changed between features of different kinds
+        const wxPen* pen;
+    };
+
+    ogr_flat_geometries();
+
+    /// Appends a geometry as a new feature. Returns false (and appends nothing) if the geometry type is not handled.
+    bool append(OGRGeometry* geometry);
+    /// Appends a single part, single ring feature
+    void append(feature_type type, const std::vector<double>& x, const std::vector<double>& y);
+    void append(feature_type type, const double* x, const double* y, std::size_t n);
+    /// Builds back the OGR geometry of a feature. The caller owns the returned geometry.
+    OGRGeometry* build_ogr_geometry(std::size_t feature) const;
+
+    /// Reserves the buffers for nb_features single part, single ring features and nb_coordinates coordinates in total
+    void reserve(std::size_t nb_features, std::size_t nb_coordinates);
+    void clear();
+
+    std::size_t size() const { return m_types.size(); }
+    std::size_t size(feature_type type) const { return m_nb_features[type]; }
+    std::size_t nb_coordinates() const { return m_coordinates.size(); }
+    std::size_t nb_rings() const { return m_ring_offsets.size()-1; }
+    /// Approximate memory used by the buffers, in bytes
+    std::size_t memory() const;
+
+    feature_type type(std::size_t feature) const { return static_cast<feature_type>(m_types[feature]); }
+    std::size_t part_begin (std::size_t feature) const { return m_feature_offsets[feature  ]; }
+    std::size_t part_end   (std::size_t feature) const { return m_feature_offsets[feature+1]; }
+    std::size_t ring_begin (std::size_t part)    const { return m_part_offsets[part  ]; }
+    std::size_t ring_end   (std::size_t part)    const { return m_part_offsets[part+1]; }
+    std::size_t coord_begin(std::size_t ring)    const { return m_ring_offsets[ring  ]; }
+    std::size_t coord_end  (std::size_t ring)    const { return m_ring_offsets[ring+1]; }
+    const point_type& coordinate(std::size_t i) const { return m_coordinates[i]; }
+
+    bbox_rtree::box bounding_box(std::size_t feature) const;
+    /// Bounding box of all the coordinates. Returns false if there is no coordinate.
+    bool extent(double& min_x, double& min_y, double& max_x, double& max_y) const;
+
+    void draw(wxDC& dc, const layer_transform& t, const wxPen& point_pen, const wxPen& line_pen, const wxPen& polygon_pen, const wxBrush& polygon_brush) const;
+    /// Draws a single feature, with the simplified coordinates of level if given.
+    /// Each linestring is drawn by a single DrawLines, and each (multi)polygon, holes included, by a single DrawPolyPolygon.
+    /// Consecutive (multi)polygons are batched in a single DrawPolyPolygon when the brush is transparent.
+    void draw_feature(wxDC& dc, const layer_transform& t, std::size_t feature, const wxPen& point_pen, const wxPen& line_pen, const wxPen& polygon_pen, const wxBrush& polygon_brush, draw_buffer& buffer, const lod_type::level* level=0) const;
+    /// Computes the levels of detail of the rings. Only reads the geometries, so that it may run in a background thread.
+    void build_lod(lod_type& lod) const;
+
+    /// Index of the coordinates of the (multi)point features (identifier: coordinate index), built on the first call
+    const bbox_rtree& point_index() const;
+    static bool is_point(feature_type type) { return type==POINT || type==MULTI_POINT; }
+
+    /// Snaps to the vertices and segments within the tolerance window given by d2 (see panel_viewer::snap)
+    bool snap(const layer_transform& t, eSNAP snap, double d2[], const wxRealPoint& p, wxRealPoint& psnap) const;
+    /// Appends the segments intersecting a window given in local coordinates, in screen coordinates
+    void screen_segments(const layer_transform& t, const bbox_rtree::box& local, std::vector< std::pair<wxRealPoint,wxRealPoint> >& segments) const;
+    /// Returns the index of the topmost feature under the screen point p (within tolerance pixels), or -1
+    long hit_test(const layer_transform& t, const wxRealPoint& p, double tolerance) const;
+    /// Tests whether the local point q is inside a polygon feature, or within sqrt(tolerance2) local units of its vertices and segments
+    bool hit(std::size_t feature, const wxRealPoint& q, double tolerance2) const;
+
+private:
+    void begin_feature(feature_type type);
+    void end_ring();
+    void end_part();
+    void end_feature();
+    void append_line_string(OGRGeometry* line);
+    void append_polygon(OGRGeometry* polygon);
+    /// Indexes the rings by runs of at most chunk_size segments, so that snapping does not depend on the size of the features
+    void build_chunks() const;
+
+    std::vector<point_type> m_coordinates;
+    /// Index of the first coordinate of each ring (nb rings + 1)
+    std::vector<unsigned int> m_ring_offsets;
+    /// Index of the first ring of each part (nb parts + 1)
+    std::vector<unsigned int> m_part_offsets;
+    /// Index of the first part of each feature (nb features + 1)
+    std::vector<unsigned int> m_feature_offsets;
+    std::vector<unsigned char> m_types;
+    std::size_t m_nb_features[NB_FEATURE_TYPES];
+
+    /// Index of the runs of consecutive coordinates (first and last coordinate of each run), built on the first snap
+    mutable bbox_rtree m_chunks;
+    mutable std::vector<unsigned int> m_chunk_begin, m_chunk_end;
+    mutable bool m_chunks_dirty;
+    mutable bbox_rtree m_points;
+    mutable bool m_points_dirty;
+};
+
+#endif // OGR_FLAT_GEOMETRIES_HPP
@@ -0,0 +1,438 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage:
+
+        http://code.google.com/p/gilviewer
+
+Copyright:
+
+        Institut Geographique National (2009)
+
+Authors:
+
+        Olivier Tournaire, Adrien Chauve
+
+
+
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+
+#include "ogr_streaming_vector_layer.hpp"
+
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <sstream>
+
+#include <gdal/ogrsf_frmts.h>
+#include <ogr_geometry.h>
+
+#include "GilViewer/gui/vector_layer_settings_control.hpp"
+#include "GilViewer/convenient/macros_gilviewer.hpp"
+#include "GilViewer/convenient/utils.hpp"
+#include "GilViewer/tools/profiler.hpp"
+
+using namespace std;
+using namespace boost::filesystem;
+
+bool ogr_streaming_vector_layer::tile_key::operator<(const tile_key& k) const
+{
+    if(level!=k.level) return level<k.level;
+    if(ix!=k.ix) return ix<k.ix;
+    return iy<k.iy;
+}
+
+long ogr_streaming_vector_layer::feature_count(const string &filename)
+{
+    OGRDataSource *poDS = OGRSFDriverRegistrar::Open(filename.c_str(), FALSE);
+    if( poDS == NULL )
+        return -1;
+    long count = 0;
+    for(int i=0;i<poDS->GetLayerCount();++i)
+        count += poDS->GetLayer(i)->GetFeatureCount(TRUE);
+    OGRDataSource::DestroyDataSource( poDS );
+    return count;
+}
+
+ogr_streaming_vector_layer::source::~source()
+{
+    if(datasource)
+        OGRDataSource::DestroyDataSource( datasource );
+}
+
+ogr_streaming_vector_layer::ogr_streaming_vector_layer(const string &layer_name, const string &filename_, std::size_t cache_size): vector_layer(),
+m_source(new source),
+m_feature_count(0),
+m_min_x(0.), m_min_y(0.), m_max_x(0.), m_max_y(0.),
+m_cache_size(cache_size),
+m_cached_bytes(0),
+m_max_tile_features(65536)
+{
+    name(layer_name);
+    filename( system_complete(filename_).string() );
+    default_display_parameters();
+    notifyLayerSettingsControl_();
+
+    m_source->datasource = OGRSFDriverRegistrar::Open(filename_.c_str(), FALSE);
+    if( m_source->datasource == NULL )
+    {
+        string error_message("Open failed. Did you registered OGR formats (you MUST call OGRRegisterAll() ...)?\n");
+        error_message += CPLGetLastErrorMsg();
+        throw invalid_argument(error_message.c_str());
+    }
+
+    // Only the extent and the number of features are read on opening
+    OGRDataSource *datasource = m_source->datasource;
+    bool first = true;
+    for(int i=0;i<datasource->GetLayerCount();++i)
+    {
+        OGRLayer *poLayer = datasource->GetLayer(i);
+        m_feature_count += poLayer->GetFeatureCount(TRUE);
+        OGREnvelope env;
+        if(poLayer->GetExtent(&env, TRUE)!=OGRERR_NONE)
+            continue;
+        if(first)
+        {
+            m_min_x = env.MinX; m_min_y = env.MinY;
+            m_max_x = env.MaxX; m_max_y = env.MaxY;
+            first = false;
+        }
+        else
+        {
+            m_min_x = std::min(m_min_x, env.MinX); m_min_y = std::min(m_min_y, env.MinY);
+            m_max_x = std::max(m_max_x, env.MaxX); m_max_y = std::max(m_max_y, env.MaxY);
+        }
+    }
+    build_infos();
+}
+
+ogr_streaming_vector_layer::~ogr_streaming_vector_layer()
+{
+    // The datasource is closed by the last reading task still holding it
+    clear();
+}
+
+void ogr_streaming_vector_layer::update(int width, int height)
+{
+    vector_layer::update(width, height);
+    // Viewport in local coordinates
+    wxRealPoint p0 = transform().to_local(wxRealPoint(0,0));
+    wxRealPoint p1 = transform().to_local(wxRealPoint(width,height));
+    double vx0 = std::min(p0.x,p1.x), vx1 = std::max(p0.x,p1.x);
+    double vy0 = std::min(p0.y,p1.y), vy1 = std::max(p0.y,p1.y);
+    // Half a viewport of margin, so that small pans are drawn without waiting for the next update
+    double mx = (vx1-vx0)/2., my = (vy1-vy0)/2.;
+    vx0 -= mx; vx1 += mx; vy0 -= my; vy1 += my;
+
+    std::set<tile_key> wanted;
+    double extent = std::max(m_max_x-m_min_x, m_max_y-m_min_y);
+    if(extent<=0. || vx1<m_min_x || vx0>m_max_x || vy1<m_min_y || vy0>m_max_y)
+    {
+        // Degenerated extent: a single tile holds everything
+        if(extent<=0. && m_feature_count>0)
+        {
+            tile_key key = {0,0,0};
+            wanted.insert(key);
+        }
+    }
+    else
+    {
+        // Tiles are at least as large as the viewport (without margin): at most 3x3 tiles are needed
+        double view = std::max(vx1-vx0, vy1-vy0)/2.;
+        int level = (view>=extent) ? 0 : static_cast<int>(std::floor(std::log(extent/view)/std::log(2.)));
+        level = std::min(level, 30);
+        double tile_size = extent / (1<<level);
+        int n = 1<<level;
+        int ix0 = std::max(0, static_cast<int>(std::floor((vx0-m_min_x)/tile_size)));
+        int ix1 = std::min(n-1, static_cast<int>(std::floor((vx1-m_min_x)/tile_size)));
+        int iy0 = std::max(0, static_cast<int>(std::floor((vy0-m_min_y)/tile_size)));
+        int iy1 = std::min(n-1, static_cast<int>(std::floor((vy1-m_min_y)/tile_size)));
+        for(int iy=iy0;iy<=iy1;++iy)
+            for(int ix=ix0;ix<=ix1;++ix)
+            {
+                tile_key key = {level,ix,iy};
+                wanted.insert(key);
+            }
+    }
+
+    // The geometries returned for snapping are those of the visible tiles: the revision only changes with them
+    std::vector<tile_ptr> visible;
+    for(std::set<tile_key>::const_iterator it=wanted.begin();it!=wanted.end();++it)
+        if(tile_ptr t = fetch(*it))
+            visible.push_back(t);
+    bool changed = visible.size()!=m_visible.size();
+    for(unsigned int i=0;i<visible.size() && !changed;++i)
+        changed = visible[i]!=m_visible[i];
+    m_wanted.swap(wanted);
+    m_visible.swap(visible);
+    if(changed)
+        content_changed();
+    evict();
+}
+
+ogr_streaming_vector_layer::tile_ptr ogr_streaming_vector_layer::fetch(const tile_key& key)
+{
+    std::map<tile_key, std::list<tile_ptr>::iterator>::iterator it = m_tiles.find(key);
+    if(it!=m_tiles.end())
+    {
+        // Move to the front of the LRU list
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return *it->second;
+    }
+    if(!m_pending.insert(key).second)
+        return tile_ptr();
+
+    boost::shared_ptr<fetch_job> job(new fetch_job);
+    job->token = m_token;
+    job->src = m_source;
+    job->key = key;
+    double extent = std::max(m_max_x-m_min_x, m_max_y-m_min_y);
+    job->filter = extent>0.;
+    job->size = extent / (1<<key.level);
+    job->x0 = m_min_x + key.ix*job->size;
+    job->y0 = m_min_y + key.iy*job->size;
+    job->expected = static_cast<double>(m_feature_count) / (1<<key.level) / (1<<key.level);
+    job->max_features = m_max_tile_features;
+    // A view needs at most 3x3 tiles
+    job->max_bytes = m_cache_size/9;
+    thread_pool::instance()->submit(boost::bind(&ogr_streaming_vector_layer::read_tile, job), thread_pool::PRIORITY_NORMAL,
+                                    job->token, boost::bind(&ogr_streaming_vector_layer::tile_ready, this, job));
+    return tile_ptr();
+}
+
+void ogr_streaming_vector_layer::read_tile(const boost::shared_ptr<fetch_job>& job)
+{
+    try
+    {
+        tile_ptr t(new tile);
+        t->key = job->key;
+        t->bytes = sizeof(tile);
+        {
+            boost::mutex::scoped_lock lock(job->src->mutex);
+            profiler::scoped_timer timer(profiler::LOAD, "streaming tile");
+            OGRDataSource *datasource = job->src->datasource;
+            // The levels of detail take at most three times the memory of the geometries
+            std::size_t max_bytes = job->max_bytes/4;
+            bool full = false;
+            for(int i=0;i<datasource->GetLayerCount() && !full;++i)
+            {
+                OGRLayer *poLayer = datasource->GetLayer(i);
+                if(job->filter)
+                    poLayer->SetSpatialFilterRect(job->x0, job->y0, job->x0+job->size, job->y0+job->size);
+                // Dense tiles (zoomed out) are sampled evenly rather than truncated
+                double count = static_cast<double>(poLayer->GetFeatureCount(FALSE));
+                if(count<0.)
+                    count = job->expected;
+                std::size_t stride = count>job->max_features ? static_cast<std::size_t>(std::ceil(count/job->max_features)) : 1;
+                poLayer->ResetReading();
+                OGRFeature *poFeature;
+                for(std::size_t k=0; (poFeature = poLayer->GetNextFeature()) != NULL; ++k)
+                {
+                    if(k%stride==0 && t->geometries.append(poFeature->GetGeometryRef()))
+                        t->ids.push_back(std::make_pair(i, static_cast<long>(poFeature->GetFID())));
+                    OGRFeature::DestroyFeature(poFeature);
+                    if(k%1024==0 && (job->token.cancelled() || t->geometries.memory()>max_bytes))
+                    {
+                        full = true;
+                        break;
+                    }
+                }
+                poLayer->SetSpatialFilter(NULL);
+            }
+        }
+        if(job->token.cancelled())
+            return;
+        t->geometries.build_lod(t->lod);
+        t->bytes += t->geometries.memory() + t->lod.memory() + t->ids.capacity()*sizeof(std::pair<int,long>);
+        job->result = t;
+    }
+    catch(const std::exception& e)
+    {
+        job->error = e.what();
+    }
+    catch(...)
+    {
+        job->error = "unknown error";
+    }
+}
+
+void ogr_streaming_vector_layer::tile_ready(const boost::shared_ptr<fetch_job>& job)
+{
+    m_pending.erase(job->key);
+    if(!job->error.empty())
+    {
+        GILVIEWER_LOG_ERROR("[ogr_streaming_vector_layer] " << filename() << ": " << job->error);
+        return;
+    }
+    if(!job->result)
+        return;
+    m_lru.push_front(job->result);
+    m_tiles[job->key] = m_lru.begin();
+    m_cached_bytes += job->result->bytes;
+    if(m_wanted.count(job->key))
+    {
+        // Drawn by the next paint (see panel_viewer::on_idle)
+        m_visible.push_back(job->result);
+        invalidate_cache();
+        content_changed();
+    }
+    evict();
+}
+
+void ogr_streaming_vector_layer::cancel_fetches()
+{
+    m_token.cancel();
+    m_token = thread_pool::cancellation_token();
+    m_pending.clear();
+}
+
+void ogr_streaming_vector_layer::evict()
+{
+    std::set<tile_key> visible;
+    for(unsigned int i=0;i<m_visible.size();++i)
+        visible.insert(m_visible[i]->key);
+
+    std::list<tile_ptr>::iterator it = m_lru.end();
+    while(m_cached_bytes>m_cache_size && it!=m_lru.begin())
+    {
+        --it;
+        if(visible.count((*it)->key)) continue;
+        m_cached_bytes -= (*it)->bytes;
+        m_tiles.erase((*it)->key);
+        it = m_lru.erase(it);
+    }
+    if(m_cached_bytes>m_cache_size)
+        GILVIEWER_LOG_WARNING("[ogr_streaming_vector_layer] the features of the viewport do not fit in the cache budget (" << m_cached_bytes << " > " << m_cache_size << " bytes)")
+}
+
+void ogr_streaming_vector_layer::draw_geometries(wxDC &dc) const
+{
+    wxPen point_pen(m_point_color,m_point_width);
+    wxPen line_pen(m_line_color,m_line_width,m_line_style);
+    wxPen polygon_pen(m_polygon_border_color,m_polygon_border_width,m_polygon_border_style);
+    wxBrush polygon_brush(m_polygon_inner_color,m_polygon_inner_style);
+
+    // Aggregated points (see point_rendering) are counted over all the tiles, after the other features
+    bool aggregated = m_point_rendering!=POINTS_ALL;
+    std::vector<const bbox_rtree*> point_indices;
+    ogr_flat_geometries::draw_buffer buffer;
+    // A feature crossing several tiles is returned for each of them: draw it only once
+    std::set< std::pair<int,long> > drawn;
+    for(unsigned int i=0;i<m_visible.size();++i)
+    {
+        const tile& t = *m_visible[i];
+        const ogr_flat_geometries::lod_type::level *level = t.lod.select(transform().zoom_factor());
+        if(aggregated)
+            point_indices.push_back(&t.geometries.point_index());
+        for(std::size_t j=0;j<t.geometries.size();++j)
+        {
+            if(aggregated && ogr_flat_geometries::is_point(t.geometries.type(j)))
+                continue;
+            if(m_visible.size()>1 && t.ids[j].second!=OGRNullFID && !drawn.insert(t.ids[j]).second)
+                continue;
+            t.geometries.draw_feature(dc,transform(),j,point_pen,line_pen,polygon_pen,polygon_brush,buffer,level);
+        }
+    }
+    buffer.flush(dc);
+    if(aggregated)
+    {
+        dc.SetPen(point_pen);
+        draw_points(dc, point_indices);
+    }
+}
+
+bool ogr_streaming_vector_layer::snap( eSNAP snap, double d2[], const wxRealPoint& p, wxRealPoint& psnap )
+{
+    bool snapped = false;
+    for(unsigned int i=0;i<m_visible.size();++i)
+        if(m_visible[i]->geometries.snap(transform(),snap,d2,p,psnap)) snapped = true;
+    return snapped;
+}
+
+void ogr_streaming_vector_layer::screen_segments( const bbox_rtree::box& window, std::vector<segment_type>& segments ) const
+{
+    // Features crossing several tiles give duplicated segments: they do not create spurious intersections
+    bbox_rtree::box local = local_box(window);
+    for(unsigned int i=0;i<m_visible.size();++i)
+        m_visible[i]->geometries.screen_segments(transform(), local, segments);
+}
+
+void ogr_streaming_vector_layer::clear()
+{
+    cancel_fetches();
+    m_wanted.clear();
+    m_visible.clear();
+    m_tiles.clear();
+    m_lru.clear();
+    m_cached_bytes = 0;
+    invalidate_cache();
+    content_changed();
+}
+
+std::size_t ogr_streaming_vector_layer::memory_size() const
+{
+    return vector_layer::memory_size() + m_cached_bytes;
+}
+
+void ogr_streaming_vector_layer::release_memory()
+{
+    vector_layer::release_memory();
+    clear();
+    needs_update(true);
+}
+
+layer_settings_control* ogr_streaming_vector_layer::build_layer_settings_control(unsigned int index, layer_control* parent)
+{
+    return new vector_layer_settings_control(index, parent);
+}
+
+string ogr_streaming_vector_layer::available_formats_wildcard() const
+{
+    return gilviewer_utils::build_wx_wildcard_from_io_factory("Vector","GDAL");
+}
+
+void ogr_streaming_vector_layer::build_infos()
+{
+    ostringstream oss;
+    oss << "Streaming mode (features are read on demand)" << std::endl;
+    OGRDataSource *datasource = m_source->datasource;
+    OGRSpatialReference *spatial_reference = datasource->GetLayerCount()>0 ? datasource->GetLayer(0)->GetSpatialRef() : NULL;
+    if(spatial_reference)
+    {
+        // If the layer has a spatial reference, y coordinates must be inverted
+        transform().coordinates(-1);
+        if(spatial_reference->IsGeographic())
+            oss << "Geographic system" << std::endl;
+        if(spatial_reference->IsLocal())
+            oss << "Local system" << std::endl;
+        if(spatial_reference->IsProjected())
+            oss << "Projected system" << std::endl;
+        oss << "-------------------" << std::endl;
+    }
+    oss << "# Features = " << m_feature_count << std::endl;
+    oss << "Extent = [" << m_min_x << "," << m_max_x << "] x [" << m_min_y << "," << m_max_y << "]" << std::endl;
+    oss << "Cache budget = " << m_cache_size/(1024*1024) << " MB" << std::endl;
+    m_infos = oss.str();
+}
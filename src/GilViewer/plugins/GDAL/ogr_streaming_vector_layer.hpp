@@ -0,0 +1,186 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage:
+
+        http://code.google.com/p/gilviewer
+
+Copyright:
+
+        Institut Geographique National (2009)
+
+Authors:
+
+        Olivier Tournaire, Adrien Chauve
+
+
+
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+#ifndef OGR_STREAMING_VECTOR_LAYER_HPP
+#define OGR_STREAMING_VECTOR_LAYER_HPP
+
+#include "GilViewer/layers/vector_layer.hpp"
+
+#include <list>
+#include <map>
+#include <set>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "GilViewer/tools/thread_pool.hpp"
+
+#include "ogr_flat_geometries.hpp"
+
+class layer_settings_control;
+
+class OGRDataSource;
+
+/**
+ * @brief Vector layer reading an OGR datasource on demand.
+ *
+ * Opening the layer only reads the extent and the number of features. The datasource is kept open and,
+ * on each update, the missing tiles intersecting the viewport are read with a spatial filter by the thread_pool:
+ * each tile is drawn as soon as it is read. A tile holds at most max_tile_features features (sampled evenly when
+ * zoomed out on dense data) and a ninth of the memory budget, so that the 3x3 tiles of a view fit in the budget.
+ * Tiles are kept in a LRU cache bounded by the budget, so that panning or zooming back to a previously seen area
+ * does not hit the disk again.
+ **/
+class ogr_streaming_vector_layer : public vector_layer
+{
+public:
+    /// @param cache_size Memory budget of the features cache, in bytes
+    ogr_streaming_vector_layer(const std::string &layer_name, const std::string &filename, std::size_t cache_size=256*1024*1024);
+    virtual ~ogr_streaming_vector_layer();
+
+    /// Returns the total number of features of the datasource (-1 if the datasource cannot be opened)
+    static long feature_count(const std::string &filename);
+
+    /// Reads the tiles covering the view
+    virtual void update(int width, int height);
+
+    virtual std::string available_formats_wildcard() const;
+    virtual bool saveable() const {return false;}
+
+    virtual layer_settings_control* build_layer_settings_control(unsigned int index, layer_control* parent);
+
+    inline virtual double center_x() {return (m_min_x+m_max_x)/2.;}
+    inline virtual double center_y() {return (m_min_y+m_max_y)/2.;}
+
+    long feature_count() const { return m_feature_count; }
+
+    void cache_size(std::size_t s) { m_cache_size=s; }
+    std::size_t cache_size() const { return m_cache_size; }
+    /// Maximum number of features read per tile: denser tiles are sampled (tiles already read are kept)
+    void max_tile_features(std::size_t n) { m_max_tile_features=n; }
+    std::size_t max_tile_features() const { return m_max_tile_features; }
+
+    virtual bool snap( eSNAP snap, double d2[], const wxRealPoint& p, wxRealPoint& psnap );
+    virtual void screen_segments( const bbox_rtree::box& window, std::vector<segment_type>& segments ) const;
+
+    virtual void clear();
+
+    /// Only the tiles of the current view are read: the features are not available through the accessors
+    virtual bool geometry_accessors() const { return false; }
+
+    /// Cached tiles and raster
+    virtual std::size_t memory_size() const;
+    /// Drops all the tiles: they are read again by the next update
+    virtual void release_memory();
+
+protected:
+    virtual void draw_geometries(wxDC &dc) const;
+
+private:
+    struct tile_key
+    {
+        int level, ix, iy;
+        bool operator<(const tile_key& k) const;
+    };
+
+    struct tile
+    {
+        tile_key key;
+        ogr_flat_geometries geometries;
+        /// Levels of detail of the geometries: tiles are read when zoomed out, so they are simplified right away
+        ogr_flat_geometries::lod_type lod;
+        /// (OGR layer, FID) of each feature of the tile
+        std::vector< std::pair<int,long> > ids;
+        std::size_t bytes;
+    };
+    typedef boost::shared_ptr<tile> tile_ptr;
+
+    /// Datasource shared with the reading tasks, which may outlive the layer. OGR is not thread-safe: the tasks read it in turn.
+    struct source
+    {
+        source() : datasource(NULL) {}
+        ~source();
+        boost::mutex mutex;
+        OGRDataSource *datasource;
+    };
+
+    /// Reading of a tile by a worker. Everything but the result is set by the GUI thread before submitting it.
+    struct fetch_job
+    {
+        thread_pool::cancellation_token token;
+        boost::shared_ptr<source> src;
+        tile_key key;
+        /// Window of the spatial filter (none if the extent is degenerated)
+        double x0, y0, size;
+        bool filter;
+        /// Expected number of features of the tile, used when the datasource cannot count them quickly
+        double expected;
+        std::size_t max_features, max_bytes;
+        /// Written by the worker, read by the continuation
+        tile_ptr result;
+        std::string error;
+    };
+
+    /// Returns the tile from the cache, or a null pointer after submitting its reading (see tile_ready)
+    tile_ptr fetch(const tile_key& key);
+    /// Runs in a worker thread
+    static void read_tile(const boost::shared_ptr<fetch_job>& job);
+    /// Continuation of the reading, run by the GUI thread: caches the tile and shows it if it is still in view
+    void tile_ready(const boost::shared_ptr<fetch_job>& job);
+    /// Removes the least recently used tiles out of the view until the cache fits in the memory budget
+    void evict();
+    /// Cancels the readings in progress
+    void cancel_fetches();
+    void build_infos();
+
+    boost::shared_ptr<source> m_source;
+    long m_feature_count;
+    double m_min_x, m_min_y, m_max_x, m_max_y;
+
+    std::size_t m_cache_size, m_cached_bytes, m_max_tile_features;
+    /// Most recently used tiles first
+    std::list<tile_ptr> m_lru;
+    std::map<tile_key, std::list<tile_ptr>::iterator> m_tiles;
+    /// Tiles covering the viewport at the last update, and those of them already read
+    std::set<tile_key> m_wanted;
+    std::vector<tile_ptr> m_visible;
+    /// Tiles being read, and the token shared by their jobs
+    std::set<tile_key> m_pending;
+    thread_pool::cancellation_token m_token;
+};
+
+#endif // OGR_STREAMING_VECTOR_LAYER_HPP
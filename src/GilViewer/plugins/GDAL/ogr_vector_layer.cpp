@@ -39,8 +39,9 @@ Authors:
 #include "ogr_vector_layer.hpp"
 
 #include <boost/filesystem.hpp>
-#include <boost/variant/detail/apply_visitor_unary.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <sstream>
 
@@ -51,21 +52,11 @@ Authors:
 #include "GilViewer/convenient/macros_gilviewer.hpp"
 #include "GilViewer/convenient/utils.hpp"
 
-#include "draw_geometry_visitor.hpp"
-#include "get_geometry_visitor.hpp"
-
 using namespace std;
 using namespace boost::filesystem;
 
 ogr_vector_layer::ogr_vector_layer(const string &layer_name, const string &filename_): vector_layer(),
-m_nb_geometries(0),
-m_nb_linear_rings(0),
-m_nb_line_strings(0),
-m_nb_multiline_strings(0),
-m_nb_multipoints(0),
-m_nb_points(0),
-m_nb_multipolygons(0),
-m_nb_polygons(0)
+m_bulk_loading(true), m_center_x(0.), m_center_y(0.)
 {
     name(layer_name);
     filename( system_complete(filename_).string() );
@@ -84,97 +75,36 @@ m_nb_polygons(0)
             throw invalid_argument(error_message.c_str());
         }
 
+        OGRSpatialReference *spatref = NULL;
         for(int i=0;i<poDS->GetLayerCount();++i)
         {
             OGRLayer *poLayer = poDS->GetLayer(i);
 
             // TODO: handle spatial reference
-            OGRSpatialReference *spatref = poLayer->GetSpatialRef();
-
-            // TODO: compute extent to get center
-            compute_center(poLayer,poDS->GetLayerCount());
+            if(!spatref)
+                spatref = poLayer->GetSpatialRef();
 
-            // TODO: read features
+            // Geometries are copied to the flat arrays and attributes to the columnar table: features are not kept
             OGRFeature *poFeature;
-
             poLayer->ResetReading();
             while( (poFeature = poLayer->GetNextFeature()) != NULL )
             {
-                // TODO: read fields
-                /*
-                OGRFeatureDefn *poFDefn = poLayer->GetLayerDefn();
-                for( iField = 0; iField < poFDefn->GetFieldCount(); iField++ )
-                {
-                    OGRFieldDefn *poFieldDefn = poFDefn->GetFieldDefn( iField );
-
-                    if( poFieldDefn->GetType() == OFTInteger )
-                        printf( "%d,", poFeature->GetFieldAsInteger( iField ) );
-                    else if( poFieldDefn->GetType() == OFTReal )
-                        printf( "%.3f,", poFeature->GetFieldAsDouble(iField) );
-                    else if( poFieldDefn->GetType() == OFTString )
-                        printf( "%s,", poFeature->GetFieldAsString(iField) );
-                    else
-                        printf( "%s,", poFeature->GetFieldAsString(iField) );
-                }
-                */
-                if(OGRLinearRing *poLine = dynamic_cast<OGRLinearRing*>(poFeature->GetGeometryRef()) )
-                {
-                    m_geometries_features.push_back(std::make_pair<OGRLinearRing*,OGRFeature*>(poLine,poFeature));
-                    m_nb_geometries+=poLine->getNumPoints();
-                    ++m_nb_linear_rings;
-                }
-                else if(OGRLineString *poLine = dynamic_cast<OGRLineString*>(poFeature->GetGeometryRef()) )
-                {
-                    m_geometries_features.push_back(std::make_pair<OGRLineString*,OGRFeature*>(poLine,poFeature));
-                    m_nb_geometries+=poLine->getNumPoints();
-                    ++m_nb_line_strings;
-                }
-                else if(OGRMultiLineString* poMLine = dynamic_cast<OGRMultiLineString*>(poFeature->GetGeometryRef()))
-                {
-                    m_geometries_features.push_back(std::make_pair<OGRMultiLineString*,OGRFeature*>(poMLine,poFeature));
-                    for(int i=0;i<poMLine->getNumGeometries();++i)
-                        m_nb_geometries+=((OGRLineString*)(poMLine->getGeometryRef(i)))->getNumPoints();
-                    ++m_nb_multiline_strings;
-                }
-                else if(OGRMultiPoint* poMPoint = dynamic_cast<OGRMultiPoint*>(poFeature->GetGeometryRef()))
-                {
-                    m_geometries_features.push_back(std::make_pair<OGRMultiPoint*,OGRFeature*>(poMPoint,poFeature));
-                    m_nb_geometries+=poMPoint->getNumGeometries();
-                    ++m_nb_multipoints;
-                }
-                else if(OGRMultiPolygon* poMPolygon = dynamic_cast<OGRMultiPolygon*>(poFeature->GetGeometryRef()))
-                {
-                    m_geometries_features.push_back(std::make_pair<OGRMultiPolygon*,OGRFeature*>(poMPolygon,poFeature));
-                    for(int i=0;i<poMLine->getNumGeometries();++i)
-                    {
-                        OGRPolygon* one_polygon =(OGRPolygon*)(poMPolygon->getGeometryRef(i));
-                        m_nb_geometries+=one_polygon->getExteriorRing()->getNumPoints();
-                        for(int i=0;i<one_polygon->getNumInteriorRings();++i)
-                            m_nb_geometries+=one_polygon->getInteriorRing(i)->getNumPoints();
-                    }
-                    ++m_nb_multipolygons;
-                }
-                else if( OGRPoint *poPoint = dynamic_cast<OGRPoint*>(poFeature->GetGeometryRef()) )
-                {
-                    m_geometries_features.push_back(std::make_pair<OGRPoint*,OGRFeature*>(poPoint,poFeature));
-                    ++m_nb_geometries;
-                    ++m_nb_points;
-                }
-                else if(OGRPolygon *poPolygon = dynamic_cast<OGRPolygon*>(poFeature->GetGeometryRef()))
+                if(m_geometries.append(poFeature->GetGeometryRef()))
                 {
-                    m_geometries_features.push_back(std::make_pair<OGRPolygon*,OGRFeature*>(poPolygon,poFeature));
-                    m_nb_geometries+=poPolygon->getExteriorRing()->getNumPoints();
-                    for(int i=0;i<poPolygon->getNumInteriorRings();++i)
-                        m_nb_geometries+=poPolygon->getInteriorRing(i)->getNumPoints();
-                    ++m_nb_polygons;
+                    m_attributes.append(poFeature);
+                    index_last_feature();
                 }
+                OGRFeature::DestroyFeature(poFeature);
             }
-            build_infos(spatref);
         }
+        build_index();
+        compute_center();
+        build_infos(spatref);
         OGRDataSource::DestroyDataSource( poDS );
     }
     catch(const exception &e)
     {
+        m_bulk_loading = false;
         GILVIEWER_LOG_EXCEPTION("[Exception propagated]")
                 throw logic_error(e.what());
     }
@@ -182,35 +112,148 @@ m_nb_polygons(0)
 
 ogr_vector_layer::~ogr_vector_layer()
 {
-    for(unsigned int i=0;i<m_geometries_features.size();++i)
-        OGRFeature::DestroyFeature(m_geometries_features[i].second);
+    stop_lod();
+}
+
+void ogr_vector_layer::index_last_feature()
+{
+    invalidate_cache();
+    content_changed();
+    size_t f = m_geometries.size()-1;
+    switch(m_geometries.type(f))
+    {
+    case ogr_flat_geometries::POINT:
+        m_point_rings.push_back(m_geometries.ring_begin(m_geometries.part_begin(f)));
+        break;
+    case ogr_flat_geometries::POLYGON:
+    case ogr_flat_geometries::MULTI_POLYGON:
+        m_polygon_features.push_back(f);
+        break;
+    case ogr_flat_geometries::LINE_STRING:
+    case ogr_flat_geometries::MULTI_LINE_STRING:
+        for(size_t part=m_geometries.part_begin(f);part<m_geometries.part_end(f);++part)
+            m_polyline_rings.push_back(m_geometries.ring_begin(part));
+        break;
+    default:
+        break;
+    }
+    if(!m_bulk_loading)
+    {
+        bbox_rtree::box b = m_geometries.bounding_box(f);
+        if(!b.empty())
+            m_index.insert(b, static_cast<unsigned int>(f));
+    }
+}
+
+void ogr_vector_layer::build_index()
+{
+    vector<bbox_rtree::entry> entries;
+    entries.reserve(m_geometries.size());
+    for(size_t f=0;f<m_geometries.size();++f)
+    {
+        bbox_rtree::box b = m_geometries.bounding_box(f);
+        if(!b.empty())
+            entries.push_back(bbox_rtree::entry(b, static_cast<unsigned int>(f)));
+    }
+    m_index.bulk_load(entries);
+    m_bulk_loading = false;
+    reset_lod();
+}
+
+void ogr_vector_layer::build_lod() const
+{
+    boost::shared_ptr<ogr_flat_geometries::lod_type> lod(new ogr_flat_geometries::lod_type);
+    m_geometries.build_lod(*lod);
+    boost::mutex::scoped_lock lock(m_lod_mutex);
+    m_lod = lod;
+}
+
+void ogr_vector_layer::reset_lod()
+{
+    invalidate_lod();
+    boost::mutex::scoped_lock lock(m_lod_mutex);
+    m_lod.reset();
 }
 
-void ogr_vector_layer::draw(wxDC &dc, wxCoord x, wxCoord y, bool transparent) const
+void ogr_vector_layer::draw_geometries(wxDC &dc) const
 {
     wxPen point_pen(m_point_color,m_point_width);
     wxPen line_pen(m_line_color,m_line_width,m_line_style);
     wxPen polygon_pen(m_polygon_border_color,m_polygon_border_width,m_polygon_border_style);
     wxBrush polygon_brush(m_polygon_inner_color,m_polygon_inner_style);
 
-    /// Geometries
-    draw_geometry_visitor visitor(dc,point_pen,line_pen,polygon_pen,polygon_brush,x,y,transparent,transform());
-    for(unsigned int i=0;i<m_geometries_features.size();++i)
-        boost::apply_visitor( visitor, m_geometries_features[i].first );
-
-    /// Texts
-    if(text_visibility())
+    /// Geometries intersecting the viewport (grown by the pen widths), in drawing order
+    int width = std::max(m_point_width, std::max(m_line_width, m_polygon_border_width));
+    vector<unsigned int> ids;
+    m_index.query(local_viewport(dc, width+1), ids);
+    std::sort(ids.begin(), ids.end());
+    // When zoomed out, the simplified rings are drawn
+    update_lod();
+    boost::shared_ptr<const ogr_flat_geometries::lod_type> lod;
     {
-        wxPen text_pen;
-        text_pen.SetColour(m_text_color);
-        dc.SetPen(text_pen);
-        for(unsigned int i=0;i<m_texts.size();++i)
-        {
-            wxPoint p = transform().from_local_int( m_texts[i].first);
-            //dc.DrawLine(p);
-            dc.DrawText(wxString(m_texts[i].second.c_str(),*wxConvCurrent),p);
-        }
+        boost::mutex::scoped_lock lock(m_lod_mutex);
+        lod = m_lod;
     }
+    const ogr_flat_geometries::lod_type::level *level = lod ? lod->select(transform().zoom_factor()) : 0;
+    // Aggregated points (see point_rendering) are drawn after the other features, from their own index
+    bool aggregated = m_point_rendering!=POINTS_ALL;
+    ogr_flat_geometries::draw_buffer buffer;
+    for(size_t i=0;i<ids.size();++i)
+        if(!aggregated || !ogr_flat_geometries::is_point(m_geometries.type(ids[i])))
+            m_geometries.draw_feature(dc,transform(),ids[i],point_pen,line_pen,polygon_pen,polygon_brush,buffer,level);
+    buffer.flush(dc);
+    if(aggregated)
+    {
+        dc.SetPen(point_pen);
+        draw_points(dc, m_geometries.point_index());
+    }
+}
+
+void ogr_vector_layer::draw_texts(wxDC &dc) const
+{
+    // Texts extend to the right of their anchor: keep a wider margin
+    std::vector<unsigned int> ids;
+    m_text_index.query(local_viewport(dc, 256), ids);
+    std::sort(ids.begin(), ids.end());
+    m_label_engine.begin(dc, m_text_color);
+    for(size_t i=0;i<ids.size();++i)
+        m_label_engine.draw(dc, ids[i], transform().from_local_int(m_texts[ids[i]].first), m_texts[ids[i]].second);
+}
+
+bool ogr_vector_layer::snap( eSNAP snap, double d2[], const wxRealPoint& p, wxRealPoint& psnap )
+{
+    return m_geometries.snap(transform(),snap,d2,p,psnap);
+}
+
+void ogr_vector_layer::screen_segments( const bbox_rtree::box& window, std::vector<segment_type>& segments ) const
+{
+    m_geometries.screen_segments(transform(), local_box(window), segments);
+}
+
+long ogr_vector_layer::hit_test(const wxRealPoint& p, double tolerance) const
+{
+    // Only the features whose bounding box is within the tolerance are tested, topmost first
+    wxRealPoint q = transform().to_local(p);
+    double zoom = transform().zoom_factor();
+    bbox_rtree::box window(q.x, q.y, q.x, q.y);
+    window.inflate(tolerance*zoom);
+    vector<unsigned int> ids;
+    m_index.query(window, ids);
+    std::sort(ids.begin(), ids.end());
+    for(size_t i=ids.size();i-->0;)
+        if(m_geometries.hit(ids[i], q, tolerance*tolerance*zoom*zoom))
+            return static_cast<long>(ids[i]);
+    return -1;
+}
+
+string ogr_vector_layer::pixel_value(const wxRealPoint& p) const
+{
+    if(m_attributes.columns().empty())
+        return string();
+    long f = hit_test(p);
+    if(f<0 || static_cast<size_t>(f)>=m_attributes.size())
+        return string();
+    return m_attributes.row_to_string(static_cast<size_t>(f));
 }
 
 layer_settings_control* ogr_vector_layer::build_layer_settings_control(unsigned int index, layer_control* parent)
@@ -218,13 +261,13 @@ layer_settings_control* ogr_vector_layer::build_layer_settings_control(unsigned
     return new vector_layer_settings_control(index, parent);
 }
 
-void ogr_vector_layer::compute_center(OGRLayer* layer, int nb_layers)
+void ogr_vector_layer::compute_center()
 {
-    static double ratio=1./(double)nb_layers;
-    OGREnvelope env;
-    layer->GetExtent(&env);
-    m_center_x+=ratio*(env.MaxX+env.MinX)/2.;
-    m_center_y+=ratio*(env.MaxY+env.MinY)/2.;
+    double min_x, min_y, max_x, max_y;
+    if(!m_geometries.extent(min_x, min_y, max_x, max_y))
+        return;
+    m_center_x = (min_x+max_x)/2.;
+    m_center_y = (min_y+max_y)/2.;
 }
 
 void ogr_vector_layer::build_infos(OGRSpatialReference *spatial_reference)
@@ -253,13 +296,15 @@ void ogr_vector_layer::build_infos(OGRSpatialReference *spatial_reference)
     {
         GILVIEWER_LOG_MESSAGE( "No spatial reference defined for file " << filename() );
     }
-    oss << "# Linear rings = " << m_nb_linear_rings << std::endl;
-    oss << "# Line strings = " << m_nb_line_strings << std::endl;
-    oss << "# Multiline strings = " << m_nb_multiline_strings << std::endl;
-    oss << "# Multi points = " << m_nb_multipoints << std::endl;
-    oss << "# Points = " << m_nb_points << std::endl;
-    oss << "# Multi polygons = " << m_nb_multipolygons << std::endl;
-    oss << "# Polygons = " << m_nb_polygons << std::endl;
+    oss << "# Linear rings = " << m_geometries.size(ogr_flat_geometries::LINEAR_RING) << std::endl;
+    oss << "# Line strings = " << m_geometries.size(ogr_flat_geometries::LINE_STRING) << std::endl;
+    oss << "# Multiline strings = " << m_geometries.size(ogr_flat_geometries::MULTI_LINE_STRING) << std::endl;
+    oss << "# Multi points = " << m_geometries.size(ogr_flat_geometries::MULTI_POINT) << std::endl;
+    oss << "# Points = " << m_geometries.size(ogr_flat_geometries::POINT) << std::endl;
+    oss << "# Multi polygons = " << m_geometries.size(ogr_flat_geometries::MULTI_POLYGON) << std::endl;
+    oss << "# Polygons = " << m_geometries.size(ogr_flat_geometries::POLYGON) << std::endl;
+    oss << "# Vertices = " << m_geometries.nb_coordinates() << std::endl;
+    oss << "# Attributes = " << m_attributes.columns().size() << std::endl;
     m_infos = oss.str();
 }
 
@@ -268,17 +313,12 @@ string ogr_vector_layer::available_formats_wildcard() const
     return gilviewer_utils::build_wx_wildcard_from_io_factory("Vector","GDAL");
 }
 
-const std::vector<std::pair<geometry_types,OGRFeature*> >& ogr_vector_layer::geometries_features() const {return m_geometries_features;}
-
-std::vector<std::pair<geometry_types,OGRFeature*> >& ogr_vector_layer::geometries_features() {return m_geometries_features;}
-
 void ogr_vector_layer::add_point( double x , double y )
 {
-    OGRFeature *poFeature = new OGRFeature(new OGRFeatureDefn);
-    OGRPoint* p= new OGRPoint(x,y);
-    poFeature->SetGeometry(p);
-    m_geometries_features.push_back(std::make_pair<OGRPoint*,OGRFeature*>(p,poFeature));
-    ++m_nb_geometries;
+    reset_lod();
+    m_geometries.append(ogr_flat_geometries::POINT, vector<double>(1,x), vector<double>(1,y));
+    m_attributes.append();
+    index_last_feature();
 }
 
 void ogr_vector_layer::add_text( double x , double y , const std::string &text , const wxColour &color)
@@ -286,53 +326,87 @@ void ogr_vector_layer::add_text( double x , double y , const std::string &text ,
     internal_point_type pt;
     pt.x=x; pt.y=y;
     m_texts.push_back( make_pair<internal_point_type,string>(pt,text) );
+    invalidate_cache();
+    content_changed();
+    m_text_index.insert(bbox_rtree::box(x,y,x,y), static_cast<unsigned int>(m_texts.size()-1));
 }
 
 void ogr_vector_layer::add_line( double x1 , double y1 , double x2 , double y2 )
 {
-    OGRFeature *poFeature = new OGRFeature(new OGRFeatureDefn);
-    OGRLineString* l= new OGRLineString();
-    l->addPoint(x1,y1);
-    l->addPoint(x2,y2);
-    poFeature->SetGeometry(l);
-    m_geometries_features.push_back(std::make_pair<OGRLineString*,OGRFeature*>(l,poFeature));
-    m_nb_geometries+=2;
+    vector<double> x(2), y(2);
+    x[0]=x1; y[0]=y1;
+    x[1]=x2; y[1]=y2;
+    add_polyline(x,y);
 }
 
 void ogr_vector_layer::add_polyline( const std::vector<double> &x , const std::vector<double> &y )
 {
-    OGRFeature *poFeature = new OGRFeature(new OGRFeatureDefn);
-    OGRLineString* l= new OGRLineString();
-    for(unsigned int i=0;i<x.size();++i)
-        l->addPoint(x[i],y[i]);
-    poFeature->SetGeometry(l);
-    m_geometries_features.push_back(std::make_pair<OGRLineString*,OGRFeature*>(l,poFeature));
-    m_nb_geometries+=x.size();
+    reset_lod();
+    m_geometries.append(ogr_flat_geometries::LINE_STRING, x, y);
+    m_attributes.append();
+    index_last_feature();
 }
 
 void ogr_vector_layer::add_polygon( const std::vector<double> &x , const std::vector<double> &y )
 {
-    OGRFeature *poFeature = new OGRFeature(new OGRFeatureDefn);
-    OGRPolygon* p= new OGRPolygon();
-    OGRLinearRing* l = new OGRLinearRing();
-    for(unsigned int i=0;i<x.size();++i)
-        l->addPoint(x[i],y[i]);
-    p->addRing(l);
-    p->closeRings();
-    poFeature->SetGeometry(p);
-    m_geometries_features.push_back(std::make_pair<OGRPolygon*,OGRFeature*>(p,poFeature));
-    m_nb_geometries+=x.size();
+    reset_lod();
+    m_geometries.append(ogr_flat_geometries::POLYGON, x, y);
+    m_attributes.append();
+    index_last_feature();
+}
+
+void ogr_vector_layer::add_points( const double *x , const double *y , std::size_t n )
+{
+    append_features(ogr_flat_geometries::POINT, x, y, 0, n);
+}
+
+void ogr_vector_layer::add_polylines( const double *x , const double *y , const std::size_t *offsets , std::size_t n )
+{
+    append_features(ogr_flat_geometries::LINE_STRING, x, y, offsets, n);
+}
+
+void ogr_vector_layer::add_polygons( const double *x , const double *y , const std::size_t *offsets , std::size_t n )
+{
+    append_features(ogr_flat_geometries::POLYGON, x, y, offsets, n);
+}
+
+void ogr_vector_layer::append_features(ogr_flat_geometries::feature_type type, const double *x , const double *y , const std::size_t *offsets , std::size_t n)
+{
+    if(n==0)
+        return;
+    reset_lod();
+    // A large batch is reserved and indexed in bulk, a small one is appended and indexed incrementally
+    m_bulk_loading = n>=m_index.size();
+    if(m_bulk_loading)
+    {
+        // Polygon rings may be closed by an extra coordinate
+        std::size_t nb_coordinates = offsets ? offsets[n]-offsets[0] : n;
+        if(type==ogr_flat_geometries::POLYGON)
+            nb_coordinates += n;
+        m_geometries.reserve(m_geometries.size()+n, m_geometries.nb_coordinates()+nb_coordinates);
+    }
+    m_attributes.append(n);
+    for(std::size_t i=0;i<n;++i)
+    {
+        if(offsets)
+            m_geometries.append(type, x+offsets[i], y+offsets[i], offsets[i+1]-offsets[i]);
+        else
+            m_geometries.append(type, x+i, y+i, 1);
+        index_last_feature();
+    }
+    if(m_bulk_loading)
+        build_index();
 }
 
 void ogr_vector_layer::add_circle( double x , double y , double radius )
 {
-    OGRFeature *poFeature = new OGRFeature(new OGRFeatureDefn);
-    OGRLineString* l= new OGRLineString();
+    vector<double> cx(361), cy(361);
     for(unsigned int i=0;i<=360;++i)
-        l->addPoint(x+radius*cos((double)i*3.1415/180.),y+radius*sin((double)i*3.1415/180.));
-    poFeature->SetGeometry(l);
-    m_geometries_features.push_back(std::make_pair<OGRLineString*,OGRFeature*>(l,poFeature));
-    m_nb_geometries+=l->getNumPoints();
+    {
+        cx[i] = x+radius*cos((double)i*3.1415/180.);
+        cy[i] = y+radius*sin((double)i*3.1415/180.);
+    }
+    add_polyline(cx,cy);
 }
 
 void ogr_vector_layer::add_spline( std::vector<std::pair<double, double> > points )
@@ -350,116 +424,72 @@ void ogr_vector_layer::add_ellipse(double x_center, double y_center, double a, d
     cout << "Not implemented!!! (" << __FUNCTION__ << ")" << endl;
 }
 
+std::size_t ogr_vector_layer::memory_size() const
+{
+    std::size_t bytes = vector_layer::memory_size() + m_geometries.memory();
+    boost::mutex::scoped_lock lock(m_lod_mutex);
+    if(m_lod)
+        bytes += m_lod->memory();
+    return bytes;
+}
+
 void ogr_vector_layer::clear()
 {
-    m_geometries_features.clear();
-    m_texts.clear();
-    vector<pair<geometry_types,OGRFeature*> >().swap(m_geometries_features);
+    reset_lod();
+    invalidate_cache();
+    content_changed();
+    m_geometries.clear();
+    m_attributes.clear();
+    m_index.clear();
+    m_text_index.clear();
+    vector<unsigned int>().swap(m_polygon_features);
+    vector<unsigned int>().swap(m_point_rings);
+    vector<unsigned int>().swap(m_polyline_rings);
     vector< pair< internal_point_type , string > >().swap(m_texts);
+    m_label_engine.clear();
 }
 
-unsigned int ogr_vector_layer::num_polygons() const { return m_nb_polygons; }
-
-void ogr_vector_layer::get_polygon(unsigned int i, std::vector<double> &x , std::vector<double> &y ) const
+void ogr_vector_layer::get_ring(size_t ring, std::vector<double> &x , std::vector<double> &y ) const
 {
-    get_geometry_visitor<OGRPolygon> getter;
-    getter.m_geometries.reserve(m_nb_polygons);
-
-    for(unsigned int j=0;j<m_geometries_features.size();++j)
-        boost::apply_visitor( getter, m_geometries_features[j].first );
-
-    vector<OGRPolygon*>& p(getter.m_geometries);
-    for(int j=0; j<p[i]->getExteriorRing()->getNumPoints(); ++j)
+    for(size_t i=m_geometries.coord_begin(ring);i<m_geometries.coord_end(ring);++i)
     {
-        x.push_back(p[i]->getExteriorRing()->getX(j));
-        y.push_back(p[i]->getExteriorRing()->getY(j));
+        x.push_back(m_geometries.coordinate(i).x);
+        y.push_back(m_geometries.coordinate(i).y);
     }
 }
 
-unsigned int ogr_vector_layer::num_points() const { return m_nb_points; }
-void ogr_vector_layer::get_point(unsigned int i, double &x , double &y ) const
-{
-    get_geometry_visitor<OGRPoint> getter;
-    getter.m_geometries.reserve(m_nb_points);
-    for(unsigned int j=0;j<m_geometries_features.size();++j)
-        boost::apply_visitor( getter, m_geometries_features[j].first );
-    vector<OGRPoint*>& p(getter.m_geometries);
-    x = p[i]->getX();
-    y = p[i]->getY();
-}
+unsigned int ogr_vector_layer::num_polygons() const { return m_polygon_features.size(); }
 
-unsigned int ogr_vector_layer::num_polylines() const {
-    unsigned int res = m_nb_line_strings;
-    get_geometry_visitor<OGRMultiLineString> getter;
-    getter.m_geometries.reserve(m_nb_multiline_strings);
-    for(unsigned int j=0;j<m_geometries_features.size();++j)
-        boost::apply_visitor( getter, m_geometries_features[j].first );
-    vector<OGRMultiLineString*>& p(getter.m_geometries);
-    for(unsigned int j=0; j<p.size(); ++j)
-        res += p[j]->getNumGeometries();
-    return res;
+void ogr_vector_layer::get_polygon(unsigned int i, std::vector<double> &x , std::vector<double> &y ) const
+{
+    get_ring(m_geometries.ring_begin(m_geometries.part_begin(m_polygon_features[i])),x,y);
 }
 
-void ogr_vector_layer::get_polyline(unsigned int i, std::vector<double> &x , std::vector<double> &y ) const
+void ogr_vector_layer::get_polygon_rings(unsigned int i, std::vector<double> &x , std::vector<double> &y , std::vector<std::size_t> &ring_ends ) const
 {
-    if(i<m_nb_line_strings)
-    {
-        get_geometry_visitor<OGRLineString> getter;
-        getter.m_geometries.reserve(m_nb_line_strings);
-
-        for(unsigned int j=0;j<m_geometries_features.size();++j)
-            boost::apply_visitor( getter, m_geometries_features[j].first );
-
-        vector<OGRLineString*>& p(getter.m_geometries);
-        for(int j=0; j<p[i]->getNumPoints(); ++j)
+    size_t f = m_polygon_features[i];
+    for(size_t part=m_geometries.part_begin(f);part<m_geometries.part_end(f);++part)
+        for(size_t ring=m_geometries.ring_begin(part);ring<m_geometries.ring_end(part);++ring)
         {
-            x.push_back(p[i]->getX(j));
-            y.push_back(p[i]->getY(j));
+            get_ring(ring,x,y);
+            ring_ends.push_back(x.size());
         }
-    }
-    else
-    {
-        i-=m_nb_line_strings;
-        get_geometry_visitor<OGRMultiLineString> getter;
-        getter.m_geometries.reserve(m_nb_multiline_strings);
-
-        for(unsigned int j=0;j<m_geometries_features.size();++j)
-            boost::apply_visitor( getter, m_geometries_features[j].first );
-
-        vector<OGRMultiLineString*>& p(getter.m_geometries);
-        for(unsigned int j=0; j<p.size(); ++j)
-        {
-            unsigned int n = p[j]->getNumGeometries();
-            if(i<n)
-            {
-                OGRLineString *line = dynamic_cast<OGRLineString *>(p[j]->getGeometryRef(i));
-                if(!line)
-                {
-                    cout << "The geometry "<<i<<" of the OGRMultiLineString "<<j<<" is not an OGRLineString !!!" << endl;
-                    break;
-                }
-                else
-                {
-                    for(int k=0; k<line->getNumPoints(); ++k)
-                    {
-                        x.push_back(line->getX(k));
-                        y.push_back(line->getY(k));
-                    }
-                }
-                break;
-            }
-            i-=n;
-        }
-    }
 }
 
-/*
-void draw_geometry_visitor::operator()(OGRLinearRing* operand) const
-void draw_geometry_visitor::operator()(OGRMultiPoint* operand) const
-void draw_geometry_visitor::operator()(OGRMultiPolygon* operand) const
-*/
+unsigned int ogr_vector_layer::num_points() const { return m_point_rings.size(); }
 
+void ogr_vector_layer::get_point(unsigned int i, double &x , double &y ) const
+{
+    const ogr_flat_geometries::point_type& p = m_geometries.coordinate(m_geometries.coord_begin(m_point_rings[i]));
+    x = p.x;
+    y = p.y;
+}
 
+unsigned int ogr_vector_layer::num_polylines() const { return m_polyline_rings.size(); }
 
+void ogr_vector_layer::get_polyline(unsigned int i, std::vector<double> &x , std::vector<double> &y ) const
+{
+    get_ring(m_polyline_rings[i],x,y);
+}
 
 // TODO: notify, settings control, shared_ptr, IMAGE or GEOGRAPHIC coordinates ...
@@ -40,33 +40,15 @@ Authors:
 
 #include "GilViewer/layers/vector_layer.hpp"
 
-#include <boost/mpl/vector.hpp>
-#include <boost/variant/variant.hpp>
+#include "ogr_flat_geometries.hpp"
+#include "ogr_attribute_table.hpp"
 
 class layer_settings_control;
 
-class OGRGeometry;
-class OGRFeature;
-class OGRMultiLineString;
-class OGRLinearRing;
-class OGRLineString;
-class OGRMultiPoint;
-class OGRMultiPolygon;
-class OGRPoint;
-class OGRPolygon;
 class OGRSpatialReference;
-class OGRLayer;
 
 class wxColor;
 
-typedef boost::variant< OGRLinearRing*,
-                        OGRLineString*,
-                        OGRMultiLineString*,
-                        OGRMultiPoint*,
-                        OGRMultiPolygon*,
-                        OGRPoint*,
-                        OGRPolygon* > geometry_types;
-
 class ogr_vector_layer : public vector_layer
 {
 public:
@@ -74,13 +56,11 @@ public:
     ogr_vector_layer(const std::string &layer_name, const std::string &filename);
     /// Constructeur vide: pour creer un layer a remplir a la main ...
     ogr_vector_layer(const std::string &layer_name="default name"): vector_layer(),
-            m_nb_geometries(0) { m_name=layer_name;}
+            m_bulk_loading(false), m_center_x(0.), m_center_y(0.) { m_name=layer_name;}
     /// @param layerName Le nom du calque
     /// @param shapefileFileName Le chemin vers le fichier shapefile
     virtual ~ogr_vector_layer();
 
-    virtual void draw(wxDC &dc, wxCoord x, wxCoord y, bool transparent) const;
-    virtual void update(int, int) {}
 
     virtual std::string available_formats_wildcard() const;
 
@@ -89,9 +69,15 @@ public:
     inline virtual double center_x() {return m_center_x;}
     inline virtual double center_y() {return m_center_y;}
 
-    const std::vector<std::pair<geometry_types,OGRFeature*> >& geometries_features() const;
-    std::vector<std::pair<geometry_types,OGRFeature*> >& geometries_features();
+    /// Attributes of the feature under the cursor
+    virtual std::string pixel_value(const wxRealPoint& p) const;
+    virtual bool snap( eSNAP snap, double d2[], const wxRealPoint& p, wxRealPoint& psnap );
+    virtual void screen_segments( const bbox_rtree::box& window, std::vector<segment_type>& segments ) const;
+    /// Returns the index of the topmost feature under the screen point p, or -1
+    long hit_test(const wxRealPoint& p, double tolerance=3.) const;
 
+    const ogr_flat_geometries& geometries() const { return m_geometries; }
+    const ogr_attribute_table& attributes() const { return m_attributes; }
 
     virtual void add_point( double x , double y );
     virtual void add_text( double x , double y , const std::string &text , const wxColour &color = *wxRED );
@@ -102,9 +88,13 @@ public:
     virtual void add_spline( std::vector<std::pair<double, double> > points );
     virtual void add_ellipse(double x_center, double y_center, double a, double b);
     virtual void add_ellipse(double x_center, double y_center, double a, double b, double theta);
+    virtual void add_points( const double *x , const double *y , std::size_t n );
+    virtual void add_polylines( const double *x , const double *y , const std::size_t *offsets , std::size_t n );
+    virtual void add_polygons( const double *x , const double *y , const std::size_t *offsets , std::size_t n );
 
     virtual unsigned int num_polygons() const;
     virtual void get_polygon(unsigned int i, std::vector<double> &x , std::vector<double> &y ) const;
+    virtual void get_polygon_rings(unsigned int i, std::vector<double> &x , std::vector<double> &y , std::vector<std::size_t> &ring_ends ) const;
     virtual unsigned int num_points() const;
     virtual void get_point(unsigned int i, double &x , double &y ) const;
     virtual unsigned int num_polylines() const;
@@ -112,23 +102,42 @@ public:
 
     virtual void clear();
 
-    typedef OGRPolygon* polygon_type;
+    /// Geometries, levels of detail and cached raster
+    virtual std::size_t memory_size() const;
+
+protected:
+    virtual void draw_geometries(wxDC &dc) const;
+    virtual void draw_texts(wxDC &dc) const;
 
 private:
-    std::vector<std::pair<geometry_types,OGRFeature*> > m_geometries_features;
+    /// Updates the accessor indices and the spatial index for the last appended feature
+    void index_last_feature();
+    /// Bulk loads the spatial index of the features
+    void build_index();
+    /// Appends n single part features without attributes (one coordinate per feature if offsets is null, see layer::add_polygons)
+    void append_features(ogr_flat_geometries::feature_type type, const double *x , const double *y , const std::size_t *offsets , std::size_t n);
+    virtual void build_lod() const;
+    /// Interrupts the computation of the levels of detail and drops them. Must be called before the geometries are modified.
+    void reset_lod();
+    void get_ring(std::size_t ring, std::vector<double> &x , std::vector<double> &y ) const;
+
+    ogr_flat_geometries m_geometries;
+    ogr_attribute_table m_attributes;
+    /// (Multi)polygon features, in feature order (see get_polygon and get_polygon_rings)
+    std::vector<unsigned int> m_polygon_features;
+    /// First ring of the points and of the polylines, in feature order (see get_point and get_polyline)
+    std::vector<unsigned int> m_point_rings, m_polyline_rings;
+    /// Bounding boxes of the features and of the text anchors, for view culling
+    bbox_rtree m_index, m_text_index;
+    /// Simplified rings, drawn when zoomed out
+    mutable boost::shared_ptr<const ogr_flat_geometries::lod_type> m_lod;
+    /// While loading, features are only indexed in bulk at the end
+    bool m_bulk_loading;
     typedef struct __internal_point { double x, y; } internal_point_type;
     std::vector< std::pair< internal_point_type , std::string > > m_texts;
     double m_center_x, m_center_y;
-    unsigned int m_nb_geometries;
-    unsigned int m_nb_linear_rings;
-    unsigned int m_nb_line_strings;
-    unsigned int m_nb_multiline_strings;
-    unsigned int m_nb_multipoints;
-    unsigned int m_nb_points;
-    unsigned int m_nb_multipolygons;
-    unsigned int m_nb_polygons;
-
-    void compute_center(OGRLayer* layer, int nb_layers);
+
+    void compute_center();
     void build_infos(OGRSpatialReference *spatial_reference);
 
 };
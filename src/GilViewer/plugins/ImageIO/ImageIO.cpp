@@ -20,6 +20,7 @@ using namespace boost::filesystem;
 using namespace std;
 
 #include "GilViewer/plugins/plugin_base.hpp"
+#include "GilViewer/tools/profiler.hpp"
 IMPLEMENT_PLUGIN(gilviewer_file_io_imageio);
 
 // this should be integrated into ImageIO
@@ -157,6 +158,7 @@ struct image_copier : public boost::static_visitor<layer::ptrLayerType>
 
 shared_ptr<layer> gilviewer_file_io_imageio::load(const string &filename, const ptrdiff_t top_left_x, const ptrdiff_t top_left_y, const ptrdiff_t dim_x, const ptrdiff_t dim_y)
 {
+    profiler::scoped_timer timer(profiler::LOAD, filename);
 
     ign::imageio::ImageInput image_input(filename);
     if (!image_input.Valide())
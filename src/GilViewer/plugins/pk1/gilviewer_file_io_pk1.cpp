@@ -13,10 +13,12 @@ using namespace std;
 #include <fstream>
 
 #include "GilViewer/plugins/plugin_base.hpp"
+#include "GilViewer/tools/profiler.hpp"
 IMPLEMENT_PLUGIN(gilviewer_file_io_pk1);
 
 boost::shared_ptr<layer> gilviewer_file_io_pk1::load(const string &filename, const ptrdiff_t top_left_x, const ptrdiff_t top_left_y, const ptrdiff_t dim_x, const ptrdiff_t dim_y)
 {
+    profiler::scoped_timer timer(profiler::LOAD, filename);
     boost::shared_ptr<simple_vector_layer> shr_ptr=boost::shared_ptr<simple_vector_layer>(new simple_vector_layer(filesystem::basename(filename)));
     std::ifstream file(filename.c_str());
 		unsigned int offset=3;
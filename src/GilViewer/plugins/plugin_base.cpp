@@ -7,6 +7,7 @@
 #include <wx/dynlib.h>
 
 #include "GilViewer/tools/pattern_singleton.hpp"
+#include "GilViewer/tools/thread_pool.hpp"
 #include "GilViewer/convenient/macros_gilviewer.hpp"
 #include "GilViewer/io/gilviewer_io_factory.hpp"
 
@@ -45,6 +46,11 @@ plugin_base* load_plugin(const boost::filesystem::path &path)
     return plugin;
 }
 
+thread_pool* plugin_base::task_pool()
+{
+    return thread_pool::instance();
+}
+
 void wx_plugin_base::parent(wxWindow* parent)
 {
     m_parent = parent;
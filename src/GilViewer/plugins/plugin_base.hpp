@@ -16,6 +16,7 @@
 #include <boost/filesystem/path.hpp>
 class gilviewer_io_factory;
 class wxAuiManager;
+class thread_pool;
 
 //the plugin interface (a.k.a. abstract class)
 class plugin_base
@@ -23,6 +24,9 @@ class plugin_base
 public:
     virtual bool Register(gilviewer_io_factory *) { return true; }
     virtual ~plugin_base() {}
+
+    /// Worker threads shared with the application (the plugins must not create their own instance)
+    static thread_pool* task_pool();
 };
 
 //our plugin will contain GUI in itself - therefore we need to make it extend wxEvtHandler (or wxDialog for that matter)
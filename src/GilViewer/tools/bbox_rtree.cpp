@@ -0,0 +1,289 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+#include "bbox_rtree.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    struct center_x_less
+    {
+        bool operator()(const bbox_rtree::entry& a, const bbox_rtree::entry& b) const
+        {
+            return a.first.min_x+a.first.max_x < b.first.min_x+b.first.max_x;
+        }
+    };
+
+    struct center_y_less
+    {
+        bool operator()(const bbox_rtree::entry& a, const bbox_rtree::entry& b) const
+        {
+            return a.first.min_y+a.first.max_y < b.first.min_y+b.first.max_y;
+        }
+    };
+}
+
+bbox_rtree::box::box() :
+        min_x( std::numeric_limits<double>::max()), min_y( std::numeric_limits<double>::max()),
+        max_x(-std::numeric_limits<double>::max()), max_y(-std::numeric_limits<double>::max()) {}
+
+bbox_rtree::box::box(double x0, double y0, double x1, double y1) :
+        min_x(std::min(x0,x1)), min_y(std::min(y0,y1)), max_x(std::max(x0,x1)), max_y(std::max(y0,y1)) {}
+
+void bbox_rtree::box::expand(double x, double y)
+{
+    min_x = std::min(min_x,x); max_x = std::max(max_x,x);
+    min_y = std::min(min_y,y); max_y = std::max(max_y,y);
+}
+
+void bbox_rtree::box::expand(const box& b)
+{
+    if(b.empty()) return;
+    min_x = std::min(min_x,b.min_x); max_x = std::max(max_x,b.max_x);
+    min_y = std::min(min_y,b.min_y); max_y = std::max(max_y,b.max_y);
+}
+
+void bbox_rtree::box::inflate(double d)
+{
+    if(empty()) return;
+    min_x -= d; min_y -= d;
+    max_x += d; max_y += d;
+}
+
+bbox_rtree::bbox_rtree(unsigned int max_entries) :
+        m_root(no_node), m_size(0), m_max_entries(std::max(4u,max_entries)) {}
+
+void bbox_rtree::clear()
+{
+    std::vector<node>().swap(m_nodes);
+    m_root = no_node;
+    m_size = 0;
+}
+
+bbox_rtree::box bbox_rtree::bounds() const
+{
+    return m_root==no_node ? box() : m_nodes[m_root].bounds;
+}
+
+void bbox_rtree::pack(std::vector<entry>& entries, bool leaf, std::vector<entry>& parents)
+{
+    // Sort-Tile-Recursive: vertical slices sorted by x, then runs of max_entries sorted by y in each slice
+    std::size_t n = entries.size();
+    std::size_t nb_nodes = (n+m_max_entries-1)/m_max_entries;
+    std::size_t nb_slices = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(nb_nodes))));
+    std::size_t slice_size = nb_slices*m_max_entries;
+    std::sort(entries.begin(), entries.end(), center_x_less());
+    for(std::size_t s=0;s<n;s+=slice_size)
+    {
+        std::size_t se = std::min(n, s+slice_size);
+        std::sort(entries.begin()+s, entries.begin()+se, center_y_less());
+        for(std::size_t b=s;b<se;b+=m_max_entries)
+        {
+            std::size_t be = std::min(se, b+m_max_entries);
+            node nd;
+            nd.leaf = leaf;
+            nd.count = 0;
+            nd.boxes.reserve(be-b);
+            nd.children.reserve(be-b);
+            for(std::size_t i=b;i<be;++i)
+            {
+                nd.bounds.expand(entries[i].first);
+                nd.boxes.push_back(entries[i].first);
+                nd.children.push_back(entries[i].second);
+                nd.count += leaf ? 1 : m_nodes[entries[i].second].count;
+            }
+            m_nodes.push_back(nd);
+            parents.push_back(entry(nd.bounds, static_cast<unsigned int>(m_nodes.size()-1)));
+        }
+    }
+}
+
+void bbox_rtree::bulk_load(std::vector<entry>& entries)
+{
+    clear();
+    m_size = entries.size();
+    if(entries.empty())
+        return;
+    std::vector<entry> level, parents;
+    pack(entries, true, parents);
+    while(parents.size()>1)
+    {
+        level.swap(parents);
+        parents.clear();
+        pack(level, false, parents);
+    }
+    m_root = parents.front().second;
+}
+
+void bbox_rtree::update_bounds(unsigned int n)
+{
+    node& nd = m_nodes[n];
+    nd.bounds = box();
+    nd.count = 0;
+    for(std::size_t i=0;i<nd.boxes.size();++i)
+    {
+        nd.bounds.expand(nd.boxes[i]);
+        nd.count += nd.leaf ? 1 : m_nodes[nd.children[i]].count;
+    }
+}
+
+unsigned int bbox_rtree::split(unsigned int n)
+{
+    // Sorts the entries along the axis of largest spread and moves the upper half to a new node
+    std::vector<entry> entries;
+    {
+        node& nd = m_nodes[n];
+        for(std::size_t i=0;i<nd.boxes.size();++i)
+            entries.push_back(entry(nd.boxes[i], nd.children[i]));
+    }
+    const box& b = m_nodes[n].bounds;
+    if(b.max_x-b.min_x >= b.max_y-b.min_y)
+        std::sort(entries.begin(), entries.end(), center_x_less());
+    else
+        std::sort(entries.begin(), entries.end(), center_y_less());
+
+    node sibling;
+    sibling.leaf = m_nodes[n].leaf;
+    std::size_t half = entries.size()/2;
+    m_nodes[n].boxes.clear();
+    m_nodes[n].children.clear();
+    for(std::size_t i=0;i<entries.size();++i)
+    {
+        node& target = (i<half) ? m_nodes[n] : sibling;
+        target.boxes.push_back(entries[i].first);
+        target.children.push_back(entries[i].second);
+    }
+    update_bounds(n);
+    m_nodes.push_back(sibling);
+    unsigned int s = static_cast<unsigned int>(m_nodes.size()-1);
+    update_bounds(s);
+    return s;
+}
+
+unsigned int bbox_rtree::insert(unsigned int n, const box& b, unsigned int id)
+{
+    m_nodes[n].bounds.expand(b);
+    ++m_nodes[n].count;
+    if(m_nodes[n].leaf)
+    {
+        m_nodes[n].boxes.push_back(b);
+        m_nodes[n].children.push_back(id);
+    }
+    else
+    {
+        // Child needing the least enlargement, then the smallest one
+        std::size_t best = 0;
+        double best_enlargement = std::numeric_limits<double>::max(), best_area = best_enlargement;
+        const node& nd = m_nodes[n];
+        for(std::size_t i=0;i<nd.boxes.size();++i)
+        {
+            box e(nd.boxes[i]);
+            e.expand(b);
+            double area = nd.boxes[i].area();
+            double enlargement = e.area()-area;
+            if(enlargement<best_enlargement || (enlargement==best_enlargement && area<best_area))
+            {
+                best = i;
+                best_enlargement = enlargement;
+                best_area = area;
+            }
+        }
+        unsigned int child = m_nodes[n].children[best];
+        unsigned int sibling = insert(child, b, id);
+        m_nodes[n].boxes[best] = m_nodes[child].bounds;
+        if(sibling!=no_node)
+        {
+            m_nodes[n].boxes.push_back(m_nodes[sibling].bounds);
+            m_nodes[n].children.push_back(sibling);
+        }
+    }
+    if(m_nodes[n].boxes.size()>m_max_entries)
+        return split(n);
+    return no_node;
+}
+
+void bbox_rtree::insert(const box& b, unsigned int id)
+{
+    ++m_size;
+    if(m_root==no_node)
+    {
+        node nd;
+        nd.leaf = true;
+        nd.count = 0;
+        m_nodes.push_back(nd);
+        m_root = static_cast<unsigned int>(m_nodes.size()-1);
+    }
+    unsigned int sibling = insert(m_root, b, id);
+    if(sibling!=no_node)
+    {
+        node root;
+        root.leaf = false;
+        root.count = m_nodes[m_root].count+m_nodes[sibling].count;
+        root.boxes.push_back(m_nodes[m_root].bounds);
+        root.children.push_back(m_root);
+        root.boxes.push_back(m_nodes[sibling].bounds);
+        root.children.push_back(sibling);
+        root.bounds.expand(root.boxes[0]);
+        root.bounds.expand(root.boxes[1]);
+        m_nodes.push_back(root);
+        m_root = static_cast<unsigned int>(m_nodes.size()-1);
+    }
+}
+
+void bbox_rtree::query(const box& b, std::vector<unsigned int>& ids) const
+{
+    if(m_root==no_node || !b.intersects(m_nodes[m_root].bounds))
+        return;
+    std::vector<unsigned int> stack(1, m_root);
+    while(!stack.empty())
+    {
+        const node& nd = m_nodes[stack.back()];
+        stack.pop_back();
+        for(std::size_t i=0;i<nd.boxes.size();++i)
+        {
+            if(!b.intersects(nd.boxes[i]))
+                continue;
+            if(nd.leaf)
+                ids.push_back(nd.children[i]);
+            else
+                stack.push_back(nd.children[i]);
+        }
+    }
+}
@@ -0,0 +1,146 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+#ifndef BBOX_RTREE_HPP
+#define BBOX_RTREE_HPP
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+/**
+ * @brief R-tree of axis aligned bounding boxes, used for view culling and spatial queries on vector layers.
+ *
+ * Each box is associated with an identifier (typically the index of the geometry in the layer containers).
+ * The tree is built in bulk with the Sort-Tile-Recursive packing and can then be updated incrementally.
+ **/
+class bbox_rtree
+{
+public:
+    struct box
+    {
+        double min_x, min_y, max_x, max_y;
+
+        /// Empty box (expanding it with a point gives this point)
+        box();
+        box(double x0, double y0, double x1, double y1);
+
+        bool empty() const { return min_x>max_x || min_y>max_y; }
+        void expand(double x, double y);
+        void expand(const box& b);
+        /// Grows the box by d on each side
+        void inflate(double d);
+        bool intersects(const box& b) const
+        {
+            return min_x<=b.max_x && b.min_x<=max_x && min_y<=b.max_y && b.min_y<=max_y;
+        }
+        double area() const { return empty() ? 0. : (max_x-min_x)*(max_y-min_y); }
+    };
+
+    typedef std::pair<box, unsigned int> entry;
+
+    explicit bbox_rtree(unsigned int max_entries=16);
+
+    /// Replaces the content of the tree. The entries are reordered.
+    void bulk_load(std::vector<entry>& entries);
+    void insert(const box& b, unsigned int id);
+    /// Appends the identifiers of the boxes intersecting b (in no particular order)
+    void query(const box& b, std::vector<unsigned int>& ids) const;
+    /**
+     * Visits the entries intersecting b, aggregated at the given resolution: a node whose bounds are smaller than
+     * resolution is visited once, at the centre of its bounds, with the number of entries it holds. The visitor is
+     * called as v(x, y, count). The cost depends on the number of cells of size resolution in b, not on the number of entries.
+     */
+    template<class Visitor> void aggregate(const box& b, double resolution, Visitor& v) const
+    {
+        if(m_root==no_node || !b.intersects(m_nodes[m_root].bounds))
+            return;
+        std::vector<unsigned int> stack(1, m_root);
+        while(!stack.empty())
+        {
+            const node& nd = m_nodes[stack.back()];
+            stack.pop_back();
+            for(std::size_t i=0;i<nd.boxes.size();++i)
+            {
+                const box& c = nd.boxes[i];
+                if(!b.intersects(c))
+                    continue;
+                if(nd.leaf)
+                    v(0.5*(c.min_x+c.max_x), 0.5*(c.min_y+c.max_y), 1u);
+                else if(c.max_x-c.min_x<resolution && c.max_y-c.min_y<resolution)
+                    v(0.5*(c.min_x+c.max_x), 0.5*(c.min_y+c.max_y), m_nodes[nd.children[i]].count);
+                else
+                    stack.push_back(nd.children[i]);
+            }
+        }
+    }
+    void clear();
+
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size==0; }
+    /// Bounding box of all the entries
+    box bounds() const;
+
+private:
+    struct node
+    {
+        box bounds;
+        bool leaf;
+        /// Number of entries in the subtree
+        unsigned int count;
+        std::vector<box> boxes;
+        /// Child nodes indices, or identifiers for a leaf
+        std::vector<unsigned int> children;
+    };
+
+    /// Packs the entries in nodes of the given level, returns the entries describing the created nodes
+    void pack(std::vector<entry>& entries, bool leaf, std::vector<entry>& parents);
+    /// Inserts in the subtree rooted at n. Returns the index of the node created by a split, or no_node.
+    unsigned int insert(unsigned int n, const box& b, unsigned int id);
+    unsigned int split(unsigned int n);
+    /// Recomputes the bounds and the count of a node from its children
+    void update_bounds(unsigned int n);
+
+    static const unsigned int no_node = static_cast<unsigned int>(-1);
+
+    std::vector<node> m_nodes;
+    unsigned int m_root;
+    std::size_t m_size;
+    unsigned int m_max_entries;
+};
+
+#endif // BBOX_RTREE_HPP
@@ -39,6 +39,7 @@ Authors:
 #include <fstream>
 #include <ctime>
 #include <cstdlib>
+#include <algorithm>
 
 #include "color_lookup_table.hpp"
 
@@ -70,6 +71,17 @@ void color_lookup_table::create_random()
         m_clut[i] = (unsigned char)( (double(std::rand()) / RAND_MAX) * 255 + 1 );
 }
 
+void color_lookup_table::create_heat()
+{
+    m_lut_file = "";
+    for (unsigned int i=0;i<256;++i)
+    {
+        m_clut[i    ] = (unsigned char)( std::min(255u, 3*i) );
+        m_clut[i+256] = (unsigned char)( i<85 ? 0 : std::min(255u, 3*(i-85)) );
+        m_clut[i+512] = (unsigned char)( i<170 ? 0 : 3*(i-170) );
+    }
+}
+
 void color_lookup_table::load_from_text_file(const std::string &fileCLUT)
 {
     //	std::ifstream ficCLUT("/home/achauve/Logiciels/ImageJ/luts/sepia.lut");//(fileCLUT.c_str());
@@ -62,6 +62,8 @@ public:
     void load_from_text_file(const std::string &fileCLUT);
     /// Creates a random LUT
     void create_random();
+    /// Creates a heat LUT (black, red, yellow and white), used for density maps
+    void create_heat();
 
     /// Returns the LUT data container
     const std::vector<unsigned char>& get_data() const { return m_clut; }
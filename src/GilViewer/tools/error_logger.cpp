@@ -40,28 +40,61 @@ Authors:
 
 #include "error_logger.hpp"
 
+#include <ostream>
+
+#include <boost/thread/mutex.hpp>
+
 #include <wx/log.h>
 #include <wx/frame.h>
 #include <wx/textctrl.h>
 
+namespace
+{
+    boost::mutex streams_mutex;
+    std::ostream* out_stream = NULL;
+    std::ostream* err_stream = NULL;
+}
+
 void gilviewer_wx_error_logger::log_error(const std::string& message)
 {
-    gilviewer_wx_error_logger::log_common(message, new wxColour(255, 140, 0));
+    if(!log_stream(message, true))
+        gilviewer_wx_error_logger::log_common(message, new wxColour(255, 140, 0));
 }
 
 void gilviewer_wx_error_logger::log_exception(const std::string& message)
 {
-    gilviewer_wx_error_logger::log_common(message, const_cast<wxColour*>(wxRED) );
+    if(!log_stream(message, true))
+        gilviewer_wx_error_logger::log_common(message, const_cast<wxColour*>(wxRED) );
 }
 
 void gilviewer_wx_error_logger::log_warning(const std::string& message)
 {
-    gilviewer_wx_error_logger::log_common(message, new wxColour(148, 0, 211));
+    if(!log_stream(message, true))
+        gilviewer_wx_error_logger::log_common(message, new wxColour(148, 0, 211));
 }
 
 void gilviewer_wx_error_logger::log_message(const std::string& message)
 {
-    gilviewer_wx_error_logger::log_common(message, const_cast<wxColour*>(wxBLUE) );
+    if(!log_stream(message, false))
+        gilviewer_wx_error_logger::log_common(message, const_cast<wxColour*>(wxBLUE) );
+}
+
+void gilviewer_wx_error_logger::streams(std::ostream* out, std::ostream* err)
+{
+    boost::mutex::scoped_lock lock(streams_mutex);
+    out_stream = out;
+    err_stream = err;
+}
+
+bool gilviewer_wx_error_logger::log_stream(const std::string& message, bool error)
+{
+    boost::mutex::scoped_lock lock(streams_mutex);
+    if(!out_stream && !err_stream)
+        return false;
+    std::ostream* os = error ? err_stream : out_stream;
+    if(os)
+        *os << message << std::endl;
+    return true;
 }
 
 void gilviewer_wx_error_logger::log_common(const std::string& message, wxColour* color)
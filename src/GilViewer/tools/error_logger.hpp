@@ -42,6 +42,7 @@ Authors:
 	#pragma warning(disable : 4251)
 	#pragma warning(disable : 4275)
 #endif
+#include <iosfwd>
 #include <string>
 class wxColour;
 
@@ -54,8 +55,14 @@ public:
     static void log_warning(const std::string& message);
     static void log_message(const std::string& message);
 
+    /// Writes the messages to out, and the errors, exceptions and warnings to err, one line at a time under a mutex,
+    /// instead of the log window. For the tools without GUI, which may log from several threads. (NULL, NULL): log window.
+    static void streams(std::ostream* out, std::ostream* err);
+
 private:
     static void log_common(const std::string& message, wxColour* color);
+    /// Returns false if no stream is installed
+    static bool log_stream(const std::string& message, bool error);
 };
 
 #endif // __GILVIEWER_WX_ERROR_LOGGER_HPP__
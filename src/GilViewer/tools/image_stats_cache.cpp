@@ -0,0 +1,311 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/bind.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
+
+#include "image_stats_cache.hpp"
+
+using namespace std;
+using namespace boost;
+using namespace boost::filesystem;
+
+BOOST_CLASS_VERSION(image_stats_cache::entry, 1)
+
+namespace
+{
+    const std::string cache_magic = "GilViewer stats cache";
+    const std::string cache_extension = ".gvc";
+}
+
+template<class Archive>
+void image_stats_cache::entry::serialize(Archive& ar, const unsigned int version)
+{
+    ar & path;
+    ar & file_size;
+    ar & last_write_time;
+    ar & width;
+    ar & height;
+    ar & has_min_max;
+    ar & min;
+    ar & max;
+    ar & has_histogram;
+    ar & histogram_min;
+    ar & histogram_max;
+    ar & histogram;
+}
+
+bool image_stats_cache::entry::same_key(const entry& e) const
+{
+    return path==e.path && file_size==e.file_size && last_write_time==e.last_write_time && width==e.width && height==e.height;
+}
+
+image_stats_cache::image_stats_cache() : m_enabled(false), m_stop_writer(false) {}
+
+void image_stats_cache::enabled(bool e)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_enabled = e;
+}
+
+bool image_stats_cache::enabled() const
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_enabled;
+}
+
+void image_stats_cache::directory(const std::string& dir)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_directory = dir;
+}
+
+std::string image_stats_cache::directory() const
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_directory;
+}
+
+bool image_stats_cache::make_key(const std::string& filename, unsigned int width, unsigned int height, entry& e)
+{
+    if(filename.empty()) return false;
+    try
+    {
+        path p(system_complete(filename));
+        if(!is_regular_file(p)) return false;
+        e.path = p.string();
+        e.file_size = file_size(p);
+        e.last_write_time = last_write_time(p);
+        e.width = width;
+        e.height = height;
+    }
+    catch(const std::exception&)
+    {
+        return false;
+    }
+    return true;
+}
+
+std::string image_stats_cache::cache_filename(const std::string& image_path) const
+{
+    if(m_directory.empty())
+        return image_path + cache_extension;
+    // In a shared cache directory, files are named after a hash of the full image path
+    std::ostringstream oss;
+    oss << std::hex << std::setw(2*sizeof(std::size_t)) << std::setfill('0') << boost::hash<std::string>()(image_path);
+    return (path(m_directory) / (oss.str() + cache_extension)).string();
+}
+
+image_stats_cache::entry& image_stats_cache::lookup(const entry& key, boost::mutex::scoped_lock& lock)
+{
+    std::map<std::string, entry>::iterator it = m_entries.find(key.path);
+    if(it!=m_entries.end() && it->second.same_key(key))
+        return it->second;
+
+    // The sidecar file is read without holding the lock, so that other images are not blocked on disk I/O
+    std::string cache_file = cache_filename(key.path);
+    lock.unlock();
+    entry e;
+    if(!read_entry(cache_file, e) || !e.same_key(key))
+        e = key;
+    lock.lock();
+
+    // Another thread may have filled the entry meanwhile: its version is the most recent one
+    it = m_entries.find(key.path);
+    if(it!=m_entries.end() && it->second.same_key(key))
+        return it->second;
+    return m_entries[key.path] = e;
+}
+
+bool image_stats_cache::find_min_max(const std::string& filename, unsigned int width, unsigned int height, double& min, double& max)
+{
+    entry key;
+    if(!enabled() || !make_key(filename, width, height, key)) return false;
+    boost::mutex::scoped_lock lock(m_mutex);
+    const entry& e = lookup(key, lock);
+    if(!e.has_min_max) return false;
+    min = e.min;
+    max = e.max;
+    return true;
+}
+
+bool image_stats_cache::find_histogram(const std::string& filename, unsigned int width, unsigned int height, double min, double max, histogram_type& histogram)
+{
+    entry key;
+    if(!enabled() || !make_key(filename, width, height, key)) return false;
+    boost::mutex::scoped_lock lock(m_mutex);
+    const entry& e = lookup(key, lock);
+    if(!e.has_histogram || e.histogram_min!=min || e.histogram_max!=max) return false;
+    histogram = e.histogram;
+    return true;
+}
+
+void image_stats_cache::store_min_max(const std::string& filename, unsigned int width, unsigned int height, double min, double max)
+{
+    entry key;
+    if(!enabled() || !make_key(filename, width, height, key)) return;
+    boost::mutex::scoped_lock lock(m_mutex);
+    entry& e = lookup(key, lock);
+    e.has_min_max = true;
+    e.min = min;
+    e.max = max;
+    queue_write(e);
+}
+
+void image_stats_cache::store_histogram(const std::string& filename, unsigned int width, unsigned int height, double min, double max, const histogram_type& histogram)
+{
+    entry key;
+    if(!enabled() || !make_key(filename, width, height, key)) return;
+    boost::mutex::scoped_lock lock(m_mutex);
+    entry& e = lookup(key, lock);
+    e.has_histogram = true;
+    e.histogram_min = min;
+    e.histogram_max = max;
+    e.histogram = histogram;
+    queue_write(e);
+}
+
+void image_stats_cache::queue_write(const entry& e)
+{
+    // Only the last version of an entry is kept in the queue
+    m_pending[cache_filename(e.path)] = e;
+    if(!m_writer)
+    {
+        m_writer.reset(new boost::thread(boost::bind(&image_stats_cache::writer_loop, this)));
+    }
+    m_condition.notify_all();
+}
+
+void image_stats_cache::writer_loop()
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    for(;;)
+    {
+        while(m_pending.empty() && !m_stop_writer)
+            m_condition.wait(lock);
+        if(m_pending.empty())
+            return;
+        std::string cache_file = m_pending.begin()->first;
+        entry e = m_pending.begin()->second;
+        m_pending.erase(m_pending.begin());
+        lock.unlock();
+        write_entry(cache_file, e);
+        lock.lock();
+        m_condition.notify_all();
+    }
+}
+
+void image_stats_cache::flush()
+{
+    boost::shared_ptr<boost::thread> writer;
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        if(!m_writer) return;
+        // The writer empties the queue before it stops
+        m_stop_writer = true;
+        m_condition.notify_all();
+        writer = m_writer;
+    }
+    writer->join();
+
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_writer.reset();
+    m_stop_writer = false;
+    // Entries stored after the writer stopped are written by a new one
+    if(!m_pending.empty())
+        m_writer.reset(new boost::thread(boost::bind(&image_stats_cache::writer_loop, this)));
+}
+
+bool image_stats_cache::read_entry(const std::string& cache_file, entry& e)
+{
+    try
+    {
+        if(!exists(cache_file)) return false;
+        std::ifstream ifs(cache_file.c_str(), std::ios::binary);
+        if(!ifs) return false;
+        boost::archive::binary_iarchive ia(ifs);
+        std::string magic;
+        ia >> magic;
+        if(magic!=cache_magic) return false;
+        ia >> e;
+    }
+    catch(const std::exception&)
+    {
+        // A corrupted or outdated cache file is simply ignored: it will be overwritten
+        return false;
+    }
+    return true;
+}
+
+bool image_stats_cache::write_entry(const std::string& cache_file, const entry& e)
+{
+    // The entry is written in a temporary file which is then renamed, so that a reader never sees a partial file
+    std::string tmp_file = cache_file + ".tmp";
+    try
+    {
+        path parent = path(cache_file).parent_path();
+        if(!parent.empty() && !exists(parent))
+            create_directories(parent);
+        {
+            std::ofstream ofs(tmp_file.c_str(), std::ios::binary);
+            if(!ofs) return false;
+            boost::archive::binary_oarchive oa(ofs);
+            oa << cache_magic;
+            oa << e;
+        }
+        boost::filesystem::rename(tmp_file, cache_file);
+    }
+    catch(const std::exception&)
+    {
+        // Read-only directories are common for large datasets: the cache then stays in memory only
+        boost::system::error_code ec;
+        boost::filesystem::remove(tmp_file, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,141 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+
+#ifndef __IMAGE_STATS_CACHE_HPP__
+#define __IMAGE_STATS_CACHE_HPP__
+
+#include <map>
+#include <string>
+#include <vector>
+#include <ctime>
+
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "pattern_singleton.hpp"
+
+/**
+ * @brief Persistent cache of the statistics computed on image files.
+ *
+ * Computing the min/max and the histograms of a large image is expensive. The results are
+ * kept in memory and in a small binary file (".gvc") written either next to the image
+ * (sidecar) or in a dedicated cache directory.
+ * An entry is identified by the absolute file path, the file size, the modification time and the
+ * dimensions of the view. The validation on open only needs a stat of the image file.
+ * Writes are queued and done by a background thread, so that the GUI is never blocked.
+ **/
+class image_stats_cache : public PatternSingleton<image_stats_cache>
+{
+    friend class PatternSingleton<image_stats_cache>;
+
+public:
+    typedef std::vector< std::vector<double> > histogram_type;
+
+    struct entry
+    {
+        entry() : file_size(0), last_write_time(0), width(0), height(0),
+                  has_min_max(false), min(0.), max(0.),
+                  has_histogram(false), histogram_min(0.), histogram_max(0.) {}
+
+        std::string path;
+        boost::uintmax_t file_size;
+        std::time_t last_write_time;
+        unsigned int width, height;
+
+        bool has_min_max;
+        double min, max;
+
+        bool has_histogram;
+        double histogram_min, histogram_max;
+        histogram_type histogram;
+
+        /// Returns true if both entries describe the same version of the same file
+        bool same_key(const entry& e) const;
+
+        template<class Archive> void serialize(Archive& ar, const unsigned int version);
+    };
+
+    /// Enables or disables the cache (lookups then always fail and nothing is written). Disabled by default, so that
+    /// no file is written by the applications which do not configure it.
+    void enabled(bool e);
+    bool enabled() const;
+    /// Sets the cache directory. An empty string means that sidecar files are written next to the images.
+    void directory(const std::string& dir);
+    std::string directory() const;
+
+    /// Gets the min/max of the image file. Returns false if they are not (validly) cached.
+    bool find_min_max(const std::string& filename, unsigned int width, unsigned int height, double& min, double& max);
+    /// Gets the histogram of the image file computed on the given [min,max] range. Returns false if not (validly) cached.
+    bool find_histogram(const std::string& filename, unsigned int width, unsigned int height, double min, double max, histogram_type& histogram);
+
+    void store_min_max(const std::string& filename, unsigned int width, unsigned int height, double min, double max);
+    void store_histogram(const std::string& filename, unsigned int width, unsigned int height, double min, double max, const histogram_type& histogram);
+
+    /// Blocks until all the queued entries have been written, then stops and joins the writer thread.
+    /// It must be called before the application exits (a new writer is started by the next store).
+    void flush();
+
+private:
+    image_stats_cache();
+
+    /// Fills the key of the entry. Returns false if the file does not exist.
+    static bool make_key(const std::string& filename, unsigned int width, unsigned int height, entry& e);
+    std::string cache_filename(const std::string& path) const;
+    /// Returns the current entry for the key of e (from memory, then from disk). The lock must be held on m_mutex:
+    /// it is released while the sidecar file is read.
+    entry& lookup(const entry& key, boost::mutex::scoped_lock& lock);
+    void queue_write(const entry& e);
+    void writer_loop();
+    static bool read_entry(const std::string& cache_file, entry& e);
+    static bool write_entry(const std::string& cache_file, const entry& e);
+
+    bool m_enabled;
+    std::string m_directory;
+    std::map<std::string, entry> m_entries;
+    /// Entries waiting to be written, indexed by cache file name
+    std::map<std::string, entry> m_pending;
+    boost::shared_ptr<boost::thread> m_writer;
+    bool m_stop_writer;
+    mutable boost::mutex m_mutex;
+    boost::condition m_condition;
+};
+
+#endif // __IMAGE_STATS_CACHE_HPP__
@@ -0,0 +1,254 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+#ifndef LEVEL_OF_DETAIL_HPP
+#define LEVEL_OF_DETAIL_HPP
+
+#include <vector>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+#include <boost/thread/thread.hpp>
+
+namespace lod_detail
+{
+    /// Squared distance from p to the segment [a,b]
+    template<class P>
+    double squared_distance(const P& p, const P& a, const P& b)
+    {
+        double vx = b.x-a.x, vy = b.y-a.y, ux = p.x-a.x, uy = p.y-a.y;
+        double vv = vx*vx+vy*vy;
+        double t = vv>0 ? std::max(0., std::min(1., (ux*vx+uy*vy)/vv)) : 0.;
+        double dx = ux-t*vx, dy = uy-t*vy;
+        return dx*dx+dy*dy;
+    }
+
+    /// Index of the point of ]a,b[ farthest from the segment [pts[a],pts[b]] (a if there is none), and its squared distance d2
+    template<class P>
+    std::size_t farthest(const P* pts, std::size_t a, std::size_t b, double& d2)
+    {
+        std::size_t f = a;
+        d2 = -1.;
+        for(std::size_t i=a+1;i<b;++i)
+        {
+            double d = squared_distance(pts[i], pts[a], pts[b]);
+            if(d>d2) { d2 = d; f = i; }
+        }
+        return f;
+    }
+}
+
+/**
+ * @brief Douglas-Peucker simplification of the run pts[0..n), at the given tolerance.
+ *
+ * The kept points are appended to out. The end points of the run are always kept.
+ * A closed run (a polygon ring) keeps at least a triangle, so that it never degenerates to a line.
+ **/
+template<class P>
+void douglas_peucker(const P* pts, std::size_t n, double tolerance, bool closed, std::vector<P>& out)
+{
+    if(n<=3)
+    {
+        out.insert(out.end(), pts, pts+n);
+        return;
+    }
+    std::vector<char> keep(n, 0);
+    keep[0] = keep[n-1] = 1;
+    double tolerance2 = tolerance*tolerance;
+
+    std::vector< std::pair<std::size_t,std::size_t> > stack;
+    if(closed)
+    {
+        // Split the ring at its farthest vertex from the first one, and keep the apex of the largest half
+        std::size_t f = 0;
+        double df = -1.;
+        for(std::size_t i=1;i+1<n;++i)
+        {
+            double dx = pts[i].x-pts[0].x, dy = pts[i].y-pts[0].y;
+            if(dx*dx+dy*dy>df) { df = dx*dx+dy*dy; f = i; }
+        }
+        double d0, d1;
+        std::size_t g0 = lod_detail::farthest(pts, 0, f, d0);
+        std::size_t g1 = lod_detail::farthest(pts, f, n-1, d1);
+        keep[f] = 1;
+        keep[d0>=d1 ? g0 : g1] = 1;
+        std::size_t prev = 0;
+        for(std::size_t i=1;i<n;++i)
+            if(keep[i]) { stack.push_back(std::make_pair(prev,i)); prev = i; }
+    }
+    else
+        stack.push_back(std::make_pair(std::size_t(0),n-1));
+
+    // A single long run may take a while: interruptions are checked every few tens of thousands of scanned points
+    std::size_t scanned = 0;
+    while(!stack.empty())
+    {
+        std::size_t a = stack.back().first, b = stack.back().second;
+        stack.pop_back();
+        if(b<=a+1) continue;
+        scanned += b-a;
+        if(scanned>=65536)
+        {
+            scanned = 0;
+            boost::this_thread::interruption_point();
+        }
+        double d2;
+        std::size_t f = lod_detail::farthest(pts, a, b, d2);
+        if(d2<=tolerance2) continue;
+        keep[f] = 1;
+        stack.push_back(std::make_pair(a,f));
+        stack.push_back(std::make_pair(f,b));
+    }
+    for(std::size_t i=0;i<n;++i)
+        if(keep[i]) out.push_back(pts[i]);
+}
+
+/**
+ * @brief Simplified versions of a set of coordinate runs (polylines or polygon rings), for the zoomed out views.
+ *
+ * Each level is simplified from the previous one with a tolerance 4 times larger. The runs keep their order,
+ * so that a level can replace the original coordinates when drawing.
+ * The runs are given by an object providing:
+ * - std::size_t size() const
+ * - const P* run(std::size_t i, std::size_t& n) const
+ * - bool closed(std::size_t i) const
+ *
+ * The construction checks for boost thread interruptions, so that it may run in a background thread.
+ **/
+template<class P>
+class level_of_detail
+{
+public:
+    struct level
+    {
+        /// Maximum distance between the simplified and the original geometries, in local units
+        double tolerance;
+        std::vector<P> coordinates;
+        /// Index of the first coordinate of each run (nb runs + 1)
+        std::vector<unsigned int> offsets;
+
+        const P* run(std::size_t i, std::size_t& n) const
+        {
+            n = offsets[i+1]-offsets[i];
+            return n ? &coordinates[offsets[i]] : 0;
+        }
+    };
+
+    /// Builds the levels. Small sets of runs, which are cheap to draw anyway, get no level.
+    template<class Runs>
+    void build(const Runs& runs, std::size_t min_coordinates=16384, unsigned int max_levels=8);
+    void clear() { m_levels.clear(); }
+
+    bool empty() const { return m_levels.empty(); }
+    std::size_t size() const { return m_levels.size(); }
+    const level& operator[](std::size_t k) const { return m_levels[k]; }
+    /// Coarsest level whose tolerance is under one screen pixel for the zoom factor (local units per pixel), or 0 if the original coordinates must be drawn
+    const level* select(double zoom) const
+    {
+        const level* best = 0;
+        for(std::size_t k=0;k<m_levels.size() && m_levels[k].tolerance<zoom;++k)
+            best = &m_levels[k];
+        return best;
+    }
+    /// Approximate memory used by the levels, in bytes
+    std::size_t memory() const
+    {
+        std::size_t bytes = 0;
+        for(std::size_t k=0;k<m_levels.size();++k)
+            bytes += m_levels[k].coordinates.capacity()*sizeof(P) + m_levels[k].offsets.capacity()*sizeof(unsigned int);
+        return bytes;
+    }
+
+private:
+    std::vector<level> m_levels;
+};
+
+template<class P>
+template<class Runs>
+void level_of_detail<P>::build(const Runs& runs, std::size_t min_coordinates, unsigned int max_levels)
+{
+    m_levels.clear();
+    std::size_t nb_runs = runs.size(), total = 0, n;
+    double min_x = 0., min_y = 0., max_x = 0., max_y = 0.;
+    for(std::size_t i=0;i<nb_runs;++i)
+    {
+        if(i%4096==0)
+            boost::this_thread::interruption_point();
+        const P* pts = runs.run(i,n);
+        for(std::size_t j=0;j<n;++j)
+        {
+            if(total+j==0) { min_x = max_x = pts[j].x; min_y = max_y = pts[j].y; }
+            min_x = std::min(min_x, pts[j].x); max_x = std::max(max_x, pts[j].x);
+            min_y = std::min(min_y, pts[j].y); max_y = std::max(max_y, pts[j].y);
+        }
+        total += n;
+    }
+    // The finest level is well under a pixel when the whole extent fits in a 65536 pixels wide view
+    double tolerance = std::max(max_x-min_x, max_y-min_y) / 65536.;
+    if(total<min_coordinates || !(tolerance>0.))
+        return;
+
+    std::size_t previous = total;
+    double error = 0.;
+    for(unsigned int k=0;k<max_levels;++k, tolerance*=4.)
+    {
+        level l;
+        l.tolerance = error + tolerance;
+        l.offsets.reserve(nb_runs+1);
+        l.offsets.push_back(0);
+        for(std::size_t i=0;i<nb_runs;++i)
+        {
+            if(i%256==0)
+                boost::this_thread::interruption_point();
+            const P* pts = m_levels.empty() ? runs.run(i,n) : m_levels.back().run(i,n);
+            douglas_peucker(pts, n, tolerance, runs.closed(i), l.coordinates);
+            l.offsets.push_back(static_cast<unsigned int>(l.coordinates.size()));
+        }
+        // A level is only worth its memory if it saves a significant part of the coordinates
+        if(4*l.coordinates.size() > 3*previous)
+            continue;
+        previous = l.coordinates.size();
+        error = l.tolerance;
+        std::vector<P>(l.coordinates).swap(l.coordinates);
+        m_levels.push_back(l);
+        if(previous <= 4*nb_runs)
+            break;
+    }
+}
+
+#endif // LEVEL_OF_DETAIL_HPP
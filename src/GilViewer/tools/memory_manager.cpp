@@ -0,0 +1,140 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+
+#include <algorithm>
+#include <vector>
+
+#include "memory_manager.hpp"
+
+using namespace std;
+
+namespace
+{
+    typedef std::pair<unsigned long, memory_manager::client*> candidate_type;
+    bool least_recent(const candidate_type& a, const candidate_type& b) { return a.first < b.first; }
+}
+
+memory_manager::client::client() { memory_manager::instance()->add(this); }
+memory_manager::client::client(const client&) { memory_manager::instance()->add(this); }
+memory_manager::client::~client() { memory_manager::instance()->remove(this); }
+void memory_manager::client::touch() const { memory_manager::instance()->touch(this); }
+
+memory_manager::memory_manager() : m_render(1), m_budget(0) {}
+
+void memory_manager::add(const client *c)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_clients[c] = m_render;
+}
+
+void memory_manager::remove(const client *c)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_clients.erase(c);
+}
+
+void memory_manager::touch(const client *c)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    std::map<const client*, unsigned long>::iterator it = m_clients.find(c);
+    if(it!=m_clients.end())
+        it->second = m_render;
+}
+
+void memory_manager::budget(std::size_t bytes)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_budget = bytes;
+}
+
+std::size_t memory_manager::budget() const
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_budget;
+}
+
+std::size_t memory_manager::used() const
+{
+    std::vector<const client*> clients;
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        clients.reserve(m_clients.size());
+        for(std::map<const client*, unsigned long>::const_iterator it=m_clients.begin(); it!=m_clients.end(); ++it)
+            clients.push_back(it->first);
+    }
+    // The clients are called without the lock: they may create or touch other clients
+    std::size_t bytes = 0;
+    for(std::vector<const client*>::const_iterator it=clients.begin(); it!=clients.end(); ++it)
+        bytes += (*it)->memory_size();
+    return bytes;
+}
+
+void memory_manager::enforce()
+{
+    std::vector<candidate_type> clients;
+    unsigned long render;
+    std::size_t budget;
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        render = m_render++;
+        budget = m_budget;
+        if(budget==0)
+            return;
+        clients.reserve(m_clients.size());
+        // The clients are registered by their constructors: they are not const objects
+        for(std::map<const client*, unsigned long>::const_iterator it=m_clients.begin(); it!=m_clients.end(); ++it)
+            clients.push_back(candidate_type(it->second, const_cast<client*>(it->first)));
+    }
+
+    // The clients are called without the lock. They are destroyed by the GUI thread, which also calls enforce.
+    std::size_t bytes = 0;
+    std::vector<candidate_type> candidates;
+    for(std::vector<candidate_type>::const_iterator it=clients.begin(); it!=clients.end(); ++it)
+    {
+        bytes += it->second->memory_size();
+        if(it->first < render)
+            candidates.push_back(*it);
+    }
+    std::sort(candidates.begin(), candidates.end(), least_recent);
+    for(std::vector<candidate_type>::const_iterator it=candidates.begin(); it!=candidates.end() && bytes>budget; ++it)
+    {
+        std::size_t before = it->second->memory_size();
+        it->second->release_memory();
+        bytes -= before - std::min(before, it->second->memory_size());
+    }
+}
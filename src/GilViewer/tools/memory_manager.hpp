@@ -0,0 +1,105 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+
+#ifndef __MEMORY_MANAGER_HPP__
+#define __MEMORY_MANAGER_HPP__
+
+#include <map>
+#include <cstddef>
+
+#include <boost/thread/mutex.hpp>
+
+#include "pattern_singleton.hpp"
+
+/**
+ * @brief Accounting of the memory held by the layers, within a global budget.
+ *
+ * Every layer is a client, registered for its whole lifetime. A client reports the bytes it holds (decoded pixels,
+ * tiles, screen buffers, geometries) and can release the part that it is able to reload or recompute transparently.
+ * Drawing a client marks it as displayed. enforce, called after each render, releases the clients that were not
+ * displayed by this render, least recently displayed first, until the total fits in the budget.
+ *
+ * There is no budget by default. The clients are called without the lock of the manager, so enforce and used
+ * must be called by the thread which destroys the clients (the GUI thread).
+ * Released pixels are read again on demand: image_layer::image and variant_view may then throw.
+ **/
+class memory_manager : public PatternSingleton<memory_manager>
+{
+    friend class PatternSingleton<memory_manager>;
+
+public:
+    class client
+    {
+    public:
+        /// Bytes currently held
+        virtual std::size_t memory_size() const { return 0; }
+        /// Frees the data which can be reloaded when needed. Called by the GUI thread; must not create or destroy clients.
+        virtual void release_memory() {}
+
+    protected:
+        client();
+        client(const client&);
+        client& operator=(const client&) { return *this; }
+        virtual ~client();
+        /// Marks the client as displayed by the current render
+        void touch() const;
+    };
+
+    /// Budget in bytes (0, the default: no limit)
+    void budget(std::size_t bytes);
+    std::size_t budget() const;
+    /// Bytes held by all the clients
+    std::size_t used() const;
+    /// Releases the clients not displayed since the previous call, least recently displayed first, until used() fits the budget
+    void enforce();
+
+private:
+    memory_manager();
+
+    void add(const client *c);
+    void remove(const client *c);
+    void touch(const client *c);
+
+    /// Render during which each client was last displayed
+    std::map<const client*, unsigned long> m_clients;
+    unsigned long m_render;
+    std::size_t m_budget;
+    mutable boost::mutex m_mutex;
+};
+
+#endif // __MEMORY_MANAGER_HPP__
@@ -0,0 +1,141 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+
+#include "profiler.hpp"
+#include "tracer.hpp"
+
+using namespace std;
+using namespace boost::posix_time;
+
+profiler::scoped_timer::scoped_timer(category_type category, const std::string& name) :
+        m_category(category), m_name(name), m_start(profiler::instance()->now()), m_traced(tracer::enabled())
+{
+    if(m_traced)
+        tracer::instance()->begin(category_name(category), name);
+}
+
+profiler::scoped_timer::~scoped_timer()
+{
+    profiler *p = profiler::instance();
+    p->record(m_category, m_name, m_start, p->now()-m_start);
+    if(m_traced)
+        tracer::instance()->end(category_name(m_category));
+}
+
+profiler::profiler() : m_origin(microsec_clock::universal_time()), m_samples(4096), m_next(0), m_size(0), m_frame(0) {}
+
+double profiler::now() const
+{
+    return (microsec_clock::universal_time()-m_origin).total_microseconds()/1000.;
+}
+
+void profiler::record(category_type category, const std::string& name, double start, double duration)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_latest[std::make_pair(category, name)] = duration;
+    if(m_samples.empty())
+        return;
+    sample& s = m_samples[m_next];
+    s.frame = m_frame;
+    s.category = category;
+    s.name = name;
+    s.start = start;
+    s.duration = duration;
+    m_next = (m_next+1)%m_samples.size();
+    if(m_size<m_samples.size())
+        ++m_size;
+}
+
+void profiler::end_frame()
+{
+    double t = now();
+    boost::mutex::scoped_lock lock(m_mutex);
+    ++m_frame;
+    m_frame_ends.push_back(t);
+    while(m_frame_ends.front() < t-1000.)
+        m_frame_ends.pop_front();
+}
+
+double profiler::fps() const
+{
+    double t = now();
+    boost::mutex::scoped_lock lock(m_mutex);
+    std::size_t n = 0;
+    for(std::deque<double>::const_iterator it=m_frame_ends.begin(); it!=m_frame_ends.end(); ++it)
+        if(*it >= t-1000.)
+            ++n;
+    return n;
+}
+
+double profiler::latest(category_type category, const std::string& name) const
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    std::map<std::pair<category_type, std::string>, double>::const_iterator it = m_latest.find(std::make_pair(category, name));
+    return it==m_latest.end() ? -1. : it->second;
+}
+
+void profiler::dump(std::ostream& os) const
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    os << "frame\tcategory\tname\tstart (ms)\tduration (ms)\n";
+    std::size_t first = (m_next+m_samples.size()-m_size)%std::max<std::size_t>(m_samples.size(),1);
+    for(std::size_t i=0; i<m_size; ++i)
+    {
+        const sample& s = m_samples[(first+i)%m_samples.size()];
+        os << s.frame << '\t' << category_name(s.category) << '\t' << s.name << '\t' << s.start << '\t' << s.duration << '\n';
+    }
+}
+
+void profiler::capacity(std::size_t n)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_samples.assign(n, sample());
+    m_next = m_size = 0;
+}
+
+std::size_t profiler::capacity() const
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_samples.size();
+}
+
+const char* profiler::category_name(category_type category)
+{
+    static const char* names[NB_CATEGORIES] = { "paint", "update", "draw", "load", "statistics" };
+    return names[category];
+}
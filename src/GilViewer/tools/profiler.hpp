@@ -0,0 +1,122 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+
+#ifndef __PROFILER_HPP__
+#define __PROFILER_HPP__
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "pattern_singleton.hpp"
+
+/**
+ * @brief Timings of the render and load pipelines.
+ *
+ * The timings are measured by scoped_timer objects placed in the code (paint, update and draw of each layer, file
+ * decoding, statistics) and kept in a ring buffer, which can be dumped when a user reports a slow dataset.
+ * The latest timing of each (category, name) pair and the frame rate are displayed by the profiling overlay of
+ * panel_viewer (see /Options/ProfilingOverlay).
+ **/
+class profiler : public PatternSingleton<profiler>
+{
+    friend class PatternSingleton<profiler>;
+
+public:
+    enum category_type { PAINT=0, UPDATE, DRAW, LOAD, STATISTICS, NB_CATEGORIES };
+
+    struct sample
+    {
+        unsigned long frame;
+        category_type category;
+        std::string name;
+        /// Milliseconds since the creation of the profiler
+        double start, duration;
+    };
+
+    /// Records the lifetime of the object, also as a trace event when the tracer is enabled (see tracer.hpp)
+    class scoped_timer
+    {
+    public:
+        scoped_timer(category_type category, const std::string& name);
+        ~scoped_timer();
+    private:
+        category_type m_category;
+        std::string m_name;
+        double m_start;
+        bool m_traced;
+    };
+
+    /// Milliseconds since the creation of the profiler
+    double now() const;
+    void record(category_type category, const std::string& name, double start, double duration);
+    /// Called at the end of each paint
+    void end_frame();
+
+    /// Frames per second, over the last second
+    double fps() const;
+    /// Latest duration recorded for the pair, or a negative value
+    double latest(category_type category, const std::string& name) const;
+
+    /// Writes the samples of the ring buffer, oldest first, as tab separated values
+    void dump(std::ostream& os) const;
+    /// Number of samples kept by the ring buffer
+    void capacity(std::size_t n);
+    std::size_t capacity() const;
+
+    static const char* category_name(category_type category);
+
+private:
+    profiler();
+
+    boost::posix_time::ptime m_origin;
+    std::vector<sample> m_samples;
+    /// Next sample to overwrite, and number of valid samples
+    std::size_t m_next, m_size;
+    unsigned long m_frame;
+    std::deque<double> m_frame_ends;
+    std::map<std::pair<category_type, std::string>, double> m_latest;
+    mutable boost::mutex m_mutex;
+};
+
+#endif // __PROFILER_HPP__
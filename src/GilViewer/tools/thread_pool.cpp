@@ -0,0 +1,320 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/tss.hpp>
+
+#include "thread_pool.hpp"
+#include "tracer.hpp"
+#include "../convenient/macros_gilviewer.hpp"
+
+using namespace std;
+using namespace boost;
+
+namespace
+{
+    /// Identifies the worker running in the current thread, if any
+    struct worker_id
+    {
+        worker_id(unsigned int i, unsigned int g) : index(i), generation(g) {}
+        unsigned int index, generation;
+    };
+    boost::thread_specific_ptr<worker_id> current_worker;
+}
+
+struct thread_pool::cancellation_token::state
+{
+    state() : cancelled(false) {}
+    boost::mutex mutex;
+    bool cancelled;
+};
+
+thread_pool::cancellation_token::cancellation_token() : m_state(new state) {}
+
+void thread_pool::cancellation_token::cancel()
+{
+    boost::mutex::scoped_lock lock(m_state->mutex);
+    m_state->cancelled = true;
+}
+
+bool thread_pool::cancellation_token::cancelled() const
+{
+    boost::mutex::scoped_lock lock(m_state->mutex);
+    return m_state->cancelled;
+}
+
+thread_pool::thread_pool() : m_generation(0), m_next_queue(0), m_pending(0), m_running(0)
+{
+    start(0);
+}
+
+void thread_pool::start(unsigned int n)
+{
+    if(n==0) n = boost::thread::hardware_concurrency();
+    if(n==0) n = 1;
+
+    std::vector< boost::shared_ptr<worker_queue> > queues(n);
+    for(unsigned int i=0; i<n; ++i)
+        queues[i].reset(new worker_queue);
+
+    unsigned int generation;
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        // The tasks queued for the previous workers are distributed to the new ones
+        unsigned int k = 0;
+        for(unsigned int i=0; i<m_queues.size(); ++i)
+            for(unsigned int p=0; p<PRIORITY_MAX; ++p)
+            {
+                std::deque<job>& jobs = m_queues[i]->jobs[p];
+                for(std::deque<job>::const_iterator it=jobs.begin(); it!=jobs.end(); ++it, ++k)
+                    queues[k%n]->jobs[p].push_back(*it);
+            }
+        m_queues.swap(queues);
+        m_next_queue = 0;
+        generation = m_generation;
+    }
+
+    m_threads.clear();
+    for(unsigned int i=0; i<n; ++i)
+        m_threads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&thread_pool::worker_loop, this, i, generation))));
+}
+
+void thread_pool::size(unsigned int n)
+{
+    boost::mutex::scoped_lock resize_lock(m_resize_mutex);
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        ++m_generation;
+    }
+    m_condition.notify_all();
+    for(unsigned int i=0; i<m_threads.size(); ++i)
+        m_threads[i]->join();
+    start(n);
+}
+
+unsigned int thread_pool::size() const
+{
+    boost::mutex::scoped_lock lock(m_resize_mutex);
+    return m_threads.size();
+}
+
+void thread_pool::submit(const task_type& task, priority_type priority, const cancellation_token& token, const task_type& continuation)
+{
+    job j;
+    j.task = task;
+    j.token = token;
+    j.continuation = continuation;
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        unsigned int index;
+        const worker_id *w = current_worker.get();
+        if(w && w->generation==m_generation)
+            index = w->index;
+        else
+            index = (m_next_queue++) % m_queues.size();
+        {
+            boost::mutex::scoped_lock queue_lock(m_queues[index]->mutex);
+            m_queues[index]->jobs[priority].push_back(j);
+        }
+        ++m_pending;
+    }
+    m_condition.notify_one();
+}
+
+bool thread_pool::pop(unsigned int index, job& j)
+{
+    const unsigned int n = m_queues.size();
+    for(int p=PRIORITY_MAX-1; p>=0; --p)
+        for(unsigned int k=0; k<n; ++k)
+        {
+            worker_queue& q = *m_queues[(index+k)%n];
+            boost::mutex::scoped_lock queue_lock(q.mutex);
+            std::deque<job>& jobs = q.jobs[p];
+            if(jobs.empty())
+                continue;
+            // Most recent task of its own queue (still in cache), oldest task of the others
+            if(k==0)
+            {
+                j = jobs.back();
+                jobs.pop_back();
+            }
+            else
+            {
+                j = jobs.front();
+                jobs.pop_front();
+            }
+            queue_lock.unlock();
+            boost::mutex::scoped_lock lock(m_mutex);
+            --m_pending;
+            ++m_running;
+            return true;
+        }
+    return false;
+}
+
+void thread_pool::run(job& j)
+{
+    if(j.token.cancelled())
+        return;
+    task_type wake_up;
+    try
+    {
+        {
+            GILVIEWER_TRACE_SCOPE("task")
+            j.task();
+        }
+        if(j.continuation.empty())
+            return;
+        boost::mutex::scoped_lock lock(m_continuations_mutex);
+        m_continuations.push_back(j);
+        wake_up = m_wake_up;
+    }
+    catch(const std::exception& e)
+    {
+        // The logger is not thread-safe: the error is logged by run_continuations
+        boost::mutex::scoped_lock lock(m_continuations_mutex);
+        m_errors.push_back(e.what());
+        wake_up = m_wake_up;
+    }
+    catch(...)
+    {
+        // Nothing may escape the worker (std::terminate); interruptions by shutdown end here too
+        boost::mutex::scoped_lock lock(m_continuations_mutex);
+        m_errors.push_back("unknown error");
+        wake_up = m_wake_up;
+    }
+    if(wake_up)
+        wake_up();
+}
+
+bool thread_pool::in_worker()
+{
+    return current_worker.get()!=0;
+}
+
+void thread_pool::worker_loop(unsigned int index, unsigned int generation)
+{
+    current_worker.reset(new worker_id(index, generation));
+    for(;;)
+    {
+        job j;
+        bool found = pop(index, j);
+        if(found)
+            run(j);
+
+        boost::mutex::scoped_lock lock(m_mutex);
+        if(found)
+        {
+            --m_running;
+            if(m_pending==0 && m_running==0)
+                m_idle.notify_all();
+        }
+        while(m_pending==0 && generation==m_generation)
+            m_condition.wait(lock);
+        if(generation!=m_generation)
+            return;
+    }
+}
+
+void thread_pool::run_continuations()
+{
+    std::deque<job> continuations;
+    std::vector<std::string> errors;
+    {
+        boost::mutex::scoped_lock lock(m_continuations_mutex);
+        continuations.swap(m_continuations);
+        errors.swap(m_errors);
+    }
+    for(unsigned int i=0; i<errors.size(); ++i)
+        GILVIEWER_LOG_ERROR("Task: " << errors[i]);
+    // A failing continuation does not prevent the others from running
+    for(std::deque<job>::iterator it=continuations.begin(); it!=continuations.end(); ++it)
+        if(!it->token.cancelled())
+        {
+            GILVIEWER_TRACE_SCOPE("continuation")
+            try
+            {
+                it->continuation();
+            }
+            catch(const std::exception& e)
+            {
+                GILVIEWER_LOG_ERROR("Continuation: " << e.what());
+            }
+            catch(...)
+            {
+                GILVIEWER_LOG_ERROR("Continuation: unknown error");
+            }
+        }
+}
+
+void thread_pool::wake_up(const task_type& f)
+{
+    boost::mutex::scoped_lock lock(m_continuations_mutex);
+    m_wake_up = f;
+}
+
+void thread_pool::wait()
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    while(m_pending!=0 || m_running!=0)
+        m_idle.wait(lock);
+}
+
+void thread_pool::shutdown()
+{
+    boost::mutex::scoped_lock resize_lock(m_resize_mutex);
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        ++m_generation;
+        for(unsigned int i=0; i<m_queues.size(); ++i)
+        {
+            boost::mutex::scoped_lock queue_lock(m_queues[i]->mutex);
+            for(unsigned int p=0; p<PRIORITY_MAX; ++p)
+                m_queues[i]->jobs[p].clear();
+        }
+        m_pending = 0;
+    }
+    m_condition.notify_all();
+    for(unsigned int i=0; i<m_threads.size(); ++i)
+        m_threads[i]->interrupt();
+    for(unsigned int i=0; i<m_threads.size(); ++i)
+        m_threads[i]->join();
+    m_threads.clear();
+    m_idle.notify_all();
+}
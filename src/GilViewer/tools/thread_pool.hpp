@@ -0,0 +1,157 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+
+#ifndef __THREAD_POOL_HPP__
+#define __THREAD_POOL_HPP__
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+
+#include "pattern_singleton.hpp"
+
+namespace boost { class thread; }
+
+/**
+ * @brief Pool of worker threads shared by the whole library.
+ *
+ * Each worker owns a queue per priority. A task submitted by a worker goes to its own queue, other tasks are
+ * distributed in turn. An idle worker takes the most recent task of its own queue, or steals the oldest task of
+ * another worker, always looking at the highest priority first: interactive work runs before the background work
+ * already queued.
+ *
+ * A task may be given a cancellation_token, polled by the task itself, and a continuation. The continuations are
+ * run by run_continuations, which the GUI calls when woken up by the wake_up function (see panel_viewer).
+ **/
+class thread_pool : public PatternSingleton<thread_pool>
+{
+    friend class PatternSingleton<thread_pool>;
+
+public:
+    typedef boost::function<void ()> task_type;
+
+    enum priority_type
+    {
+        PRIORITY_BACKGROUND = 0, ///< Prefetch, caches
+        PRIORITY_NORMAL,         ///< Loading, statistics, indexing
+        PRIORITY_INTERACTIVE,    ///< Rendering of the view
+        PRIORITY_MAX
+    };
+
+    /// Shared flag telling a task and its continuation that their result is not needed anymore. Copies share the flag.
+    class cancellation_token
+    {
+    public:
+        cancellation_token();
+        void cancel();
+        bool cancelled() const;
+    private:
+        struct state;
+        boost::shared_ptr<state> m_state;
+    };
+
+    /// Queues a task. Neither the task nor its continuation are run if the token is cancelled before they start.
+    void submit(const task_type& task, priority_type priority = PRIORITY_NORMAL,
+                const cancellation_token& token = cancellation_token(), const task_type& continuation = task_type());
+
+    /// Sets the number of workers (0: number of hardware threads). Waits for the running tasks; the queued ones are kept.
+    void size(unsigned int n);
+    unsigned int size() const;
+
+    /// Runs the continuations of the finished tasks and logs their errors. Must be called by the GUI thread.
+    void run_continuations();
+    /// Function called by the workers when a continuation is ready (typically wxWakeUpIdle). It must be thread-safe.
+    void wake_up(const task_type& f);
+
+    /// Blocks until all the queued tasks have been run (the continuations excepted). Must not be called by a task.
+    void wait();
+    /// Drops the queued tasks, interrupts the running ones (see boost::this_thread::interruption_point) and joins the
+    /// workers. Called once at exit, by the GUI or main thread: no task may be submitted afterwards.
+    void shutdown();
+
+    /// Tells whether the calling thread is a worker of the pool
+    static bool in_worker();
+
+private:
+    thread_pool();
+
+    struct job
+    {
+        task_type task;
+        cancellation_token token;
+        task_type continuation;
+    };
+    struct worker_queue
+    {
+        boost::mutex mutex;
+        std::deque<job> jobs[PRIORITY_MAX];
+    };
+
+    void start(unsigned int n);
+    void worker_loop(unsigned int index, unsigned int generation);
+    /// Takes the next job for the given worker, by priority: its own queue first, then the other ones
+    bool pop(unsigned int index, job& j);
+    void run(job& j);
+
+    /// Workers and their queues. Only modified by size, while no worker runs.
+    std::vector< boost::shared_ptr<worker_queue> > m_queues;
+    std::vector< boost::shared_ptr<boost::thread> > m_threads;
+    mutable boost::mutex m_resize_mutex;
+
+    /// Guards the counters below and the distribution of the submitted tasks
+    boost::mutex m_mutex;
+    boost::condition m_condition;
+    /// Signaled when the last queued task is done (see wait)
+    boost::condition m_idle;
+    unsigned int m_generation;
+    unsigned int m_next_queue;
+    unsigned int m_pending;
+    unsigned int m_running;
+
+    boost::mutex m_continuations_mutex;
+    std::deque<job> m_continuations;
+    std::vector<std::string> m_errors;
+    task_type m_wake_up;
+};
+
+#endif // __THREAD_POOL_HPP__
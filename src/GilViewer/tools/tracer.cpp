@@ -0,0 +1,228 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include <boost/thread/tss.hpp>
+
+#include "tracer.hpp"
+#include "../convenient/macros_gilviewer.hpp"
+
+using namespace std;
+using namespace boost::posix_time;
+
+namespace
+{
+    /// Events per thread, allocated by the first event of the thread
+    const std::size_t buffer_capacity = 1<<16;
+
+    bool enabled_by_environment()
+    {
+        const char *f = getenv("GILVIEWER_TRACE");
+        return f && *f;
+    }
+
+    void write_json_string(std::ostream& os, const char *s)
+    {
+        os << '"';
+        for(; *s; ++s)
+        {
+            unsigned char c = static_cast<unsigned char>(*s);
+            if(c=='"' || c=='\\')
+                os << '\\' << *s;
+            else if(c<0x20)
+            {
+                char escaped[8];
+                sprintf(escaped, "\\u%04x", c);
+                os << escaped;
+            }
+            else
+                os << *s;
+        }
+        os << '"';
+    }
+}
+
+bool tracer::m_enabled = enabled_by_environment();
+
+tracer::tracer() : m_origin(microsec_clock::universal_time()), m_exit_registered(false)
+{
+    const char *f = getenv("GILVIEWER_TRACE");
+    if(f && *f)
+        output(f);
+}
+
+void tracer::enable(bool e)
+{
+    m_enabled = e;
+}
+
+tracer::thread_buffer& tracer::buffer()
+{
+    static boost::thread_specific_ptr<thread_buffer> current(&tracer::keep_buffer);
+    if(!current.get())
+    {
+        boost::shared_ptr<thread_buffer> b(new thread_buffer);
+        b->events.resize(buffer_capacity);
+        b->size = 0;
+        b->dropped = 0;
+        boost::mutex::scoped_lock lock(m_mutex);
+        b->id = m_buffers.size()+1;
+        m_buffers.push_back(b);
+        current.reset(b.get());
+    }
+    return *current;
+}
+
+void tracer::record(const char *name, const std::string& detail, char phase)
+{
+    thread_buffer& b = buffer();
+    std::size_t i = b.size;
+    if(i==b.events.size())
+    {
+        ++b.dropped;
+        return;
+    }
+    event& e = b.events[i];
+    e.name = name;
+    e.detail = detail;
+    e.phase = phase;
+    e.timestamp = (microsec_clock::universal_time()-m_origin).total_microseconds();
+    b.size = i+1;
+}
+
+void tracer::begin(const char *name, const std::string& detail)
+{
+    record(name, detail, 'B');
+}
+
+void tracer::end(const char *name)
+{
+    record(name, std::string(), 'E');
+}
+
+void tracer::write(std::ostream& os) const
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    std::streamsize precision = os.precision(15);
+    os << "{\"traceEvents\":[\n";
+    os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GilViewer\"}}";
+    for(std::size_t i=0; i<m_buffers.size(); ++i)
+    {
+        const thread_buffer& b = *m_buffers[i];
+        os << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b.id << ",\"args\":{\"name\":\"thread " << b.id << "\"}}";
+        std::size_t size = b.size;
+        for(std::size_t j=0; j<size; ++j)
+        {
+            const event& e = b.events[j];
+            os << ",\n{\"name\":";
+            write_json_string(os, e.name);
+            os << ",\"cat\":\"gilviewer\",\"ph\":\"" << e.phase << "\",\"ts\":" << e.timestamp << ",\"pid\":1,\"tid\":" << b.id;
+            if(!e.detail.empty())
+            {
+                os << ",\"args\":{\"detail\":";
+                write_json_string(os, e.detail.c_str());
+                os << '}';
+            }
+            os << '}';
+        }
+    }
+    os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    os.precision(precision);
+}
+
+std::size_t tracer::dropped() const
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    std::size_t n = 0;
+    for(std::size_t i=0; i<m_buffers.size(); ++i)
+        n += m_buffers[i]->dropped;
+    return n;
+}
+
+bool tracer::write(const std::string& filename) const
+{
+    std::ofstream os(filename.c_str());
+    if(!os)
+    {
+        GILVIEWER_LOG_ERROR("Trace: unable to write " << filename);
+        return false;
+    }
+    write(os);
+    if(std::size_t n = dropped())
+        GILVIEWER_LOG_WARNING("Trace: " << n << " events dropped (full buffers)");
+    return os.good();
+}
+
+void tracer::clear()
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    for(std::size_t i=0; i<m_buffers.size(); ++i)
+    {
+        m_buffers[i]->size = 0;
+        m_buffers[i]->dropped = 0;
+    }
+}
+
+void tracer::output(const std::string& filename)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_output = filename;
+    if(!m_exit_registered && !filename.empty())
+        m_exit_registered = (atexit(&tracer::write_at_exit)==0);
+}
+
+void tracer::write_at_exit()
+{
+    tracer *t = tracer::instance();
+    std::string filename;
+    {
+        boost::mutex::scoped_lock lock(t->m_mutex);
+        filename = t->m_output;
+    }
+    if(filename.empty())
+        return;
+    // The GUI, and its log, may already be destroyed
+    std::ofstream os(filename.c_str());
+    t->write(os);
+    if(!os)
+        cerr << "Trace: unable to write " << filename << endl;
+}
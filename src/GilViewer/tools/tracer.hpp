@@ -0,0 +1,138 @@
+/***********************************************************************
+
+This file is part of the GilViewer project source files.
+
+GilViewer is an open source 2D viewer (raster and vector) based on Boost
+GIL and wxWidgets.
+
+
+Homepage: 
+
+	http://code.google.com/p/gilviewer
+
+Copyright:
+
+	Institut Geographique National (2009)
+
+Authors: 
+
+	Olivier Tournaire, Adrien Chauve
+
+	
+	
+
+    GilViewer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published
+    by the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    GilViewer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public 
+    License along with GilViewer.  If not, see <http://www.gnu.org/licenses/>.
+
+***********************************************************************/
+
+#ifndef __TRACER_HPP__
+#define __TRACER_HPP__
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "pattern_singleton.hpp"
+
+/**
+ * @brief Begin/end events of the load and render pipelines, exported in the Chrome Trace Event format
+ * (chrome://tracing, Perfetto).
+ *
+ * Each thread writes its events in its own buffer, without locking. When tracing is disabled, a probe only tests
+ * a flag, and no probe is compiled at all with GILVIEWER_NO_TRACE.
+ * Setting the environment variable GILVIEWER_TRACE to a file name enables tracing at startup and writes the trace
+ * to that file at exit.
+ **/
+class tracer : public PatternSingleton<tracer>
+{
+    friend class PatternSingleton<tracer>;
+
+public:
+    static bool enabled() { return m_enabled; }
+    void enable(bool e);
+
+    void begin(const char *name, const std::string& detail = std::string());
+    void end(const char *name);
+
+    /// Writes the events recorded so far (those of the threads tracing at the same time may be missing)
+    void write(std::ostream& os) const;
+    bool write(const std::string& filename) const;
+    /// Events lost because a thread filled its buffer
+    std::size_t dropped() const;
+    /// Forgets the recorded events (while tracing is disabled)
+    void clear();
+    /// File written at exit (empty: none)
+    void output(const std::string& filename);
+
+    /// Records the lifetime of the object, if tracing is enabled at its construction
+    class scope
+    {
+    public:
+        scope(const char *name) : m_name(tracer::enabled() ? name : 0) { if(m_name) tracer::instance()->begin(name); }
+        scope(const char *name, const std::string& detail) : m_name(tracer::enabled() ? name : 0) { if(m_name) tracer::instance()->begin(name, detail); }
+        ~scope() { if(m_name) tracer::instance()->end(m_name); }
+    private:
+        const char *m_name;
+    };
+
+private:
+    tracer();
+
+    struct event
+    {
+        const char *name;
+        std::string detail;
+        char phase;
+        double timestamp;
+    };
+    /// Events of a thread. Only written by this thread: size is incremented once the event is complete.
+    struct thread_buffer
+    {
+        unsigned int id;
+        std::vector<event> events;
+        volatile std::size_t size;
+        std::size_t dropped;
+    };
+
+    thread_buffer& buffer();
+    void record(const char *name, const std::string& detail, char phase);
+    static void write_at_exit();
+    /// The buffers are owned by m_buffers, and outlive their threads
+    static void keep_buffer(thread_buffer*) {}
+
+    static bool m_enabled;
+    boost::posix_time::ptime m_origin;
+    std::vector< boost::shared_ptr<thread_buffer> > m_buffers;
+    std::string m_output;
+    bool m_exit_registered;
+    mutable boost::mutex m_mutex;
+};
+
+#ifdef GILVIEWER_NO_TRACE
+#   define GILVIEWER_TRACE_SCOPE(name)
+#   define GILVIEWER_TRACE_SCOPE_DETAIL(name, detail)
+#else
+#   define GILVIEWER_TRACE_CONCAT_(a, b) a##b
+#   define GILVIEWER_TRACE_CONCAT(a, b) GILVIEWER_TRACE_CONCAT_(a, b)
+/// Traces the enclosing scope. The name must be a string literal.
+#   define GILVIEWER_TRACE_SCOPE(name) tracer::scope GILVIEWER_TRACE_CONCAT(gilviewer_trace_, __LINE__)(name);
+/// Same, with a detail (file or layer name) only evaluated when tracing is enabled
+#   define GILVIEWER_TRACE_SCOPE_DETAIL(name, detail) tracer::scope GILVIEWER_TRACE_CONCAT(gilviewer_trace_, __LINE__)(name, tracer::enabled() ? std::string(detail) : std::string());
+#endif
+
+#endif // __TRACER_HPP__
@@ -46,7 +46,9 @@ Authors:
 #include <wx/log.h>
 
 #include "GilViewer/io/gilviewer_io_factory.hpp"
+#include "GilViewer/tools/image_stats_cache.hpp"
 #include "GilViewer/tools/pattern_singleton.hpp"
+#include "GilViewer/tools/thread_pool.hpp"
 #include "gilviewer_frame.hpp"
 #include "gilviewer_app.hpp"
 
@@ -127,6 +129,15 @@ bool gilviewer_app::OnInit()
     return true;
 }
 
+int gilviewer_app::OnExit()
+{
+    // The workers are stopped first: their tasks may still store statistics
+    thread_pool::instance()->shutdown();
+    // The statistics computed during the session are written before the writer thread is destroyed
+    image_stats_cache::instance()->flush();
+    return wxApp::OnExit();
+}
+
 void gilviewer_app::set_langage(unsigned int language_id)
 {
     wxLocale* locale;
@@ -46,6 +46,7 @@ class gilviewer_frame;
 class gilviewer_app: public wxApp
 {
     bool OnInit();
+    int OnExit();
 
     // Langage
     void set_langage(unsigned int language_id);